@@ -0,0 +1,367 @@
+/*
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @author: pregusia
+ *
+ */
+
+
+/*
+ * Alokacje na jedno zapytanie w calej sciezce proxy: odebranie pakietu, cache albo Client
+ * i agent, wyslanie odpowiedzi. Aplikacja dziala w tym procesie (g_app.run), a watek
+ * pomocniczy gra role zarzadcy (NMS) i agenta SNMP na loopbacku.
+ * Licznik alokacji jest tylko tutaj - podmienione operator new/delete nie trafiaja do aplikacji.
+ *
+ * make bench && ./bench-allocations [zapytania]
+ */
+
+#include <application/Application.h>
+#include <application/snmp/streams.h>
+#include <io/buffers.h>
+
+#include <arpa/inet.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <new>
+#include <thread>
+
+// ##################################################################################################
+// licznik alokacji - wspolny dla wszystkich watkow aplikacji, bez watku pomocniczego
+
+static std::atomic<uint64_t> s_allocations(0);
+static thread_local bool t_uncounted = false;
+
+// poza operatorami (noinline), zeby kompilator nie zestawial malloc/free z new/delete
+__attribute__((noinline)) static void* countedAlloc(std::size_t size) {
+	if (!t_uncounted) s_allocations.fetch_add(1, std::memory_order_relaxed);
+	return std::malloc(size == 0 ? 1 : size);
+}
+
+__attribute__((noinline)) static void countedFree(void* ptr) {
+	std::free(ptr);
+}
+
+void* operator new(std::size_t size) {
+	void* ptr = countedAlloc(size);
+	if (ptr == nullptr) throw std::bad_alloc();
+	return ptr;
+}
+
+void* operator new[](std::size_t size) {
+	void* ptr = countedAlloc(size);
+	if (ptr == nullptr) throw std::bad_alloc();
+	return ptr;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size); }
+
+void operator delete(void* ptr) noexcept { countedFree(ptr); }
+void operator delete[](void* ptr) noexcept { countedFree(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { countedFree(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { countedFree(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { countedFree(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { countedFree(ptr); }
+
+// ##################################################################################################
+
+using namespace application::snmp;
+
+namespace {
+
+	const uint16_t PROXY_PORT = 17161;
+	const uint16_t AGENT_PORT = 17162;
+	const uint16_t SOURCE_PORT = 17163;
+
+	const char* CONFIG =
+		"proxy {\n"
+		"	community \"bench\";\n"
+		"	socket \"127.0.0.1:17161\";\n"
+		"	target {\n"
+		"		src-socket \"127.0.0.1:17163\";\n"
+		"		dst-socket \"127.0.0.1:17162\";\n"
+		"		community \"public\";\n"
+		"		timeout 2000;\n"
+		"	};\n"
+		"	cache-for \".1.3.6.1.2.1.2.2.1.2.*\" {\n"
+		"		update-interval 3600;\n"
+		"	};\n"
+		"};\n";
+
+	// ************************************************************************************
+	sockaddr_in loopback(uint16_t port) {
+		sockaddr_in addr = { 0 };
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr.sin_port = htons(port);
+		return addr;
+	}
+
+	// ************************************************************************************
+	int32_t openSocket(uint16_t port) {
+		int32_t fd = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+		sockaddr_in addr = loopback(port);
+		if (fd < 0 || ::bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+			perror("bind");
+			exit(1);
+		}
+		return fd;
+	}
+
+	// ************************************************************************************
+	Value createMessage(const std::string& community, ValueType::Enum type, int32_t requestID, int32_t maxRepetitions, const std::vector<VarBinding>& values) {
+		Value vbs = Value::createSequence();
+		for(auto& e: values) {
+			Value vb = Value::createSequence();
+			vb.addItem(Value::createOID(e.name));
+			vb.addItem(e.value);
+			vbs.addItem(vb);
+		}
+
+		Value pdu = Value::createSequence(type);
+		pdu.addItem(Value::createInt(requestID));
+		pdu.addItem(Value::createInt(0));
+		pdu.addItem(Value::createInt(maxRepetitions));
+		pdu.addItem(vbs);
+
+		Value msg = Value::createSequence();
+		msg.addItem(Value::createInt(1));
+		msg.addItem(Value::createString(community));
+		msg.addItem(pdu);
+		return msg;
+	}
+
+	// ************************************************************************************
+	void sendMessage(int32_t fd, const sockaddr_in& to, const Value& msg) {
+		io::DataBuffer buf;
+		io::DataBufferOutputStream os(buf, true);
+		SNMPOutputStreamAdapter snmpOS(os);
+		snmpOS.writeValue(msg);
+		::sendto(fd, &buf[0], buf.size(), 0, (const sockaddr*)&to, sizeof(to));
+	}
+
+	// ************************************************************************************
+	bool receiveMessage(int32_t fd, sockaddr_in& from, Value& msg) {
+		uint8_t data[65536];
+		socklen_t fromLen = sizeof(from);
+		ssize_t res = ::recvfrom(fd, data, sizeof(data), 0, (sockaddr*)&from, &fromLen);
+		if (res <= 0) return false;
+
+		io::DataBuffer buf(data, res);
+		io::DataBufferInputStream is(buf);
+		bool errorFlag = false;
+		msg = SNMPInputStreamAdapter::read(is, errorFlag);
+		return !errorFlag && msg.isMessage();
+	}
+
+	/**
+	 * Agent SNMP z kilkoma tabelami interfejsow - odpowiada na GET, GET-NEXT i GET-BULK.
+	 */
+	class Agent {
+		public:
+			Agent() : m_fd(openSocket(AGENT_PORT)) {
+				m_mib[OID(".1.3.6.1.2.1.1.1.0")] = Value::createString("bench agent");
+				for(int32_t i=1;i<=24;++i) {
+					m_mib[OID(stdext::format(".1.3.6.1.2.1.2.2.1.2.%d", i))] = Value::createString(stdext::format("eth%d", i));
+					m_mib[OID(stdext::format(".1.3.6.1.2.1.2.2.1.10.%d", i))] = Value::createCounter32(1000000 * i);
+				}
+			}
+
+			int32_t fd() const { return m_fd; }
+
+			void onRead() {
+				sockaddr_in from;
+				Value req;
+				if (!receiveMessage(m_fd, from, req)) return;
+
+				auto& pdu = req[2];
+				std::vector<VarBinding> res;
+
+				for(auto& e: pdu[3].valueVec()) {
+					const OID& name = e[0].valueOID();
+					int32_t num = pdu.type() == ValueType::PDU_GET_BULK ? std::max<int32_t>(pdu[2].valueInt(), 1) : 1;
+
+					auto it = pdu.type() == ValueType::PDU_GET ? m_mib.find(name) : m_mib.upper_bound(name);
+					for(int32_t i=0;i<num;++i) {
+						VarBinding vb;
+						if (it == m_mib.end()) {
+							vb.name = name;
+							vb.value = pdu.type() == ValueType::PDU_GET ? Value::createNull() : Value::createEndOfMIBView();
+							res.push_back(vb);
+							break;
+						}
+						vb.name = it->first;
+						vb.value = it->second;
+						res.push_back(vb);
+						++it;
+					}
+				}
+
+				sendMessage(m_fd, from, createMessage(req[1].valueString(), ValueType::PDU_RESPONSE, pdu[0].valueInt(), 0, res));
+			}
+
+		private:
+			int32_t m_fd;
+			std::map<OID, Value> m_mib;
+	};
+
+	/**
+	 * Zarzadca - wysyla zapytania do proxy po jednym i czeka na odpowiedz (obslugujac w tym
+	 * czasie agenta).
+	 */
+	class Manager {
+		public:
+			Manager(Agent& agent) : m_agent(agent), m_fd(openSocket(0)), m_requestID(1) { }
+
+			// false - brak odpowiedzi w timeoutMillis
+			bool request(ValueType::Enum type, const OID& oid, int32_t maxRepetitions, int32_t timeoutMillis, Value& response) {
+				VarBinding vb;
+				vb.name = oid;
+				vb.value = Value::createNull();
+
+				int32_t requestID = m_requestID++;
+				sendMessage(m_fd, loopback(PROXY_PORT), createMessage("bench", type, requestID, maxRepetitions, std::vector<VarBinding>(1, vb)));
+
+				auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMillis);
+				while(std::chrono::steady_clock::now() < deadline) {
+					pollfd fds[2] = { { m_fd, POLLIN, 0 }, { m_agent.fd(), POLLIN, 0 } };
+					if (::poll(fds, 2, 10) <= 0) continue;
+
+					if (fds[1].revents & POLLIN) m_agent.onRead();
+					if (fds[0].revents & POLLIN) {
+						sockaddr_in from;
+						if (receiveMessage(m_fd, from, response) && response[2][0].valueInt() == requestID) return true;
+					}
+				}
+				return false;
+			}
+
+		private:
+			Agent& m_agent;
+			int32_t m_fd;
+			int32_t m_requestID;
+	};
+
+	class Scenario {
+		public:
+			const char* name;
+			ValueType::Enum type;
+			const char* oid;
+			int32_t maxRepetitions;
+			int32_t expectedValues;
+	};
+
+	const Scenario SCENARIOS[] = {
+		{ "cache GET", ValueType::PDU_GET, ".1.3.6.1.2.1.2.2.1.2.5", 0, 1 },
+		{ "cache GETNEXT", ValueType::PDU_GET_NEXT, ".1.3.6.1.2.1.2.2.1.2.5", 0, 1 },
+		{ "cache GETBULK (10)", ValueType::PDU_GET_BULK, ".1.3.6.1.2.1.2.2.1.2", 10, 10 },
+		{ "proxied GET", ValueType::PDU_GET, ".1.3.6.1.2.1.1.1.0", 0, 1 },
+	};
+
+	// ************************************************************************************
+	bool runScenarios(int32_t requests) {
+		t_uncounted = true;
+
+		Agent agent;
+		Manager manager(agent);
+		Value response;
+
+		// aplikacja startuje w watku glownym, a cache wypelnia sie przy pierwszym zapytaniu
+		bool started = false;
+		for(int32_t i=0;i<100 && !started;++i) {
+			started = manager.request(ValueType::PDU_GET, OID(".1.3.6.1.2.1.2.2.1.2.1"), 0, 100, response);
+		}
+		if (!started) {
+			printf("proxy is not responding\n");
+			return false;
+		}
+
+		printf("%-20s %12s %12s\n", "", "allocs/req", "us/req");
+		for(auto& s: SCENARIOS) {
+			// pierwsze przebiegi ustalaja pojemnosc buforow i pul
+			for(int32_t i=0;i<100;++i) {
+				manager.request(s.type, OID(s.oid), s.maxRepetitions, 2000, response);
+			}
+
+			uint64_t allocations = s_allocations.load(std::memory_order_relaxed);
+			auto start = std::chrono::steady_clock::now();
+
+			for(int32_t i=0;i<requests;++i) {
+				if (!manager.request(s.type, OID(s.oid), s.maxRepetitions, 2000, response)) {
+					printf("%s: no response\n", s.name);
+					return false;
+				}
+				if (response[2][1].valueInt() != 0 || static_cast<int32_t>(response[2][3].size()) != s.expectedValues) {
+					printf("%s: unexpected response %s\n", s.name, response.toStringDeep().c_str());
+					return false;
+				}
+			}
+
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			allocations = s_allocations.load(std::memory_order_relaxed) - allocations;
+
+			printf("%-20s %12.2f %12.1f\n", s.name, static_cast<double>(allocations) / requests, seconds * 1e6 / requests);
+		}
+		return true;
+	}
+
+}
+
+// ************************************************************************************
+int main(int argc, char** argv) {
+	int32_t requests = argc > 1 ? atoi(argv[1]) : 2000;
+
+	char path[] = "/tmp/bench-allocations-XXXXXX";
+	int32_t fd = mkstemp(path);
+	if (fd < 0 || ::write(fd, CONFIG, strlen(CONFIG)) < 0) {
+		perror("config");
+		return 1;
+	}
+	::close(fd);
+
+	// sygnaly dostaje tylko watek aplikacji (g_unixSignals)
+	sigset_t mask;
+	sigfillset(&mask);
+	pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+
+	bool ok = false;
+	std::thread helper([&ok, requests](){
+		ok = runScenarios(requests);
+		kill(getpid(), SIGTERM);
+	});
+
+	pthread_sigmask(SIG_UNBLOCK, &mask, nullptr);
+
+	application::Application::StartConfig config;
+	config.configFile = path;
+	g_app.run(config);
+
+	helper.join();
+	unlink(path);
+	return ok ? 0 : 1;
+}
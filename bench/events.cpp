@@ -0,0 +1,124 @@
+/*
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @author: pregusia
+ *
+ */
+
+
+/*
+ * Przepustowosc EventDispatcher: kolejka cykliczna (addEvent/post + poll)
+ * i kolo czasowe (scheduleEvent + cancel, wygasanie zdarzen).
+ *
+ * make bench && ./bench-events [zdarzenia]
+ */
+
+#include <core/eventdispatcher.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace {
+
+	const int32_t BATCH = 1000;
+
+	// ************************************************************************************
+	template<typename F>
+	void run(const char* name, int64_t events, const F& func) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		func();
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		printf("%-28s events=%lld  %.1f ns/event  %.2f Mevents/s\n", name,
+			static_cast<long long>(events), seconds * 1e9 / events, events / seconds / 1e6);
+	}
+
+}
+
+// ************************************************************************************
+int main(int argc, char** argv) {
+	int64_t events = argc > 1 ? atoll(argv[1]) : 2000000;
+	events = std::max<int64_t>(BATCH, events / BATCH * BATCH);
+
+	core::EventDispatcher dispatcher;
+	int64_t executed = 0;
+	g_clock.update();
+
+	run("addEvent + poll", events, [&](){
+		for(int64_t i=0;i<events;i+=BATCH) {
+			for(int32_t j=0;j<BATCH;++j) dispatcher.addEvent([&executed](){ executed += 1; });
+			dispatcher.poll(false);
+		}
+	});
+
+	run("post + poll", events, [&](){
+		for(int64_t i=0;i<events;i+=BATCH) {
+			for(int32_t j=0;j<BATCH;++j) dispatcher.post([&executed](){ executed += 1; });
+			dispatcher.poll(false);
+		}
+	});
+
+	// typowe timeouty zapytan - prawie zawsze odwolywane przed czasem
+	run("scheduleEvent + cancel", events, [&](){
+		std::vector<core::ScheduledEventPtr> timers(BATCH);
+		for(int64_t i=0;i<events;i+=BATCH) {
+			for(int32_t j=0;j<BATCH;++j) timers[j] = dispatcher.scheduleEvent([&executed](){ executed += 1; }, 1000 + j * 60);
+			for(int32_t j=0;j<BATCH;++j) timers[j]->cancel();
+			dispatcher.poll(false);
+		}
+	});
+
+	// opoznienie 0 - wygasaja w nastepnym poll(), albo w nastepnej milisekundzie
+	// jezeli kolo juz ja minelo
+	run("scheduleEvent + expiry", events, [&](){
+		int64_t target = executed + events;
+		for(int64_t i=0;i<events;i+=BATCH) {
+			for(int32_t j=0;j<BATCH;++j) dispatcher.scheduleEvent([&executed](){ executed += 1; }, 0);
+			g_clock.update();
+			dispatcher.poll(false);
+		}
+		while(executed < target) {
+			g_clock.update();
+			dispatcher.poll(false);
+		}
+	});
+
+	// jeden watek producenta, watek glowny wykonuje
+	run("pushEventSynchronized", events, [&](){
+		int64_t target = executed + events;
+		std::thread producer([&dispatcher, &executed, events](){
+			for(int64_t i=0;i<events;++i) dispatcher.pushEventSynchronized([&executed](){ executed += 1; });
+		});
+		while(executed < target) dispatcher.poll(false);
+		producer.join();
+	});
+
+	dispatcher.shutdown();
+
+	int64_t expected = events * 4;
+	if (executed != expected) {
+		printf("executed %lld events, expected %lld\n", static_cast<long long>(executed), static_cast<long long>(expected));
+		return 1;
+	}
+	return 0;
+}
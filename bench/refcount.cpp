@@ -0,0 +1,134 @@
+/*
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @author: pregusia
+ *
+ */
+
+
+/*
+ * Koszt kopiowania stdext::object_ptr: kopia + zniszczenie kopii, czyli __refsInc() i __refsDec().
+ * Dla porownania LockedObject odtwarza poprzedni licznik (mutex + volatile int32_t).
+ *
+ * make bench && ./bench-refcount [iteracje]
+ */
+
+#include <stdext/stdext.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+	class BenchObject: public stdext::object {
+		public:
+			int32_t value;
+			BenchObject() : value(0) { }
+	};
+
+	// poprzednia implementacja licznika referencji
+	class LockedObject {
+		public:
+			LockedObject() : m_refs(0) { }
+			virtual ~LockedObject() { }
+
+			void refsInc() {
+				m_mutex.lock();
+				m_refs++;
+				m_mutex.unlock();
+			}
+			void refsDec() {
+				bool del = false;
+
+				m_mutex.lock();
+				m_refs -= 1;
+				if (m_refs == 0) del = true;
+				m_mutex.unlock();
+
+				if (del) delete this;
+			}
+
+		private:
+			volatile int32_t m_refs;
+			uint64_t m_id;
+			std::mutex m_mutex;
+	};
+
+	class LockedPtr {
+		public:
+			LockedPtr(LockedObject* p) : px(p) { px->refsInc(); }
+			LockedPtr(const LockedPtr& rhs) : px(rhs.px) { px->refsInc(); }
+			~LockedPtr() { px->refsDec(); }
+
+		private:
+			LockedObject* px;
+			LockedPtr& operator=(const LockedPtr&);
+	};
+
+	// ************************************************************************************
+	template<typename Ptr>
+	void copyLoop(const Ptr& shared, int64_t iterations) {
+		for(int64_t i=0;i<iterations;++i) {
+			Ptr copy(shared);
+			(void)copy;
+		}
+	}
+
+	// ************************************************************************************
+	template<typename Ptr>
+	void run(const char* name, const Ptr& shared, int32_t threads, int64_t iterations) {
+		std::vector<std::thread> workers;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		for(int32_t i=0;i<threads;++i) {
+			workers.push_back(std::thread([&shared, iterations](){ copyLoop(shared, iterations); }));
+		}
+		for(auto& w : workers) w.join();
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		double copies = static_cast<double>(iterations) * threads;
+
+		printf("%-10s threads=%d  copies=%.0f  %.2f ns/copy  %.1f Mcopies/s\n",
+			name, threads, copies, seconds * 1e9 / iterations, copies / seconds / 1e6);
+	}
+
+}
+
+// ************************************************************************************
+int main(int argc, char** argv) {
+	int64_t iterations = argc > 1 ? atoll(argv[1]) : 20000000;
+
+	printf("sizeof(stdext::object) = %d, sizeof(LockedObject) = %d\n", (int)sizeof(stdext::object), (int)sizeof(LockedObject));
+
+	stdext::object_ptr<BenchObject> atomicShared(new BenchObject());
+	LockedPtr lockedShared(new LockedObject());
+
+	const int32_t threadCounts[] = { 1, 4 };
+	for(int32_t threads : threadCounts) {
+		run("atomic", atomicShared, threads, iterations);
+		run("mutex", lockedShared, threads, iterations);
+	}
+
+	return 0;
+}
@@ -32,10 +32,12 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <sys/wait.h>
+#include <sys/eventfd.h>
 
 #include <core/eventdispatcher.h>
 #include <io/io.h>
 #include <io/signals.h>
+#include <io/Resolver.h>
 
 #include <application/config/parser/ConfigParserException.h>
 #include <application/config/parser/ConfigEntry.h>
@@ -44,6 +46,9 @@
 #include <application/snmp/SocketsManager.h>
 #include <application/snmp/Client.h>
 #include <application/snmp/ProxyServer.h>
+#include <application/snmp/MetricsServer.h>
+#include <application/snmp/UpstreamPool.h>
+#include <application/snmp/CacheScheduler.h>
 
 #include <boost/filesystem.hpp>
 
@@ -120,11 +125,20 @@ namespace application {
 
 	// ************************************************************************************
 	int32_t Application::run(const StartConfig& initialConfig) {
+		g_clock.update();
 		g_unixSignals.start();
 		g_unixSignals.registerSignalHandler(SIGTERM, [&](){ m_running = false; });
 		g_unixSignals.registerSignalHandler(SIGABRT, [&](){ m_running = false; });
 		g_unixSignals.registerSignalHandler(SIGINT, [&](){ m_running = false; });
 
+		// watki pomocnicze (resolver) budza petle przez eventfd
+		m_wakeupFd = io::FileDescriptor::Adapt(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+		if (!m_wakeupFd) {
+			g_logger.fatal(stdext::format("[Application::run] Could not create eventfd - %s", strerror(errno)));
+		}
+		m_wakeupFd->onReadReady([this](io::FileDescriptorPtr fd){ onWakeup(fd); });
+		g_dispatcher.setWakeupFd(m_wakeupFd->fd());
+
 	    try {
 			// scripting
 			if (!processConfig(initialConfig.configFile)) {
@@ -141,28 +155,43 @@ namespace application {
 				return 1;
 			}
 
+			// klienci przechodza do watkow puli przed pierwszym przebiegiem petli
+			g_upstreamPool.start(m_clients);
+			g_cacheScheduler.start();
+
 			m_running = true;
 
 			g_logger.info("Application started");
 
-			while(m_running) {
-				g_clock.update();
-				g_unixSignals.poll();
-				g_io.select(500);
-				g_snmpSocketsManager.poll();
-
-				for(auto& s: m_servers) {
-					s->poll();
-				}
-				for(auto& c: m_clients) {
-					c->poll();
-				}
+			core::ScheduledEventPtr logFlushEvent = g_dispatcher.cycleEvent(&core::LogRateLimiter::flushAll, LOG_FLUSH_INTERVAL);
 
+			// cala praca jest w callbackach deskryptorow (pakiety, polaczenia, sygnaly)
+			// i w zdarzeniach g_dispatcher'a (timeouty, odswiezanie cache, statystyki),
+			// select czeka do najblizszego zaplanowanego zdarzenia
+			while(m_running) {
+				g_io.select(g_dispatcher.nextTimeout(MAX_WAIT));
 				g_dispatcher.poll(false);
 			}
 
+			logFlushEvent->cancel();
+
+			g_resolver.stop();
+			g_upstreamPool.stop();
+			g_dispatcher.setWakeupFd(-1);
 			g_dispatcher.shutdown();
+
+			// deskryptory musza zostac zamkniete zanim zniknie g_io
+			// (kolejnosc niszczenia obiektow globalnych jest nieokreslona)
+			g_snmpSocketsManager.shutdown();
+			g_unixSignals.stop();
+			m_wakeupFd.reset();
+			m_metricsServer.reset();
+			g_cacheScheduler.clear();
+			m_servers.clear();
+			m_clients.clear();
+			g_upstreamPool.clear();
 			g_logger.info("Application stopped");
+			g_logger.stopAsync();
 
 	    } catch(const core::Exception& e) {
 			g_logger.warning(stdext::format("EXCEPTION:\n%s", e.what()));
@@ -173,6 +202,16 @@ namespace application {
 		return 0;
 	}
 
+	// ************************************************************************************
+	void Application::onWakeup(io::FileDescriptorPtr fd) {
+		// wystarczy wyzerowac licznik, zdarzenia odbierze g_dispatcher.poll()
+		uint64_t counter = 0;
+		ssize_t res = ::read(fd->fd(), &counter, sizeof(counter));
+		(void)res;
+
+		fd->onReadReady([this](io::FileDescriptorPtr fd){ onWakeup(fd); });
+	}
+
 
 	// ************************************************************************************
 	bool Application::processConfig(const std::string& path) {
@@ -198,6 +237,30 @@ namespace application {
 					}
 				}
 
+				if (e->name() == "logger" && e->hasValueBlock(0)) {
+					if (!processLoggerConfig(e->valueBlock(0))) {
+						return false;
+					}
+				}
+
+				if (e->name() == "metrics" && e->hasValueBlock(0)) {
+					if (!processMetricsConfig(e->valueBlock(0))) {
+						return false;
+					}
+				}
+
+				if (e->name() == "upstream" && e->hasValueBlock(0)) {
+					if (!g_upstreamPool.loadFromConfig(e->valueBlock(0))) {
+						return false;
+					}
+				}
+
+				if (e->name() == "cache-refresh" && e->hasValueBlock(0)) {
+					if (!g_cacheScheduler.loadFromConfig(e->valueBlock(0))) {
+						return false;
+					}
+				}
+
 			}
 
 		}
@@ -224,4 +287,60 @@ namespace application {
 		}
 	}
 
+	// ************************************************************************************
+	bool Application::processMetricsConfig(const config::parser::ConfigEntriesCollection& config) {
+		if (m_metricsServer) {
+			g_logger.warning("[Application::processMetricsConfig] Only one metrics block allowed");
+			return false;
+		}
+
+		m_metricsServer.reset(new snmp::MetricsServer(m_servers));
+		return m_metricsServer->loadFromConfig(config);
+	}
+
+	// ************************************************************************************
+	bool Application::processLoggerConfig(const config::parser::ConfigEntriesCollection& config) {
+		std::string mode = "sync";
+		int32_t bufferSize = 8192;
+		auto policy = core::LogOverflowPolicy::Drop;
+
+		for(auto& e: config) {
+			if (e->name() == "mode" && e->hasValuePrimitive(0)) {
+				mode = e->valuePrimitive(0);
+				continue;
+			}
+			if (e->name() == "buffer-size" && e->hasValueInt(0)) {
+				bufferSize = e->valueInt(0);
+				continue;
+			}
+			if (e->name() == "overflow" && e->hasValuePrimitive(0)) {
+				if (e->valuePrimitive(0) == "drop") {
+					policy = core::LogOverflowPolicy::Drop;
+				} else if (e->valuePrimitive(0) == "block") {
+					policy = core::LogOverflowPolicy::Block;
+				} else {
+					g_logger.warning(stdext::format("[Application::processLoggerConfig] Invalid overflow policy '%s'", e->valuePrimitive(0)));
+					return false;
+				}
+				continue;
+			}
+
+			g_logger.warning(stdext::format("[Application::processLoggerConfig] Unknown config entry '%s'", e->name()));
+		}
+
+		if (bufferSize <= 0) {
+			g_logger.warning("[Application::processLoggerConfig] Invalid buffer-size");
+			return false;
+		}
+
+		if (mode == "async") {
+			g_logger.startAsync(bufferSize, policy);
+		} else if (mode != "sync") {
+			g_logger.warning(stdext::format("[Application::processLoggerConfig] Invalid mode '%s'", mode));
+			return false;
+		}
+
+		return true;
+	}
+
 }
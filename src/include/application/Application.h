@@ -27,6 +27,7 @@
 #define INCLUDE_APPLICATION_APPLICATION_H_
 
 #include "base.h"
+#include <io/FileDescriptor.h>
 
 namespace application {
 
@@ -49,13 +50,23 @@ namespace application {
 			int32_t run(const StartConfig& config);
 
 		private:
+			// najdluzsze czekanie w select, gdy nic nie jest zaplanowane (ms)
+			static const int32_t MAX_WAIT = 1000;
+			static const int32_t LOG_FLUSH_INTERVAL = 1000;
+
 			volatile bool m_running;
 
 			std::vector<snmp::ProxyServerPtr> m_servers;
 			std::vector<snmp::ClientPtr> m_clients;
+			snmp::MetricsServerPtr m_metricsServer;
+			io::FileDescriptorPtr m_wakeupFd;
 
 			bool processConfig(const std::string& path);
 			bool processProxyConfig(const config::parser::ConfigEntriesCollection& config);
+			bool processMetricsConfig(const config::parser::ConfigEntriesCollection& config);
+			bool processLoggerConfig(const config::parser::ConfigEntriesCollection& config);
+
+			void onWakeup(io::FileDescriptorPtr fd);
 
 	};
 
@@ -59,6 +59,9 @@ namespace application {
 
 		class ProxyServerOIDSpec;
 		typedef stdext::object_ptr<ProxyServerOIDSpec> ProxyServerOIDSpecPtr;
+
+		class MetricsServer;
+		typedef stdext::object_ptr<MetricsServer> MetricsServerPtr;
 	}
 
 
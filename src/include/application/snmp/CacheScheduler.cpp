@@ -0,0 +1,215 @@
+/*
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @author: pregusia
+ * @part-of: preg-snmp-proxy
+ *
+ */
+
+
+#include "CacheScheduler.h"
+#include "ProxyServer.h"
+#include "Client.h"
+
+#include <algorithm>
+
+#include <core/clock.h>
+#include <stdext/math.h>
+#include <application/config/parser/ConfigEntry.h>
+
+application::snmp::CacheScheduler g_cacheScheduler;
+
+namespace application { namespace snmp {
+
+	// ************************************************************************************
+	CacheScheduler::CacheScheduler() {
+		m_maxUpdates = 8;
+		m_maxUpdatesPerTarget = 1;
+		m_jitter = 10;
+		m_running = 0;
+		m_dispatching = false;
+		m_started = false;
+	}
+
+	// ************************************************************************************
+	CacheScheduler::~CacheScheduler() {
+		clear();
+	}
+
+	// ************************************************************************************
+	bool CacheScheduler::loadFromConfig(const config::parser::ConfigEntriesCollection& entries) {
+		for(auto& e: entries) {
+			if (e->name() == "max-updates" && e->hasValueInt(0)) {
+				m_maxUpdates = e->valueInt(0);
+				continue;
+			}
+			if (e->name() == "max-updates-per-target" && e->hasValueInt(0)) {
+				m_maxUpdatesPerTarget = e->valueInt(0);
+				continue;
+			}
+			if (e->name() == "jitter" && e->hasValueInt(0)) {
+				m_jitter = e->valueInt(0);
+				continue;
+			}
+
+			g_logger.warning(stdext::format("[CacheScheduler::loadFromConfig] Unknown config entry '%s'", e->name()));
+		}
+
+		if (m_maxUpdates < 0 || m_maxUpdatesPerTarget < 0) {
+			g_logger.warning("[CacheScheduler::loadFromConfig] Invalid max-updates");
+			return false;
+		}
+		if (m_jitter < 0 || m_jitter > 50) {
+			g_logger.warning("[CacheScheduler::loadFromConfig] Invalid jitter (0 - 50 percent)");
+			return false;
+		}
+
+		return true;
+	}
+
+	// ************************************************************************************
+	void CacheScheduler::add(const ProxyServerCacheEntryPtr& entry) {
+		entry->m_nextUpdateTime = 0;
+		m_entries.push_back(entry);
+
+		// wpis dodany w trakcie dzialania (auto-cache)
+		if (m_started) {
+			arm();
+			g_dispatcher.post([this](){ dispatch(); });
+		}
+	}
+
+	// ************************************************************************************
+	void CacheScheduler::remove(const ProxyServerCacheEntryPtr& entry) {
+		m_entries.erase(std::remove(m_entries.begin(), m_entries.end(), entry), m_entries.end());
+	}
+
+	// ************************************************************************************
+	void CacheScheduler::start() {
+		m_started = true;
+		if (m_entries.empty()) return;
+
+		arm();
+		g_dispatcher.post([this](){ dispatch(); });
+	}
+
+	// ************************************************************************************
+	void CacheScheduler::arm() {
+		if (m_checkEvent) return;
+		m_checkEvent = g_dispatcher.cycleEvent([this](){ dispatch(); }, CHECK_INTERVAL);
+	}
+
+	// ************************************************************************************
+	void CacheScheduler::clear() {
+		if (m_checkEvent) {
+			m_checkEvent->cancel();
+			m_checkEvent.reset();
+		}
+		m_entries.clear();
+		m_runningPerTarget.clear();
+		m_running = 0;
+		m_started = false;
+	}
+
+	// ************************************************************************************
+	void CacheScheduler::onUpdateFinished(ProxyServerCacheEntry* entry) {
+		m_running -= 1;
+
+		auto it = m_runningPerTarget.find(entry->m_client.get());
+		if (it != m_runningPerTarget.end()) {
+			if (--it->second <= 0) m_runningPerTarget.erase(it);
+		}
+
+		dispatch();
+	}
+
+	// ************************************************************************************
+	void CacheScheduler::dispatch() {
+		// startUpdate moze wrocic tu przez onUpdateFinished
+		if (m_dispatching) return;
+		m_dispatching = true;
+
+		ticks_t now = g_clock.millis();
+		while(m_maxUpdates <= 0 || m_running < m_maxUpdates) {
+			ProxyServerCacheEntry* entry = pickNext(now);
+			if (entry == nullptr) break;
+			startUpdate(entry, now);
+		}
+
+		m_dispatching = false;
+	}
+
+	// ************************************************************************************
+	ProxyServerCacheEntry* CacheScheduler::pickNext(ticks_t now) {
+		ProxyServerCacheEntry* best = nullptr;
+
+		for(auto& ptr: m_entries) {
+			ProxyServerCacheEntry* e = ptr.get();
+			if (e->m_updating) continue;
+
+			// zapytania czekaja - bez terminu, chyba ze ostatnia proba sie nie udala
+			bool waiting = !e->m_waitingCalls.empty() && !e->m_startFailed;
+			if (!waiting && e->m_nextUpdateTime > now) continue;
+			if (!waiting && e->isDormant(now)) continue;
+
+			if (m_maxUpdatesPerTarget > 0) {
+				auto it = m_runningPerTarget.find(e->m_client.get());
+				if (it != m_runningPerTarget.end() && it->second >= m_maxUpdatesPerTarget) continue;
+			}
+
+			if (best == nullptr) {
+				best = e;
+				continue;
+			}
+
+			bool bestWaiting = !best->m_waitingCalls.empty() && !best->m_startFailed;
+			if (waiting != bestWaiting) {
+				if (waiting) best = e;
+				continue;
+			}
+			if (e->m_readCount != best->m_readCount) {
+				if (e->m_readCount > best->m_readCount) best = e;
+				continue;
+			}
+			if (e->m_nextUpdateTime < best->m_nextUpdateTime) best = e;
+		}
+
+		return best;
+	}
+
+	// ************************************************************************************
+	void CacheScheduler::startUpdate(ProxyServerCacheEntry* entry, ticks_t now) {
+		float interval = entry->nextUpdateInterval() * 1000.0f;
+		if (m_jitter > 0) {
+			interval *= 1.0f + stdext::randomRange(-m_jitter / 100.0f, m_jitter / 100.0f);
+		}
+
+		entry->m_startFailed = !entry->doUpdate();
+		if (entry->m_startFailed) {
+			entry->m_nextUpdateTime = now + FAILED_RETRY;
+			return;
+		}
+		entry->m_nextUpdateTime = now + static_cast<ticks_t>(interval);
+
+		m_running += 1;
+		m_runningPerTarget[entry->m_client.get()] += 1;
+	}
+
+} }
@@ -0,0 +1,98 @@
+/*
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @author: pregusia
+ * @part-of: preg-snmp-proxy
+ *
+ */
+
+
+#ifndef INCLUDE_APPLICATION_SNMP_CACHESCHEDULER_H_
+#define INCLUDE_APPLICATION_SNMP_CACHESCHEDULER_H_
+
+#include "base.h"
+
+#include <unordered_map>
+
+#include <core/eventdispatcher.h>
+
+namespace application { namespace snmp {
+
+	/**
+	 * Wspolny harmonogram aktualizacji wszystkich cache'y (tylko w watku glownym).
+	 * Ogranicza liczbe jednoczesnych aktualizacji globalnie i na target, a kolejny
+	 * termin kazdego wpisu jest przesuwany losowo o jitter procent update-interval,
+	 * zeby wpisy startujace razem rozjechaly sie w czasie.
+	 *
+	 * Z oczekujacych wpisow pierwsze ida te, na ktore czekaja zapytania klientow,
+	 * potem najczesciej czytane od poprzedniej aktualizacji, potem najdluzej zalegle.
+	 */
+	class CacheScheduler {
+		public:
+			CacheScheduler();
+			~CacheScheduler();
+
+			bool loadFromConfig(const config::parser::ConfigEntriesCollection& entries);
+
+			// pierwsza aktualizacja wpisu jest od razu (w ramach limitow)
+			void add(const ProxyServerCacheEntryPtr& entry);
+			// trwajaca aktualizacja konczy sie normalnie (onUpdateFinished)
+			void remove(const ProxyServerCacheEntryPtr& entry);
+
+			// po zaladowaniu konfiguracji
+			void start();
+			void clear();
+
+			// wpis ma nowe zapytania czekajace na dane
+			void wake() { dispatch(); }
+			// koniec aktualizacji wpisu (takze nieudanej)
+			void onUpdateFinished(ProxyServerCacheEntry* entry);
+
+			int32_t getRunningCount() const { return m_running; }
+
+		private:
+			// co ile (ms) sprawdzane sa terminy
+			static const int32_t CHECK_INTERVAL = 1000;
+			// ponowna proba (ms), gdy klient nie przyjal requestu
+			static const int32_t FAILED_RETRY = 10000;
+
+			int32_t m_maxUpdates;
+			int32_t m_maxUpdatesPerTarget;
+			int32_t m_jitter;
+
+			std::vector<ProxyServerCacheEntryPtr> m_entries;
+			int32_t m_running;
+			std::unordered_map<Client*, int32_t> m_runningPerTarget;
+
+			core::ScheduledEventPtr m_checkEvent;
+			bool m_dispatching;
+			bool m_started;
+
+			void arm();
+			void dispatch();
+			ProxyServerCacheEntry* pickNext(ticks_t now);
+			void startUpdate(ProxyServerCacheEntry* entry, ticks_t now);
+	};
+
+} }
+
+extern application::snmp::CacheScheduler g_cacheScheduler;
+
+#endif /* INCLUDE_APPLICATION_SNMP_CACHESCHEDULER_H_ */
@@ -37,9 +37,15 @@ namespace application { namespace snmp {
 // ##############################################################################################################################
 
 	// ************************************************************************************
-	ClientRequestBase::ClientRequestBase(int32_t requestID) {
-		m_requestID = requestID;
-		m_lastTime = g_clock.time();
+	ClientRequestBase::ClientRequestBase(int32_t handle, io::DataBuffer& buffer) : m_buffer(buffer) {
+		m_buffer.clear();
+		m_handle = handle;
+		m_requestID = 0;
+		m_requestIDOffset = 0;
+		m_deadline = 0;
+		m_queued = false;
+		m_attempt = 0;
+		m_sendTime = 0;
 	}
 
 	// ************************************************************************************
@@ -48,8 +54,16 @@ namespace application { namespace snmp {
 	}
 
 	// ************************************************************************************
-	bool ClientRequestBase::hasTimeouted() const {
-		return g_clock.time() - m_lastTime > 10;
+	void ClientRequestBase::setRequestID(int32_t requestID) {
+		m_requestID = requestID;
+
+		// INTEGER jest zawsze kodowany na 4 bajtach (SNMPOutputStreamAdapter::writeInt32)
+		if (m_requestIDOffset > 0 && m_requestIDOffset + 4 <= m_buffer.size()) {
+			m_buffer[m_requestIDOffset + 0] = (requestID >> 24) & 0xFF;
+			m_buffer[m_requestIDOffset + 1] = (requestID >> 16) & 0xFF;
+			m_buffer[m_requestIDOffset + 2] = (requestID >> 8) & 0xFF;
+			m_buffer[m_requestIDOffset + 3] = requestID & 0xFF;
+		}
 	}
 
 
@@ -59,8 +73,8 @@ namespace application { namespace snmp {
 // ##############################################################################################################################
 
 	// ************************************************************************************
-	ClientRequest_Raw::ClientRequest_Raw(int32_t requestID, const Callback& callback)
-		: ClientRequestBase(requestID), m_callback(callback)
+	ClientRequest_Raw::ClientRequest_Raw(int32_t handle, io::DataBuffer& buffer, Callback&& callback)
+		: ClientRequestBase(handle, buffer), m_callback(std::move(callback))
 	{
 
 	}
@@ -71,9 +85,7 @@ namespace application { namespace snmp {
 	}
 
 	// ************************************************************************************
-	bool ClientRequest_Raw::parseResponse(const Value& message, Client* client) {
-		m_lastTime = g_clock.time();
-
+	bool ClientRequest_Raw::parseResponse(const Value& message, Client*) {
 		auto& pdu = message[2];
 		auto error = SNMPError::fromPDU(pdu);
 
@@ -102,8 +114,8 @@ namespace application { namespace snmp {
 // ##############################################################################################################################
 
 	// ************************************************************************************
-	ClientRequest_GetBulk::ClientRequest_GetBulk(int32_t requestID, const OID& baseOID, const Callback& callback)
-		: ClientRequestBase(requestID), m_baseOID(baseOID), m_callback(callback)
+	ClientRequest_GetBulk::ClientRequest_GetBulk(int32_t handle, io::DataBuffer& buffer, const OID& baseOID, Callback&& callback)
+		: ClientRequestBase(handle, buffer), m_baseOID(baseOID), m_lastOID(baseOID), m_callback(std::move(callback))
 	{
 
 	}
@@ -115,8 +127,6 @@ namespace application { namespace snmp {
 
 	// ************************************************************************************
 	bool ClientRequest_GetBulk::parseResponse(const Value& message, Client* client) {
-		m_lastTime = g_clock.time();
-
 		auto varBindings = VarBindingRef::fromValue(message[2][3]);
 		OID oid;
 
@@ -133,30 +143,11 @@ namespace application { namespace snmp {
 		}
 
 		if (!oid.empty()) {
-			// trzeba wyslac pytanie o kolejne dane
-			m_requestID = nextRequestID();
-
-			io::DataBuffer buf;
-			io::DataBufferOutputStream os(buf, true);
-			SNMPOutputStreamAdapter snmpOS(os);
-
-			snmpOS.writeSeq(ValueType::SEQUENCE,[&](){
-				snmpOS.writeInt8(1);
-				snmpOS.writeString(client->getCommunity());
-				snmpOS.writeSeq(ValueType::PDU_GET_BULK,[&](){
-					snmpOS.writeInt32(m_requestID);
-					snmpOS.writeInt8(0); // non-repeaters
-					snmpOS.writeInt8(10); // max repetitions
-					snmpOS.writeSeq(ValueType::SEQUENCE,[&](){
-						snmpOS.writeSeq(ValueType::SEQUENCE,[&](){
-							snmpOS.writeOID(oid);
-							snmpOS.writeNull();
-						});
-					});
-				});
-			});
-
-			client->send(buf);
+			// trzeba wyslac pytanie o kolejne dane (ten sam slot, nowa generacja i nowy requestID)
+			// m_lastOID pozwala wznowic przejscie od miejsca, w ktorym jestesmy
+			m_lastOID = oid;
+			client->renewRequest(this);
+			encode(client);
 			return false;
 		} else {
 			// puste, znaczy ze nic nie dostalismy
@@ -165,6 +156,31 @@ namespace application { namespace snmp {
 		}
 	}
 
+	// ************************************************************************************
+	void ClientRequest_GetBulk::encode(Client* client) {
+		m_buffer.clear();
+
+		io::DataBufferOutputStream os(m_buffer, true);
+		SNMPOutputStreamAdapter snmpOS(os);
+
+		snmpOS.writeSeq(ValueType::SEQUENCE,[&](){
+			snmpOS.writeInt8(1);
+			snmpOS.writeString(client->getCommunity());
+			snmpOS.writeSeq(ValueType::PDU_GET_BULK,[&](){
+				m_requestIDOffset = os.tell() + 2;
+				snmpOS.writeInt32(m_requestID);
+				snmpOS.writeInt8(0); // non-repeaters
+				snmpOS.writeInt8(10); // max repetitions
+				snmpOS.writeSeq(ValueType::SEQUENCE,[&](){
+					snmpOS.writeSeq(ValueType::SEQUENCE,[&](){
+						snmpOS.writeOID(m_lastOID);
+						snmpOS.writeNull();
+					});
+				});
+			});
+		});
+	}
+
 	// ************************************************************************************
 	void ClientRequest_GetBulk::runCallback(const std::vector<VarBinding>& values, const SNMPError& error) {
 		if (m_callback) {
@@ -185,6 +201,211 @@ namespace application { namespace snmp {
 
 
 
+// ##############################################################################################################################
+// ClientRequest_GetBatch
+// ##############################################################################################################################
+
+	// ************************************************************************************
+	ClientRequest_GetBatch::ClientRequest_GetBatch(int32_t handle, io::DataBuffer& buffer, std::vector<ClientBatchEntry>& entries)
+		: ClientRequestBase(handle, buffer)
+	{
+		m_entries.swap(entries);
+	}
+
+	// ************************************************************************************
+	ClientRequest_GetBatch::~ClientRequest_GetBatch() {
+
+	}
+
+	// ************************************************************************************
+	void ClientRequest_GetBatch::encode(Client* client) {
+		m_buffer.clear();
+
+		io::DataBufferOutputStream os(m_buffer, true);
+		SNMPOutputStreamAdapter snmpOS(os);
+
+		snmpOS.writeSeq(ValueType::SEQUENCE,[&](){
+			snmpOS.writeInt8(1);
+			snmpOS.writeString(client->getCommunity());
+			snmpOS.writeSeq(ValueType::PDU_GET,[&](){
+				m_requestIDOffset = os.tell() + 2;
+				snmpOS.writeInt32(m_requestID);
+				snmpOS.writeInt8(0); // error
+				snmpOS.writeInt8(0); // error index
+				snmpOS.writeSeq(ValueType::SEQUENCE,[&](){
+					for(auto& e: m_entries) {
+						snmpOS.writeSeq(ValueType::SEQUENCE,[&](){
+							snmpOS.writeOID(e.name);
+							snmpOS.writeNull();
+						});
+					}
+				});
+			});
+		});
+	}
+
+	// ************************************************************************************
+	Value ClientRequest_GetBatch::makeMessage(const Value& message, const Value& varBinding, const SNMPError& error) const {
+		auto& pdu = message[2];
+
+		Value varBindings = Value::createSequence();
+		varBindings.addItem(varBinding);
+
+		Value resPDU = Value::createSequence(ValueType::PDU_RESPONSE);
+		resPDU.addItem(pdu[0]);
+		resPDU.addItem(Value::createInt(error.code));
+		resPDU.addItem(Value::createInt(error.index));
+		resPDU.addItem(varBindings);
+
+		Value res = Value::createSequence();
+		res.addItem(message[0]);
+		res.addItem(message[1]);
+		res.addItem(resPDU);
+		return res;
+	}
+
+	// ************************************************************************************
+	bool ClientRequest_GetBatch::parseResponse(const Value& message, Client* client) {
+		auto& pdu = message[2];
+		auto& varBindings = pdu[3];
+		auto error = SNMPError::fromPDU(pdu);
+		int32_t num = m_entries.size();
+
+		if (!error.hasError() && static_cast<int32_t>(varBindings.size()) == num) {
+			for(int32_t i=0;i<num;++i) {
+				auto msg = makeMessage(message, varBindings[i], SNMPError());
+				if (m_entries[i].callback) m_entries[i].callback(msg, SNMPError());
+			}
+			return true;
+		}
+
+		if (error.hasError() && error.code != SNMPError::SNMP_TOO_BIG && error.index == 0) {
+			// blad calego PDU - dotyczy wszystkich
+			for(int32_t i=0;i<num;++i) {
+				auto msg = makeMessage(message, VarBinding{ m_entries[i].name, Value::createNull() }.toValue(), error);
+				if (m_entries[i].callback) m_entries[i].callback(msg, error);
+			}
+			return true;
+		}
+
+		// blad konkretnego varbinding'u (index liczony od 1) albo odpowiedz za duza/niekompletna:
+		// winny dostaje blad z indeksem 1, reszta jest pytana pojedynczo
+		int32_t guilty = -1;
+		if (error.hasError() && error.index >= 1 && error.index <= num && static_cast<int32_t>(varBindings.size()) == num) {
+			guilty = error.index - 1;
+		}
+
+		for(int32_t i=0;i<num;++i) {
+			if (i == guilty) {
+				SNMPError ownError(error.code, 1);
+				auto msg = makeMessage(message, varBindings[i], ownError);
+				if (m_entries[i].callback) m_entries[i].callback(msg, ownError);
+			} else {
+				Value single = Value::createSequence();
+				single.addItem(VarBinding{ m_entries[i].name, Value::createNull() }.toValue());
+
+				Value reqPDU = Value::createSequence(ValueType::PDU_GET);
+				reqPDU.addItem(Value::createInt(0));
+				reqPDU.addItem(Value::createInt(0));
+				reqPDU.addItem(Value::createInt(0));
+				reqPDU.addItem(single);
+
+				// callback jest przenoszony tylko jezeli request zostal utworzony
+				if (!client->doRequestDirect(reqPDU, std::move(m_entries[i].callback), ClientRequestPriority::CLIENT)) {
+					auto val = Value::createNull();
+					if (m_entries[i].callback) m_entries[i].callback(val, SNMPError(SNMPError::APP_TIMEOUT, 0));
+				}
+			}
+		}
+
+		return true;
+	}
+
+	// ************************************************************************************
+	void ClientRequest_GetBatch::runCallbackError(const SNMPError& error) {
+		for(auto& e: m_entries) {
+			if (e.callback) {
+				auto val = Value::createNull();
+				e.callback(val, error);
+			}
+		}
+	}
+
+
+
+// ##############################################################################################################################
+// ClientRequestTable
+// ##############################################################################################################################
+
+	// ************************************************************************************
+	ClientRequestTable::ClientRequestTable() {
+		m_used = 0;
+	}
+
+	// ************************************************************************************
+	ClientRequestTable::~ClientRequestTable() {
+		for(auto& slot: m_slots) {
+			if (slot.request != nullptr) {
+				slot.request->~ClientRequestBase();
+				slot.request = nullptr;
+			}
+		}
+	}
+
+	// ************************************************************************************
+	int32_t ClientRequestTable::allocSlot() {
+		if (!m_freeSlots.empty()) {
+			int32_t slot = m_freeSlots.back();
+			m_freeSlots.pop_back();
+			return slot;
+		}
+
+		if (static_cast<int32_t>(m_slots.size()) >= MAX_SLOTS) {
+			return -1;
+		}
+
+		m_slots.push_back(Slot());
+		return m_slots.size() - 1;
+	}
+
+	// ************************************************************************************
+	ClientRequestBase* ClientRequestTable::find(int32_t handle) const {
+		int32_t slot = slotOf(handle);
+		if (slot >= static_cast<int32_t>(m_slots.size())) return nullptr;
+
+		ClientRequestBase* req = m_slots[slot].request;
+		if (req == nullptr) return nullptr;
+		if (req->getHandle() != handle) return nullptr;
+		return req;
+	}
+
+	// ************************************************************************************
+	void ClientRequestTable::renew(ClientRequestBase* req) {
+		int32_t slotIndex = slotOf(req->getHandle());
+		Slot& slot = m_slots[slotIndex];
+
+		slot.generation = (slot.generation + 1) & GENERATION_MASK;
+		if (slot.generation == 0) slot.generation = 1;
+
+		req->setHandle(makeHandle(slotIndex, slot.generation));
+	}
+
+	// ************************************************************************************
+	void ClientRequestTable::release(ClientRequestBase* req) {
+		int32_t slotIndex = slotOf(req->getHandle());
+		Slot& slot = m_slots[slotIndex];
+
+		req->~ClientRequestBase();
+		slot.request = nullptr;
+		slot.generation = (slot.generation + 1) & GENERATION_MASK;
+		if (slot.generation == 0) slot.generation = 1;
+
+		m_freeSlots.push_back(slotIndex);
+		m_used.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+
+
 // ##############################################################################################################################
 // Client
 // ##############################################################################################################################
@@ -192,61 +413,305 @@ namespace application { namespace snmp {
 	// ************************************************************************************
 	Client::Client(const io::InetEndpoint& source, const io::InetEndpoint& dest, const std::string& community) {
 		m_community = community;
+		m_sourceEndpoint = source;
 		m_destEndpoint = dest;
+		m_dispatcher = &g_dispatcher;
+		m_threaded = false;
+		m_jobsPending = false;
+		m_sentCount = 0;
+		m_requestTimeout = 10000;
+		m_retries = 0;
+		m_backoff = 2.0f;
+		m_maxInFlight = 0;
+		m_inFlight = 0;
+		m_window = 0.0f;
+		m_lastWindowDecrease = 0;
+		m_queueTimeout = 10000;
+		m_batchMaxVarBindings = 0;
+		m_batchMaxBytes = 1024;
+		m_batchWindow = 0;
+		m_batchBytes = 0;
+		m_batchSerial = 0;
 		m_socket = g_snmpSocketsManager.ensureClientSocket(source, dynamic_self_cast<Client>());
 	}
 
 	// ************************************************************************************
 	Client::~Client() {
 		// TODO: wywalic oczekujace requesty z bledami
+		if (m_timeoutEvent) m_timeoutEvent->cancel();
+		if (m_batchFlushEvent) m_batchFlushEvent->cancel();
+		if (m_socket) m_socket->unregisterClient(this);
 	}
 
 	// ************************************************************************************
-	void Client::poll() {
-		// timeouts
-		if (true) {
-			for(auto it=m_requests.begin();it != m_requests.end();++it) {
-				if (it->second->hasTimeouted()) {
-					// za dlugo czeka, usuwmy
-					it->second->runCallbackError(SNMPError(SNMPError::APP_TIMEOUT, 0));
-					delete it->second;
-					it = m_requests.erase(it);
-				}
+	void Client::setThreaded(core::EventDispatcher* dispatcher) {
+		m_dispatcher = dispatcher;
+		m_threaded = true;
+	}
+
+	// ************************************************************************************
+	void Client::inLoop(Job&& func) {
+		if (!m_threaded) {
+			func();
+			return;
+		}
+
+		// jedno zdarzenie w petli na serie zadan - flaga zerowana przez runJobs przed oproznianiem
+		m_jobs.push(std::move(func));
+		if (!m_jobsPending.exchange(true)) {
+			wakeLoop(m_dispatcher.load());
+		}
+	}
+
+	// ************************************************************************************
+	void Client::wakeLoop(core::EventDispatcher* dispatcher) {
+		ClientPtr self = static_self_cast<Client>();
+		dispatcher->pushEventSynchronized([self, dispatcher](){ self->runJobs(dispatcher); });
+	}
+
+	// ************************************************************************************
+	void Client::runJobs(core::EventDispatcher* dispatcher) {
+		// klient zostal w miedzyczasie przeniesiony - zadania wykona nowa petla
+		// (zdarzenie dojdzie tam po przejeciu socketu, kolejka jest FIFO)
+		core::EventDispatcher* current = m_dispatcher.load();
+		if (current != dispatcher) {
+			wakeLoop(current);
+			return;
+		}
+
+		m_jobsPending.exchange(false);
+
+		Job func;
+		while(m_jobs.pop(func)) {
+			func();
+			func = nullptr;
+		}
+	}
+
+	// ************************************************************************************
+	bool Client::isIdle() const {
+		return m_requests.size() == 0 && m_batch.empty();
+	}
+
+	// ************************************************************************************
+	void Client::checkIdle() {
+		if (m_idleCallback && isIdle()) m_idleCallback();
+	}
+
+	// ************************************************************************************
+	void Client::moveTo(core::EventDispatcher* dispatcher) {
+		// timery sa w kole starej petli, bez requestow zostaly tylko nieaktualne terminy
+		if (m_timeoutEvent) m_timeoutEvent->cancel();
+		if (m_batchFlushEvent) m_batchFlushEvent->cancel();
+		m_timeoutEvent.reset();
+		m_batchFlushEvent.reset();
+		m_deadlines = std::priority_queue<ClientRequestDeadline>();
+
+		m_dispatcher.store(dispatcher);
+	}
+
+	// ************************************************************************************
+	void Client::pushDeadline(ClientRequestBase* req) {
+		m_deadlines.push(ClientRequestDeadline(req->getDeadline(), req->getHandle()));
+		armTimeout(req->getDeadline());
+	}
+
+	// ************************************************************************************
+	void Client::armTimeout(ticks_t deadline) {
+		// timer ustawiony na wczesniej obsluzy tez ten termin i przestawi sie na kolejny
+		if (m_timeoutEvent && m_timeoutEvent->ticks() <= deadline) return;
+
+		if (m_timeoutEvent) m_timeoutEvent->cancel();
+		m_timeoutEvent = dispatcher().scheduleEvent([this](){ processTimeouts(); }, std::max<ticks_t>(0, deadline - g_clock.millis()));
+	}
+
+	// ************************************************************************************
+	void Client::processTimeouts() {
+		m_timeoutEvent.reset();
+		ticks_t now = g_clock.millis();
+
+		while(!m_deadlines.empty() && m_deadlines.top().deadline <= now) {
+			ClientRequestDeadline d = m_deadlines.top();
+			m_deadlines.pop();
+
+			ClientRequestBase* req = m_requests.find(d.handle);
+			if (req == nullptr) continue; // juz obsluzony
+			if (req->getDeadline() != d.deadline) continue; // termin przesuniety
+
+			if (req->isQueued()) {
+				// nie doczekal sie na miejsce w oknie
+				// wpis w kolejce zostanie pominiety przy pumpQueue
+				req->runCallbackError(SNMPError(SNMPError::APP_TIMEOUT, 0));
+				releaseRequest(req);
+				continue;
+			}
+
+			windowDecrease();
+
+			if (req->getAttempt() < m_retries) {
+				// wysylamy jeszcze raz ten sam PDU
+				req->nextAttempt();
+				sendRequest(req);
+				continue;
+			}
+
+			// za dlugo czeka, usuwmy
+			req->runCallbackError(SNMPError(SNMPError::APP_TIMEOUT, 0));
+			finishRequest(req);
+		}
+
+		pumpQueue();
+
+		if (!m_deadlines.empty()) {
+			armTimeout(m_deadlines.top().deadline);
+		}
+
+		checkIdle();
+	}
+
+	// ************************************************************************************
+	void Client::setMaxInFlight(int32_t num) {
+		m_maxInFlight = num;
+		m_window.store(std::min(4, num), std::memory_order_relaxed);
+	}
+
+	// ************************************************************************************
+	bool Client::canSend() const {
+		if (m_maxInFlight <= 0) return true;
+		return getInFlightCount() < std::max(1, static_cast<int32_t>(getWindow()));
+	}
+
+	// ************************************************************************************
+	void Client::windowIncrease() {
+		if (m_maxInFlight <= 0) return;
+
+		float window = getWindow();
+		window += 1.0f / std::max(1.0f, window);
+		if (window > m_maxInFlight) window = m_maxInFlight;
+		m_window.store(window, std::memory_order_relaxed);
+	}
+
+	// ************************************************************************************
+	void Client::windowDecrease() {
+		if (m_maxInFlight <= 0) return;
+
+		// jedno zmniejszenie na okres timeoutu, zeby seria timeoutow
+		// z tego samego zdarzenia nie zbijala okna do zera
+		ticks_t now = g_clock.millis();
+		if (now - m_lastWindowDecrease < m_requestTimeout) return;
+
+		m_lastWindowDecrease = now;
+		m_window.store(std::max(1.0f, getWindow() / 2.0f), std::memory_order_relaxed);
+	}
+
+	// ************************************************************************************
+	void Client::submitRequest(ClientRequestBase* req, ClientRequestPriority::Enum priority) {
+		if (canSend()) {
+			m_inFlight.fetch_add(1, std::memory_order_relaxed);
+			sendRequest(req);
+		} else {
+			req->setQueued(true);
+			req->setDeadline(g_clock.millis() + m_queueTimeout);
+			pushDeadline(req);
+			m_queues[priority == ClientRequestPriority::REFRESH ? 0 : 1].push_back(req->getHandle());
+		}
+	}
+
+	// ************************************************************************************
+	void Client::finishRequest(ClientRequestBase* req) {
+		if (!req->isQueued()) {
+			m_inFlight.fetch_sub(1, std::memory_order_relaxed);
+		}
+		releaseRequest(req);
+	}
+
+	// ************************************************************************************
+	void Client::releaseRequest(ClientRequestBase* req) {
+		if (req->getRequestID() != 0) {
+			m_socket->unregisterRequest(req->getRequestID());
+		}
+		m_requests.release(req);
+	}
+
+	// ************************************************************************************
+	void Client::pumpQueue() {
+		for(auto& queue: m_queues) {
+			while(!queue.empty() && canSend()) {
+				ClientRequestBase* req = m_requests.find(queue.front());
+				queue.pop_front();
+
+				if (req == nullptr) continue; // timeout w kolejce
+				if (!req->isQueued()) continue;
+
+				req->setQueued(false);
+				m_inFlight.fetch_add(1, std::memory_order_relaxed);
+				sendRequest(req);
 			}
 		}
 	}
 
 	// ************************************************************************************
-	bool Client::handleMessage(const io::InetEndpoint& source, const Value& message) {
+	void Client::renewRequest(ClientRequestBase* req) {
+		// spozniona odpowiedz na poprzednia strone nie trafi juz do tego requestu
+		if (req->getRequestID() != 0) {
+			m_socket->unregisterRequest(req->getRequestID());
+			req->setRequestID(0);
+		}
+		m_requests.renew(req);
+	}
+
+	// ************************************************************************************
+	void Client::sendRequest(ClientRequestBase* req) {
+		// requestID dopiero przy wysylce (kolejka go nie zajmuje), retransmisje ida z tym samym
+		if (req->getRequestID() == 0) {
+			req->setRequestID(m_socket->registerRequest(this, req->getHandle()));
+		}
+
+		req->setSendTime(stdext::Time::micros());
+		m_sentCount.fetch_add(1, std::memory_order_relaxed);
+		send(req->getBuffer());
+		armTimeout(req);
+	}
+
+	// ************************************************************************************
+	void Client::armTimeout(ClientRequestBase* req) {
+		ticks_t timeout = m_requestTimeout;
+		for(int32_t i=0;i<req->getAttempt();++i) {
+			timeout = static_cast<ticks_t>(timeout * m_backoff);
+		}
+
+		req->setDeadline(g_clock.millis() + timeout);
+		pushDeadline(req);
+	}
+
+	// ************************************************************************************
+	bool Client::handleMessage(const Value& message, int32_t handle, ticks_t receiveTime) {
 		if (message.type() == ValueType::SEQUENCE && message.size() == 3) {
 			auto& pdu = message[2];
 
 			if (pdu.type() == ValueType::PDU_RESPONSE && pdu.size() == 4) {
 				int32_t requestID = pdu[0].valueInt();
 
-				auto requestIt = m_requests.find(requestID);
-				if (requestIt != m_requests.end()) {
-					ClientRequestBase* req = requestIt->second;
-
-					int32_t oldRequestID = req->getRequestID();
-					if (req->parseResponse(message, this)) {
-						// trzeba usunac
-						delete req;
-						m_requests.erase(requestIt);
-					} else {
-						int32_t newRequestID = req->getRequestID();
-
-						if (oldRequestID != newRequestID) {
-							// zmienilo sie, zamieniamy w mapie
-							m_requests.erase(requestIt);
-							m_requests[newRequestID] = req;
-						}
-					}
+				// odpowiedz jest nasza tylko jezeli pasuje do aktualnego requestID tego requestu
+				ClientRequestBase* req = m_requests.find(handle);
+				if (req == nullptr || req->isQueued() || req->getRequestID() != requestID) {
+					LOG_WARNING_LIMITED(stdext::format("[Client::handleResponse] Could not find request #%d", requestID));
+					return false;
+				}
 
+				windowIncrease();
+				m_roundTripHistogram.record(receiveTime - req->getSendTime());
+
+				if (req->parseResponse(message, this)) {
+					// trzeba usunac
+					finishRequest(req);
+					pumpQueue();
 				} else {
-					g_logger.warning(stdext::format("[Client::handleResponse] Could not find request #%d", requestID));
+					req->resetAttempts();
+					sendRequest(req);
 				}
 
+				checkIdle();
 				return true;
 			}
 		}
@@ -260,61 +725,129 @@ namespace application { namespace snmp {
 	}
 
 	// ************************************************************************************
-	bool Client::doRequest(Value pdu, const ClientRequest_Raw::Callback& func) {
+	bool Client::doRequest(const Value& pdu, ClientRequest_Raw::Callback&& func, ClientRequestPriority::Enum priority) {
 		if (!pdu.isPDU()) return false;
 
-		int32_t requestID = nextRequestID();
-		m_requests[requestID] = new ClientRequest_Raw(requestID, func);
+		if (m_batchMaxVarBindings > 1 && pdu.type() == ValueType::PDU_GET && pdu.size() == 4) {
+			auto& varBindings = pdu[3];
+			if (varBindings.size() == 1 && varBindings[0].isSequence() && varBindings[0].size() == 2) {
+				return addToBatch(varBindings[0][0].valueOID(), std::move(func));
+			}
+		}
 
-		pdu[0] = Value::createInt(requestID);
+		return doRequestDirect(pdu, std::move(func), priority);
+	}
 
-		if (true) {
-			io::DataBuffer buf;
-			io::DataBufferOutputStream os(buf, true);
-			SNMPOutputStreamAdapter snmpOS(os);
+	// ************************************************************************************
+	bool Client::addToBatch(const OID& name, ClientRequest_Raw::Callback&& func) {
+		if (name.empty()) return false;
+
+		// przyblizony rozmiar zakodowanego varbinding'u: naglowki sekwencji + OID + NULL
+		int32_t bytes = 4 + 2 + 2;
+		for(size_t i=0;i<name.size();++i) {
+			uint32_t v = name[i];
+			bytes += v < 0x80 ? 1 : v < 0x4000 ? 2 : v < 0x200000 ? 3 : 5;
+		}
 
-			snmpOS.writeSeq(ValueType::SEQUENCE,[&](){
-				snmpOS.writeInt8(1);
-				snmpOS.writeString(m_community);
-				snmpOS.writeValue(pdu);
-			});
+		if (!m_batch.empty() && m_batchBytes + bytes > m_batchMaxBytes) {
+			flushBatch();
+		}
+
+		if (m_batch.empty()) {
+			m_batchBytes = 0;
+
+			if (m_batchWindow > 0) {
+				m_batchFlushEvent = dispatcher().scheduleEvent([this](){ m_batchFlushEvent.reset(); flushBatch(); }, (m_batchWindow + 999) / 1000);
+			} else {
+				// okno 0 - wysylka na koncu biezacego przebiegu petli, przez post() bez alokacji;
+				// tego nie da sie anulowac, wiec wczesniejszy flushBatch() zmienia numer partii
+				// i zadanie nic nie robi (kolejka jest FIFO - wykona sie przed ewentualnym moveTo())
+				uint32_t serial = m_batchSerial;
+				ClientPtr self = static_self_cast<Client>();
+				dispatcher().post([self, serial](){
+					if (self->m_batchSerial == serial) self->flushBatch();
+				});
+			}
+		}
+
+		m_batch.push_back(ClientBatchEntry(name, std::move(func)));
+		m_batchBytes += bytes;
 
-			send(buf);
+		if (static_cast<int32_t>(m_batch.size()) >= m_batchMaxVarBindings) {
+			flushBatch();
 		}
 
 		return true;
 	}
 
 	// ************************************************************************************
-	bool Client::doGetBulk(const OID& baseOID, const ClientRequest_GetBulk::Callback& func) {
-		int32_t requestID = nextRequestID();
-		m_requests[requestID] = new ClientRequest_GetBulk(requestID, baseOID, func);
+	void Client::flushBatch() {
+		m_batchSerial += 1;
+		if (m_batchFlushEvent) {
+			m_batchFlushEvent->cancel();
+			m_batchFlushEvent.reset();
+		}
+		if (m_batch.empty()) return;
+
+		std::vector<ClientBatchEntry> entries;
+		entries.swap(m_batch);
+		m_batchBytes = 0;
+
+		ClientRequest_GetBatch* req = m_requests.create<ClientRequest_GetBatch>(entries);
+		if (req == nullptr) {
+			LOG_WARNING_LIMITED("[Client::flushBatch] Too many pending requests");
+			for(auto& e: entries) {
+				auto val = Value::createNull();
+				if (e.callback) e.callback(val, SNMPError(SNMPError::APP_TIMEOUT, 0));
+			}
+			return;
+		}
+
+		req->encode(this);
+		submitRequest(req, ClientRequestPriority::CLIENT);
+	}
+
+	// ************************************************************************************
+	bool Client::doRequestDirect(const Value& pdu, ClientRequest_Raw::Callback&& func, ClientRequestPriority::Enum priority) {
+		ClientRequestBase* req = m_requests.create<ClientRequest_Raw>(std::move(func));
+		if (req == nullptr) {
+			LOG_WARNING_LIMITED("[Client::doRequest] Too many pending requests");
+			return false;
+		}
 
 		if (true) {
-			io::DataBuffer buf;
-			io::DataBufferOutputStream os(buf, true);
+			io::DataBufferOutputStream os(req->getBuffer(), true);
 			SNMPOutputStreamAdapter snmpOS(os);
 
+			// PDU pytajacego jest kodowane bez kopiowania, podmieniamy tylko requestID
 			snmpOS.writeSeq(ValueType::SEQUENCE,[&](){
-
 				snmpOS.writeInt8(1);
 				snmpOS.writeString(m_community);
-				snmpOS.writeSeq(ValueType::PDU_GET_BULK,[&](){
-					snmpOS.writeInt32(requestID);
-					snmpOS.writeInt8(0); // non-repeaters
-					snmpOS.writeInt8(10); // max repetitions
-					snmpOS.writeSeq(ValueType::SEQUENCE,[&](){
-						snmpOS.writeSeq(ValueType::SEQUENCE,[&](){
-							snmpOS.writeOID(baseOID);
-							snmpOS.writeNull();
-						});
-					});
+				snmpOS.writeSeq(pdu.type(),[&](){
+					req->setRequestIDOffset(os.tell() + 2);
+					snmpOS.writeInt32(req->getRequestID());
+					for(size_t i=1;i<pdu.size();++i) {
+						snmpOS.writeValue(pdu[i]);
+					}
 				});
 			});
+		}
+
+		submitRequest(req, priority);
+		return true;
+	}
 
-			send(buf);
+	// ************************************************************************************
+	bool Client::doGetBulk(const OID& baseOID, ClientRequest_GetBulk::Callback&& func, ClientRequestPriority::Enum priority) {
+		ClientRequest_GetBulk* req = m_requests.create<ClientRequest_GetBulk>(baseOID, std::move(func));
+		if (req == nullptr) {
+			LOG_WARNING_LIMITED("[Client::doGetBulk] Too many pending requests");
+			return false;
 		}
 
+		req->encode(this);
+		submitRequest(req, priority);
+
 		return true;
 	}
 
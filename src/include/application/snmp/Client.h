@@ -28,34 +28,77 @@
 
 #include "base.h"
 #include "Value.h"
+#include "Statistics.h"
 
 #include <io/buffers.h>
 #include <io/InetEndpoint.h>
+#include <core/eventdispatcher.h>
+
+#include <queue>
+#include <atomic>
 
 namespace application { namespace snmp {
 
+	ENUM_DEFINE(ClientRequestPriority,
+		CLIENT = 0,
+		REFRESH = 1,
+	);
 
 	class ClientRequestBase {
 		public:
-			ClientRequestBase(int32_t requestID);
+			ClientRequestBase(int32_t handle, io::DataBuffer& buffer);
 			virtual ~ClientRequestBase();
 
+			// uchwyt w ClientRequestTable klienta
+			int32_t getHandle() const { return m_handle; }
+			void setHandle(int32_t handle) { m_handle = handle; }
+
+			// requestID w wyslanym PDU - nadawany przez socket przy pierwszym wyslaniu, 0 - jeszcze nie wyslany
 			int32_t getRequestID() const { return m_requestID; }
+			// zapisuje tez requestID w zakodowanym PDU (miejsce wskazane przez setRequestIDOffset)
+			void setRequestID(int32_t requestID);
+			void setRequestIDOffset(size_t offset) { m_requestIDOffset = offset; }
+
+			ticks_t getDeadline() const { return m_deadline; }
+			void setDeadline(ticks_t deadline) { m_deadline = deadline; }
+
+			bool isQueued() const { return m_queued; }
+			void setQueued(bool queued) { m_queued = queued; }
+
+			int32_t getAttempt() const { return m_attempt; }
+			void nextAttempt() { m_attempt += 1; }
+			void resetAttempts() { m_attempt = 0; }
 
-			bool hasTimeouted() const;
+			ticks_t getSendTime() const { return m_sendTime; }
+			void setSendTime(ticks_t time) { m_sendTime = time; }
+
+			// zakodowany PDU, wysylany ponownie przy retransmisji
+			const io::DataBuffer& getBuffer() const { return m_buffer; }
+			io::DataBuffer& getBuffer() { return m_buffer; }
+
+			/**
+			 * Zwraca true jezeli request jest zakonczony.
+			 * false oznacza, ze request przygotowal w buforze kolejny PDU do wyslania
+			 */
 			virtual bool parseResponse(const Value& message, Client* client) = 0;
 			virtual void runCallbackError(const SNMPError& error) = 0;
 
 		protected:
+			int32_t m_handle;
 			int32_t m_requestID;
-			ticks_t m_lastTime;
+			size_t m_requestIDOffset;
+			ticks_t m_deadline;
+			bool m_queued;
+			int32_t m_attempt;
+			ticks_t m_sendTime;
+			io::DataBuffer& m_buffer;
 	};
 
 	class ClientRequest_Raw: public ClientRequestBase {
 		public:
-			typedef std::function<void(const Value& responseMessage, const SNMPError& error)> Callback;
+			typedef stdext::inplace_function<void(const Value& responseMessage, const SNMPError& error)> Callback;
 
-			ClientRequest_Raw(int32_t requestID, const Callback& callback);
+			ClientRequest_Raw(int32_t handle, io::DataBuffer& buffer, Callback&& callback);
 			virtual ~ClientRequest_Raw();
 
 			virtual bool parseResponse(const Value& message, Client* client);
@@ -69,9 +112,9 @@ namespace application { namespace snmp {
 
 	class ClientRequest_GetBulk: public ClientRequestBase {
 		public:
-			typedef std::function<void(const std::vector<VarBinding>& values, const SNMPError& error)> Callback;
+			typedef stdext::inplace_function<void(const std::vector<VarBinding>& values, const SNMPError& error)> Callback;
 
-			ClientRequest_GetBulk(int32_t requestID, const OID& baseOID, const Callback& callback);
+			ClientRequest_GetBulk(int32_t handle, io::DataBuffer& buffer, const OID& baseOID, Callback&& callback);
 			virtual ~ClientRequest_GetBulk();
 
 			virtual bool parseResponse(const Value& message, Client* client);
@@ -79,8 +122,11 @@ namespace application { namespace snmp {
 			void runCallback(const std::vector<VarBinding>& values, const SNMPError& error);
 			virtual void runCallbackError(const SNMPError& error);
 
+			void encode(Client* client);
+
 		private:
 			OID m_baseOID;
+			OID m_lastOID;
 			Callback m_callback;
 			std::vector<VarBinding> m_values;
 	};
@@ -89,26 +135,259 @@ namespace application { namespace snmp {
 
 
 
+	class ClientBatchEntry {
+		public:
+			OID name;
+			ClientRequest_Raw::Callback callback;
+
+			ClientBatchEntry(const OID& name, ClientRequest_Raw::Callback&& callback) : name(name), callback(std::move(callback)) { }
+	};
+
+	/**
+	 * Kilka pojedynczych GET (od roznych klientow) wyslanych jako jeden PDU.
+	 * Odpowiedz jest rozdzielana z powrotem na pojedyncze wiadomosci.
+	 */
+	class ClientRequest_GetBatch: public ClientRequestBase {
+		public:
+			ClientRequest_GetBatch(int32_t handle, io::DataBuffer& buffer, std::vector<ClientBatchEntry>& entries);
+			virtual ~ClientRequest_GetBatch();
+
+			virtual bool parseResponse(const Value& message, Client* client);
+			virtual void runCallbackError(const SNMPError& error);
+
+			void encode(Client* client);
+
+		private:
+			std::vector<ClientBatchEntry> m_entries;
+
+			Value makeMessage(const Value& message, const Value& varBinding, const SNMPError& error) const;
+	};
+
+
+
+	/**
+	 * Tablica oczekujacych requestow.
+	 * Uchwyt = [generacja (11 bitow)][numer slotu (20 bitow)], wiec wyszukanie
+	 * to jedno indeksowanie, a nieaktualny uchwyt (terminy, kolejka) jest odrzucany.
+	 * Uchwyt jest lokalny dla klienta - requestID w PDU nadaje socket (Socket::registerRequest).
+	 * Obiekty requestow sa konstruowane bezposrednio w slotach (bez new/delete),
+	 * zwolnione sloty sa uzywane ponownie (razem z buforem zakodowanego PDU).
+	 */
+	class ClientRequestTable {
+		public:
+			static const int32_t SLOT_BITS = 20;
+			static const int32_t SLOT_MASK = (1 << SLOT_BITS) - 1;
+			static const int32_t MAX_SLOTS = 1 << SLOT_BITS;
+			static const int32_t GENERATION_MASK = 0x7FF;
+
+			ClientRequestTable();
+			~ClientRequestTable();
+
+			// czytane tez z watku glownego (metryki), zapisywane tylko w watku klienta
+			size_t size() const { return m_used.load(std::memory_order_relaxed); }
+
+			template<typename T, typename... Args>
+			T* create(Args&&... args) {
+				static_assert(sizeof(T) <= sizeof(Slot::storage), "ClientRequestTable slot too small for request type");
+
+				int32_t slotIndex = allocSlot();
+				if (slotIndex < 0) return nullptr;
+
+				Slot& slot = m_slots[slotIndex];
+				T* req = new(&slot.storage) T(makeHandle(slotIndex, slot.generation), slot.buffer, std::forward<Args>(args)...);
+				slot.request = req;
+				m_used.fetch_add(1, std::memory_order_relaxed);
+				return req;
+			}
+
+			ClientRequestBase* find(int32_t handle) const;
+			void renew(ClientRequestBase* req);
+			void release(ClientRequestBase* req);
+
+		private:
+			static const std::size_t STORAGE_SIZE = stdext::max_sizeof<ClientRequest_Raw, ClientRequest_GetBulk, ClientRequest_GetBatch>::value;
+
+			class Slot {
+				public:
+					int32_t generation;
+					ClientRequestBase* request;
+					io::DataBuffer buffer; // zostaje po zwolnieniu requestu, razem z pamiecia
+					std::aligned_storage<STORAGE_SIZE, alignof(std::max_align_t)>::type storage;
+
+					Slot() : generation(1), request(nullptr), storage() { }
+			};
+
+			// deque, bo nie przenosi elementow przy rozrastaniu
+			std::deque<Slot> m_slots;
+			Int32Vector m_freeSlots;
+			std::atomic<size_t> m_used;
+
+			int32_t allocSlot();
+
+			static int32_t makeHandle(int32_t slot, int32_t generation) { return (generation << SLOT_BITS) | slot; }
+			static int32_t slotOf(int32_t handle) { return handle & SLOT_MASK; }
+
+			ClientRequestTable(const ClientRequestTable& from);
+			ClientRequestTable& operator=(const ClientRequestTable& from);
+	};
+
+
+
+	class ClientRequestDeadline {
+		public:
+			ticks_t deadline;
+			int32_t handle;
+
+			ClientRequestDeadline(ticks_t deadline, int32_t handle) : deadline(deadline), handle(handle) { }
+
+			// odwrocone, zeby priority_queue trzymalo najblizszy termin na gorze
+			bool operator<(const ClientRequestDeadline& other) const { return deadline > other.deadline; }
+	};
+
+
+
 	class Client: public stdext::object {
 		public:
+			typedef core::EventDispatcher::SyncCallback Job;
+
 			Client(const io::InetEndpoint& source, const io::InetEndpoint& dest, const std::string& community);
 			virtual ~Client();
 
+			const io::InetEndpoint& getSourceEndpoint() const { return m_sourceEndpoint; }
+
+			/**
+			 * Klient moze dzialac w petli innego watku (UpstreamPool). Wtedy wszystkie
+			 * operacje na nim ida przez inLoop() - zadania trafiaja do kolejki klienta,
+			 * a petla, w ktorej aktualnie jest, dostaje jedno zdarzenie na serie zadan.
+			 * W watku glownym inLoop() wykonuje zadanie od razu.
+			 */
+			bool isThreaded() const { return m_threaded; }
+			void setThreaded(core::EventDispatcher* dispatcher);
+			void inLoop(Job&& func);
+
+			// przeniesienie do innej petli - wolane w watku klienta, tylko gdy isIdle()
+			bool isIdle() const;
+			void moveTo(core::EventDispatcher* dispatcher);
+			// wolany w watku klienta po obsluzeniu ostatniego requestu (czekanie z przeniesieniem)
+			void setIdleCallback(const std::function<void()>& func) { m_idleCallback = func; }
+
+			// liczba wyslanych PDU (z retransmisjami) - obciazenie do rownowazenia watkow
+			uint64_t getSentCount() const { return m_sentCount.load(std::memory_order_relaxed); }
+
 			const std::string& getCommunity() const { return m_community; }
 
-			void poll();
-			bool handleMessage(const io::InetEndpoint& source, const Value& message);
+			// zapytania juz wyslane dostana odpowiedz ze starego adresu, retransmisje ida na nowy
+			const io::InetEndpoint& getDestEndpoint() const { return m_destEndpoint; }
+			void setDestEndpoint(const io::InetEndpoint& endpoint) { m_destEndpoint = endpoint; }
+
+			int32_t getRequestTimeout() const { return m_requestTimeout; }
+			void setRequestTimeout(int32_t millis) { m_requestTimeout = millis; }
+
+			int32_t getRetries() const { return m_retries; }
+			void setRetries(int32_t retries) { m_retries = retries; }
+
+			float getBackoff() const { return m_backoff; }
+			void setBackoff(float backoff) { m_backoff = backoff; }
+
+			// 0 - bez limitu
+			int32_t getMaxInFlight() const { return m_maxInFlight; }
+			void setMaxInFlight(int32_t num);
+
+			int32_t getQueueTimeout() const { return m_queueTimeout; }
+			void setQueueTimeout(int32_t millis) { m_queueTimeout = millis; }
+
+			int32_t getInFlightCount() const { return m_inFlight.load(std::memory_order_relaxed); }
+			float getWindow() const { return m_window.load(std::memory_order_relaxed); }
+
+			// laczenie GET-ow, 0 lub 1 - wylaczone
+			void setBatchMaxVarBindings(int32_t num) { m_batchMaxVarBindings = num; }
+			void setBatchMaxBytes(int32_t bytes) { m_batchMaxBytes = bytes; }
+			void setBatchWindow(int32_t micros) { m_batchWindow = micros; }
+
+			// odpowiedz na request o podanym uchwycie (SocketsManager znajduje go po requestID)
+			bool handleMessage(const Value& message, int32_t handle, ticks_t receiveTime);
+
+			// czas od wyslania do odebrania odpowiedzi
+			const LatencyHistogram& getRoundTripHistogram() const { return m_roundTripHistogram; }
 			void send(const io::DataBuffer& buf);
 
-			bool doRequest(Value pdu, const ClientRequest_Raw::Callback& func);
-			bool doGetBulk(const OID& start, const ClientRequest_GetBulk::Callback& func);
+			size_t getPendingRequestsCount() const { return m_requests.size(); }
+			void renewRequest(ClientRequestBase* req);
+
+			bool doRequest(const Value& pdu, ClientRequest_Raw::Callback&& func, ClientRequestPriority::Enum priority = ClientRequestPriority::CLIENT);
+			bool doGetBulk(const OID& start, ClientRequest_GetBulk::Callback&& func, ClientRequestPriority::Enum priority = ClientRequestPriority::REFRESH);
 
 		private:
 			SocketPtr m_socket;
 			std::string m_community;
+			io::InetEndpoint m_sourceEndpoint;
 			io::InetEndpoint m_destEndpoint;
 
-			std::map<int32_t, ClientRequestBase*> m_requests;
+			// petla, w ktorej dziala klient - zmieniana przez watek klienta przy przenoszeniu
+			std::atomic<core::EventDispatcher*> m_dispatcher;
+			bool m_threaded;
+			stdext::mpsc_queue<Job> m_jobs;
+			std::atomic<bool> m_jobsPending;
+			std::atomic<uint64_t> m_sentCount;
+			std::function<void()> m_idleCallback;
+
+			ClientRequestTable m_requests;
+
+			// terminy timeoutow, usuwane leniwie (wpis jest nieaktualny
+			// jezeli requestu juz nie ma, zmienil uchwyt albo ma inny deadline)
+			std::priority_queue<ClientRequestDeadline> m_deadlines;
+			// ustawiony na najblizszy termin z m_deadlines
+			core::ScheduledEventPtr m_timeoutEvent;
+			int32_t m_requestTimeout;
+			int32_t m_retries;
+			float m_backoff;
+
+			// okno AIMD: rosnie o 1/okno za kazda odpowiedz, spada o polowe przy timeoucie
+			// licznik i okno sa czytane takze przez metryki z watku glownego
+			int32_t m_maxInFlight;
+			std::atomic<int32_t> m_inFlight;
+			std::atomic<float> m_window;
+			ticks_t m_lastWindowDecrease;
+
+			// requesty czekajace na miejsce w oknie (REFRESH obslugiwane przed CLIENT)
+			int32_t m_queueTimeout;
+			std::deque<int32_t> m_queues[2];
+
+			LatencyHistogram m_roundTripHistogram;
+
+			// zbierane pojedyncze GET-y
+			int32_t m_batchMaxVarBindings;
+			int32_t m_batchMaxBytes;
+			int32_t m_batchWindow;
+			std::vector<ClientBatchEntry> m_batch;
+			int32_t m_batchBytes;
+			core::EventPtr m_batchFlushEvent;
+			uint32_t m_batchSerial; // zmieniany przez flushBatch - uniewaznia wysylke z post()
+
+			bool addToBatch(const OID& name, ClientRequest_Raw::Callback&& func);
+			void flushBatch();
+			bool doRequestDirect(const Value& pdu, ClientRequest_Raw::Callback&& func, ClientRequestPriority::Enum priority);
+
+			void submitRequest(ClientRequestBase* req, ClientRequestPriority::Enum priority);
+			void finishRequest(ClientRequestBase* req);
+			void releaseRequest(ClientRequestBase* req);
+			bool canSend() const;
+			void pumpQueue();
+			void pushDeadline(ClientRequestBase* req);
+			void armTimeout(ticks_t deadline);
+			void processTimeouts();
+			void windowIncrease();
+			void windowDecrease();
+
+			void sendRequest(ClientRequestBase* req);
+			void armTimeout(ClientRequestBase* req);
+
+			core::EventDispatcher& dispatcher() const { return *m_dispatcher.load(std::memory_order_relaxed); }
+			void wakeLoop(core::EventDispatcher* dispatcher);
+			void runJobs(core::EventDispatcher* dispatcher);
+			void checkIdle();
+
+			friend class ClientRequest_GetBatch;
 	};
 
 
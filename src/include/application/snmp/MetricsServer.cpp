@@ -0,0 +1,471 @@
+/*
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @author: pregusia
+ * @part-of: preg-snmp-proxy
+ *
+ */
+
+#include "MetricsServer.h"
+#include "ProxyServer.h"
+#include "Client.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <core/clock.h>
+#include <application/config/parser/ConfigEntry.h>
+
+namespace application { namespace snmp {
+
+	// ************************************************************************************
+	static void appendFormat(std::string& out, const char* fmt, ...) {
+		char buf[1024];
+
+		va_list args;
+		va_start(args, fmt);
+		int32_t len = vsnprintf(buf, sizeof(buf), fmt, args);
+		va_end(args);
+
+		if (len < 0) return;
+		if (len < static_cast<int32_t>(sizeof(buf))) {
+			out.append(buf, len);
+			return;
+		}
+
+		// nie zmiescilo sie - formatujemy drugi raz bezposrednio do wyjscia
+		size_t pos = out.size();
+		out.resize(pos + len + 1);
+		va_start(args, fmt);
+		vsnprintf(&out[pos], len + 1, fmt, args);
+		va_end(args);
+		out.resize(pos + len);
+	}
+
+	// ************************************************************************************
+	static bool setNonBlocking(int32_t fd) {
+		int32_t flags = fcntl(fd, F_GETFL, 0);
+		if (flags < 0) return false;
+		return fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+	}
+
+
+
+// ##############################################################################################################################
+// MetricsRenderer
+// ##############################################################################################################################
+
+	// ************************************************************************************
+	MetricsRenderer::MetricsRenderer(const std::vector<ProxyServerPtr>& servers) : m_servers(servers) {
+		reset();
+	}
+
+	// ************************************************************************************
+	void MetricsRenderer::reset() {
+		m_family = Family::REQUESTS;
+		m_server = 0;
+		m_cursor = 0;
+	}
+
+	// ************************************************************************************
+	bool MetricsRenderer::step(std::string& out, int32_t budget) {
+		if (m_family == Family::END) return true;
+
+		// w formacie Prometheus'a probki jednej rodziny musza byc razem,
+		// wiec iterujemy: rodzina -> proxy
+		if (m_server == 0 && m_cursor == 0) {
+			switch(m_family) {
+				case Family::REQUESTS:
+					out.append("# HELP snmp_proxy_requests_total Requests received per OID and operation.\n");
+					out.append("# TYPE snmp_proxy_requests_total counter\n");
+					break;
+				case Family::CACHE_ENTRIES:
+					out.append("# HELP snmp_proxy_cache_entries Values held by cache entry.\n");
+					out.append("# TYPE snmp_proxy_cache_entries gauge\n");
+					break;
+				case Family::CACHE_AGE:
+					out.append("# HELP snmp_proxy_cache_age_seconds Time since last successful update of cache entry.\n");
+					out.append("# TYPE snmp_proxy_cache_age_seconds gauge\n");
+					break;
+				case Family::IN_FLIGHT:
+					out.append("# HELP snmp_proxy_target_in_flight Requests sent to target and not answered yet.\n");
+					out.append("# TYPE snmp_proxy_target_in_flight gauge\n");
+					break;
+				case Family::WINDOW:
+					out.append("# HELP snmp_proxy_target_window Current in-flight window for target.\n");
+					out.append("# TYPE snmp_proxy_target_window gauge\n");
+					break;
+				case Family::PENDING:
+					out.append("# HELP snmp_proxy_target_pending_requests Requests in flight or queued for target.\n");
+					out.append("# TYPE snmp_proxy_target_pending_requests gauge\n");
+					break;
+				case Family::LATENCY:
+					out.append("# HELP snmp_proxy_latency_seconds Time from request receive to response send, or upstream round trip.\n");
+					out.append("# TYPE snmp_proxy_latency_seconds histogram\n");
+					break;
+				default:
+					break;
+			}
+		}
+
+		if (m_server < static_cast<int32_t>(m_servers.size())) {
+			auto& server = m_servers[m_server];
+			std::string proxy = server->getEndpoint().toString();
+			std::string target = server->getTargetEndpoint().toString();
+
+			switch(m_family) {
+				case Family::REQUESTS:
+					renderRequests(out, server, budget);
+					return false;
+
+				case Family::CACHE_ENTRIES:
+					for(auto& ce: server->getCacheEntries()) {
+						appendFormat(out, "snmp_proxy_cache_entries{proxy=\"%s\",cache=\"%s\"} %d\n",
+							proxy.c_str(), ce->getBaseOID().toString().c_str(), ce->getValuesCount());
+					}
+					break;
+
+				case Family::CACHE_AGE:
+					for(auto& ce: server->getCacheEntries()) {
+						if (!ce->isInitialized()) continue;
+						appendFormat(out, "snmp_proxy_cache_age_seconds{proxy=\"%s\",cache=\"%s\"} %.1f\n",
+							proxy.c_str(), ce->getBaseOID().toString().c_str(), ce->getAge() / 1000.0);
+					}
+					break;
+
+				case Family::IN_FLIGHT:
+					appendFormat(out, "snmp_proxy_target_in_flight{proxy=\"%s\",target=\"%s\"} %d\n",
+						proxy.c_str(), target.c_str(), server->getClient()->getInFlightCount());
+					break;
+
+				case Family::WINDOW:
+					appendFormat(out, "snmp_proxy_target_window{proxy=\"%s\",target=\"%s\"} %.2f\n",
+						proxy.c_str(), target.c_str(), server->getClient()->getWindow());
+					break;
+
+				case Family::PENDING:
+					appendFormat(out, "snmp_proxy_target_pending_requests{proxy=\"%s\",target=\"%s\"} %d\n",
+						proxy.c_str(), target.c_str(), static_cast<int32_t>(server->getClient()->getPendingRequestsCount()));
+					break;
+
+				case Family::LATENCY:
+					renderLatency(out, server, "cache-hit", server->getCacheLatency());
+					renderLatency(out, server, "proxied", server->getProxyLatency());
+					renderLatency(out, server, "upstream", server->getClient()->getRoundTripHistogram());
+					break;
+
+				default:
+					break;
+			}
+
+			m_server += 1;
+			m_cursor = 0;
+			return false;
+		}
+
+		m_family += 1;
+		m_server = 0;
+		m_cursor = 0;
+		return m_family == Family::END;
+	}
+
+	// ************************************************************************************
+	void MetricsRenderer::renderRequests(std::string& out, const ProxyServerPtr& server, int32_t budget) {
+		const StatCounters* counters = server->getStatCounters();
+		if (counters == nullptr) {
+			m_server += 1;
+			m_cursor = 0;
+			return;
+		}
+
+		std::string proxy = server->getEndpoint().toString();
+		int32_t end = std::min(counters->size(), m_cursor + budget);
+
+		for(;m_cursor<end;++m_cursor) {
+			if (!counters->isUsed(m_cursor)) continue;
+
+			std::string oid = counters->isOverflow(m_cursor) ? "<other>" : counters->oid(m_cursor).toString();
+			StatOperation::forEach([&](StatOperation::Enum op){
+				uint64_t num = counters->count(m_cursor, op);
+				if (num == 0) return;
+
+				appendFormat(out, "snmp_proxy_requests_total{proxy=\"%s\",op=\"%s\",oid=\"%s\"} %llu\n",
+					proxy.c_str(), StatOperation::name(op), oid.c_str(), static_cast<unsigned long long>(num));
+			});
+		}
+
+		if (m_cursor >= counters->size()) {
+			m_server += 1;
+			m_cursor = 0;
+		}
+	}
+
+	// ************************************************************************************
+	void MetricsRenderer::renderLatency(std::string& out, const ProxyServerPtr& server, const char* path, const LatencyHistogram& histogram) {
+		std::string proxy = server->getEndpoint().toString();
+		std::string target = server->getTargetEndpoint().toString();
+
+		// tylko niepuste kubelki - to nadal poprawny (skumulowany) histogram
+		uint64_t total = 0;
+		for(int32_t i=0;i<LatencyHistogram::BUCKETS;++i) {
+			uint64_t num = histogram.bucketCount(i);
+			if (num == 0) continue;
+
+			total += num;
+			appendFormat(out, "snmp_proxy_latency_seconds_bucket{proxy=\"%s\",target=\"%s\",path=\"%s\",le=\"%.6f\"} %llu\n",
+				proxy.c_str(), target.c_str(), path,
+				static_cast<double>(LatencyHistogram::bucketValue(i)) / 1000000.0,
+				static_cast<unsigned long long>(total));
+		}
+
+		appendFormat(out, "snmp_proxy_latency_seconds_bucket{proxy=\"%s\",target=\"%s\",path=\"%s\",le=\"+Inf\"} %llu\n",
+			proxy.c_str(), target.c_str(), path, static_cast<unsigned long long>(total));
+		appendFormat(out, "snmp_proxy_latency_seconds_sum{proxy=\"%s\",target=\"%s\",path=\"%s\"} %.6f\n",
+			proxy.c_str(), target.c_str(), path, static_cast<double>(histogram.sum()) / 1000000.0);
+		appendFormat(out, "snmp_proxy_latency_seconds_count{proxy=\"%s\",target=\"%s\",path=\"%s\"} %llu\n",
+			proxy.c_str(), target.c_str(), path, static_cast<unsigned long long>(total));
+	}
+
+
+
+// ##############################################################################################################################
+// MetricsConnection
+// ##############################################################################################################################
+
+	// ************************************************************************************
+	MetricsConnection::MetricsConnection(MetricsServer* server, const io::FileDescriptorPtr& fd)
+		: m_server(server), m_fd(fd), m_renderer(server->getServers())
+	{
+		m_outPos = 0;
+		m_rendered = false;
+	}
+
+	// ************************************************************************************
+	MetricsConnection::~MetricsConnection() {
+		close();
+	}
+
+	// ************************************************************************************
+	void MetricsConnection::start() {
+		auto self = dynamic_self_cast<MetricsConnection>();
+		m_server->takeBuffer(m_out);
+		m_fd->onReadReady(std::bind(&MetricsConnection::onRead, self, std::placeholders::_1));
+
+		// close() odwoluje timer, wiec wystarczy sam wskaznik
+		m_timeoutEvent = g_dispatcher.scheduleEvent([this](){ close(); }, TIMEOUT);
+	}
+
+	// ************************************************************************************
+	void MetricsConnection::close() {
+		if (m_fd.empty()) return;
+
+		if (m_timeoutEvent) {
+			m_timeoutEvent->cancel();
+			m_timeoutEvent.reset();
+		}
+
+		m_fd->onReadReady(io::FileDescriptor::CallbackFunc());
+		m_fd->onWriteReady(io::FileDescriptor::CallbackFunc());
+		m_fd->close();
+		m_fd.reset();
+
+		m_server->returnBuffer(m_out);
+	}
+
+	// ************************************************************************************
+	void MetricsConnection::onRead(io::FileDescriptorPtr) {
+		if (m_fd.empty()) return;
+
+		char buf[2048];
+		int32_t res = ::recv(m_fd->fd(), buf, sizeof(buf), 0);
+
+		if (res < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+			m_fd->onReadReady(std::bind(&MetricsConnection::onRead, dynamic_self_cast<MetricsConnection>(), std::placeholders::_1));
+			return;
+		}
+		if (res <= 0) {
+			close();
+			return;
+		}
+
+		m_request.append(buf, res);
+		if (m_request.find("\r\n\r\n") == std::string::npos) {
+			if (m_request.size() > MAX_REQUEST_SIZE) {
+				close();
+			} else {
+				m_fd->onReadReady(std::bind(&MetricsConnection::onRead, dynamic_self_cast<MetricsConnection>(), std::placeholders::_1));
+			}
+			return;
+		}
+
+		if (m_request.compare(0, 13, "GET /metrics ") == 0 || m_request.compare(0, 6, "GET / ") == 0) {
+			m_out.append("HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nConnection: close\r\n\r\n");
+			m_renderer.reset();
+		} else {
+			m_out.append("HTTP/1.0 404 Not Found\r\nContent-Type: text/plain\r\nConnection: close\r\n\r\nNot found\n");
+			m_rendered = true;
+		}
+
+		m_fd->onWriteReady(std::bind(&MetricsConnection::onWrite, dynamic_self_cast<MetricsConnection>(), std::placeholders::_1));
+	}
+
+	// ************************************************************************************
+	void MetricsConnection::onWrite(io::FileDescriptorPtr) {
+		if (m_fd.empty()) return;
+
+		// dogenerowujemy tylko tyle, ile mozna zaraz wyslac
+		while(!m_rendered && m_out.size() - m_outPos < MAX_PENDING_OUTPUT) {
+			m_rendered = m_renderer.step(m_out, RENDER_BUDGET);
+		}
+
+		if (m_outPos < m_out.size()) {
+			int32_t res = ::send(m_fd->fd(), m_out.data() + m_outPos, m_out.size() - m_outPos, MSG_NOSIGNAL);
+			if (res < 0) {
+				if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+					close();
+					return;
+				}
+			} else {
+				m_outPos += res;
+			}
+		}
+
+		if (m_outPos == m_out.size()) {
+			m_out.clear();
+			m_outPos = 0;
+
+			if (m_rendered) {
+				close();
+				return;
+			}
+		}
+
+		m_fd->onWriteReady(std::bind(&MetricsConnection::onWrite, dynamic_self_cast<MetricsConnection>(), std::placeholders::_1));
+	}
+
+
+
+// ##############################################################################################################################
+// MetricsServer
+// ##############################################################################################################################
+
+	// ************************************************************************************
+	MetricsServer::MetricsServer(const std::vector<ProxyServerPtr>& servers) : m_servers(servers) {
+
+	}
+
+	// ************************************************************************************
+	MetricsServer::~MetricsServer() {
+		for(auto& c: m_connections) {
+			c->close();
+		}
+		if (m_socket) {
+			m_socket->close();
+		}
+	}
+
+	// ************************************************************************************
+	bool MetricsServer::loadFromConfig(const config::parser::ConfigEntriesCollection& entries) {
+		for(auto& e: entries) {
+			if (e->name() == "socket" && e->hasValuePrimitive(0)) {
+				m_endpoint = io::InetEndpoint::resolve(e->valuePrimitive(0));
+				continue;
+			}
+
+			g_logger.warning(stdext::format("[MetricsServer::loadFromConfig] Unknown config entry '%s'", e->name()));
+		}
+
+		if (m_endpoint.empty()) {
+			g_logger.warning("[MetricsServer::loadFromConfig] No socket specified");
+			return false;
+		}
+
+		return listen();
+	}
+
+	// ************************************************************************************
+	bool MetricsServer::listen() {
+		int32_t fd = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (fd < 0) {
+			g_logger.error("[MetricsServer::listen] Could not create socket");
+			return false;
+		}
+
+		int32_t reuse = 1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+		sockaddr_in addrIn = m_endpoint.toSockAddr();
+		if (::bind(fd, (sockaddr*)&addrIn, sizeof(addrIn)) < 0 || ::listen(fd, 16) < 0 || !setNonBlocking(fd)) {
+			g_logger.error(stdext::format("[MetricsServer::listen] Could not listen on %s - %s", m_endpoint.toString(), strerror(errno)));
+			::close(fd);
+			return false;
+		}
+
+		m_socket = io::FileDescriptor::Adapt(fd);
+		m_socket->onReadReady(std::bind(&MetricsServer::onAccept, dynamic_self_cast<MetricsServer>(), std::placeholders::_1));
+		return true;
+	}
+
+	// ************************************************************************************
+	void MetricsServer::onAccept(io::FileDescriptorPtr) {
+		// zamkniete polaczenia sa usuwane przy kolejnych
+		m_connections.remove_if([](const MetricsConnectionPtr& conn){ return conn->closed(); });
+
+		while(true) {
+			int32_t clientFD = ::accept(m_socket->fd(), nullptr, nullptr);
+			if (clientFD < 0) break;
+
+			if (!setNonBlocking(clientFD)) {
+				::close(clientFD);
+				continue;
+			}
+
+			MetricsConnectionPtr conn(new MetricsConnection(this, io::FileDescriptor::Adapt(clientFD)));
+			conn->start();
+			m_connections.push_back(conn);
+		}
+
+		m_socket->onReadReady(std::bind(&MetricsServer::onAccept, dynamic_self_cast<MetricsServer>(), std::placeholders::_1));
+	}
+
+	// ************************************************************************************
+	void MetricsServer::takeBuffer(std::string& buf) {
+		if (!m_spareBuffers.empty()) {
+			buf.swap(m_spareBuffers.back());
+			m_spareBuffers.pop_back();
+		}
+		buf.clear();
+	}
+
+	// ************************************************************************************
+	void MetricsServer::returnBuffer(std::string& buf) {
+		if (m_spareBuffers.size() < 4) {
+			buf.clear();
+			m_spareBuffers.push_back(std::string());
+			m_spareBuffers.back().swap(buf);
+		}
+	}
+
+} }
@@ -0,0 +1,135 @@
+/*
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @author: pregusia
+ * @part-of: preg-snmp-proxy
+ *
+ */
+
+#ifndef INCLUDE_APPLICATION_SNMP_METRICSSERVER_H_
+#define INCLUDE_APPLICATION_SNMP_METRICSSERVER_H_
+
+#include "base.h"
+#include "Statistics.h"
+
+#include <io/FileDescriptor.h>
+#include <io/InetEndpoint.h>
+#include <core/eventdispatcher.h>
+
+namespace application { namespace snmp {
+
+	class MetricsConnection;
+	typedef stdext::object_ptr<MetricsConnection> MetricsConnectionPtr;
+
+	/**
+	 * Generuje metryki wszystkich proxy w formacie tekstowym Prometheus'a.
+	 * Kazde wywolanie step() dopisuje kawalek (najwiecej 'budget' OID-ow),
+	 * zeby duze tablice statystyk nie blokowaly petli obslugi pakietow.
+	 */
+	class MetricsRenderer {
+		public:
+			MetricsRenderer(const std::vector<ProxyServerPtr>& servers);
+
+			void reset();
+			bool step(std::string& out, int32_t budget);
+
+		private:
+			ENUM_DEFINE(Family,
+				REQUESTS = 0,
+				CACHE_ENTRIES = 1,
+				CACHE_AGE = 2,
+				IN_FLIGHT = 3,
+				WINDOW = 4,
+				PENDING = 5,
+				LATENCY = 6,
+				END = 7,
+			);
+
+			const std::vector<ProxyServerPtr>& m_servers;
+			int32_t m_family;
+			int32_t m_server;
+			int32_t m_cursor;
+
+			void renderRequests(std::string& out, const ProxyServerPtr& server, int32_t budget);
+			void renderLatency(std::string& out, const ProxyServerPtr& server, const char* path, const LatencyHistogram& histogram);
+	};
+
+	class MetricsConnection: public stdext::object {
+		public:
+			MetricsConnection(MetricsServer* server, const io::FileDescriptorPtr& fd);
+			virtual ~MetricsConnection();
+
+			void start();
+			void close();
+
+			bool closed() const { return m_fd.empty(); }
+
+		private:
+			static const int32_t MAX_REQUEST_SIZE = 8192;
+			static const int32_t RENDER_BUDGET = 512;
+			static const int32_t MAX_PENDING_OUTPUT = 65536;
+			static const int32_t TIMEOUT = 10000;
+
+			MetricsServer* m_server;
+			io::FileDescriptorPtr m_fd;
+			core::ScheduledEventPtr m_timeoutEvent;
+
+			std::string m_request;
+			std::string m_out;
+			size_t m_outPos;
+
+			MetricsRenderer m_renderer;
+			bool m_rendered;
+
+			void onRead(io::FileDescriptorPtr fd);
+			void onWrite(io::FileDescriptorPtr fd);
+	};
+
+	/**
+	 * Prosty serwer HTTP (tylko GET /metrics) dzialajacy na glownej petli zdarzen.
+	 */
+	class MetricsServer: public stdext::object {
+		public:
+			MetricsServer(const std::vector<ProxyServerPtr>& servers);
+			virtual ~MetricsServer();
+
+			bool loadFromConfig(const config::parser::ConfigEntriesCollection& entries);
+
+			const std::vector<ProxyServerPtr>& getServers() const { return m_servers; }
+
+			// bufory wyjsciowe uzywane ponownie przez kolejne polaczenia
+			void takeBuffer(std::string& buf);
+			void returnBuffer(std::string& buf);
+
+		private:
+			const std::vector<ProxyServerPtr>& m_servers;
+			io::InetEndpoint m_endpoint;
+			io::FileDescriptorPtr m_socket;
+
+			std::list<MetricsConnectionPtr> m_connections;
+			std::vector<std::string> m_spareBuffers;
+
+			bool listen();
+			void onAccept(io::FileDescriptorPtr fd);
+	};
+
+} }
+
+#endif /* INCLUDE_APPLICATION_SNMP_METRICSSERVER_H_ */
@@ -27,11 +27,15 @@
 #include "Client.h"
 #include "Socket.h"
 #include "SocketsManager.h"
+#include "CacheScheduler.h"
 #include "streams.h"
 
+#include <algorithm>
+#include <cmath>
 #include <cstdio>
 
 #include <core/clock.h>
+#include <io/Resolver.h>
 #include <application/config/parser/ConfigEntry.h>
 
 namespace application { namespace snmp {
@@ -43,9 +47,20 @@ namespace application { namespace snmp {
 	// ************************************************************************************
 	ProxyServerCacheEntry::ProxyServerCacheEntry() {
 		m_updateInterval = 0;
-		m_nextUpdateTime = 0;
 		m_updating = false;
 		m_initialized = false;
+		m_dynamic = false;
+		m_updatedTime = 0;
+		m_memoryUsage = 0;
+		m_idleInterval = 0;
+		m_dormantAfter = 0;
+		m_maxAge = 0;
+		m_currentInterval = 0;
+		m_lastReadTime = 0;
+		m_replaying = false;
+		m_nextUpdateTime = 0;
+		m_readCount = 0;
+		m_startFailed = false;
 	}
 
 	// ************************************************************************************
@@ -72,6 +87,18 @@ namespace application { namespace snmp {
 				m_updateInterval = e->valueInt(0);
 				continue;
 			}
+			if (e->name() == "idle-interval" && e->hasValueInt(0)) {
+				m_idleInterval = e->valueInt(0);
+				continue;
+			}
+			if (e->name() == "dormant-after" && e->hasValueInt(0)) {
+				m_dormantAfter = e->valueInt(0);
+				continue;
+			}
+			if (e->name() == "max-age" && e->hasValueInt(0)) {
+				m_maxAge = e->valueInt(0);
+				continue;
+			}
 
 			g_logger.warning(stdext::format("[ProxyServerCacheEntry::loadFromConfig] Unknown config entry '%s'", e->name()));
 		}
@@ -80,85 +107,148 @@ namespace application { namespace snmp {
 			g_logger.warning("[ProxyServerOIDSpec::loadFromConfig] Invalid update interval");
 			return false;
 		}
+		if (m_idleInterval != 0 && m_idleInterval < m_updateInterval) {
+			g_logger.warning("[ProxyServerCacheEntry::loadFromConfig] Invalid idle-interval (lower than update-interval)");
+			return false;
+		}
+		if (m_dormantAfter < 0 || m_maxAge < 0) {
+			g_logger.warning("[ProxyServerCacheEntry::loadFromConfig] Invalid dormant-after or max-age");
+			return false;
+		}
+		m_currentInterval = m_updateInterval;
 
 		return true;
 	}
 
 	// ************************************************************************************
-	void ProxyServerCacheEntry::doGetAll(const Callback& func) {
-		if (m_updating || !m_initialized) {
-			auto self = dynamic_self_cast<ProxyServerCacheEntry>();
-			m_waitingCalls.push_back([=](){
-				self->doGetAll(func);
-			});
-			doUpdate();
-			return;
-		}
-
-		func(m_values);
+	void ProxyServerCacheEntry::initDynamic(const OID& baseOID, int32_t updateInterval) {
+		m_baseOID = baseOID;
+		m_updateInterval = updateInterval;
+		m_currentInterval = updateInterval;
+		m_dynamic = true;
 	}
 
 	// ************************************************************************************
-	void ProxyServerCacheEntry::doGetOne(const OID& oid, const Callback& func) {
-		if (m_updating || !m_initialized) {
-			auto self = dynamic_self_cast<ProxyServerCacheEntry>();
-			m_waitingCalls.push_back([=](){
-				self->doGetOne(oid, func);
-			});
-			doUpdate();
-			return;
+	bool ProxyServerCacheEntry::waitForUpdate(ProxyServerCacheQuery::Enum query, const OID& oid, int32_t num, Callback& func) {
+		ticks_t now = g_clock.millis();
+		bool wasDormant = isDormant(now);
+
+		m_readCount += 1;
+		m_lastReadTime = now;
+
+		// dynamiczny wpis w trakcie aktualizacji odpowiada z dotychczasowych danych
+		bool stale = m_maxAge > 0 && m_initialized && !m_replaying && now - m_updatedTime > m_maxAge * 1000;
+		if ((m_updating && !m_dynamic) || !m_initialized || stale) {
+			m_waitingCalls.push_back(WaitingCall(query, oid, num, std::move(func)));
+			if (!m_updating) g_cacheScheduler.wake();
+			return true;
 		}
 
-		std::vector<VarBinding> res;
-		for(auto& e: m_values) {
-			if (e.name == oid) {
-				res.push_back(e);
-			}
+		// uspiony cache - odpowiedz z dotychczasowych danych, aktualizacja od razu
+		if (wasDormant) {
+			m_currentInterval = m_updateInterval;
+			m_nextUpdateTime = std::min(m_nextUpdateTime, now);
+			g_cacheScheduler.wake();
 		}
+		return false;
+	}
 
-		func(res);
+	// ************************************************************************************
+	bool ProxyServerCacheEntry::isDormant(ticks_t now) const {
+		if (m_dormantAfter <= 0 || !m_initialized) return false;
+		return now - m_lastReadTime > m_dormantAfter * 1000;
 	}
 
 	// ************************************************************************************
-	void ProxyServerCacheEntry::doGetFrom(const OID& start, int32_t num, const Callback& func) {
-		if (m_updating || !m_initialized) {
-			auto self = dynamic_self_cast<ProxyServerCacheEntry>();
-			m_waitingCalls.push_back([=](){
-				self->doGetFrom(start, num, func);
-			});
-			doUpdate();
-			return;
-		}
+	int32_t ProxyServerCacheEntry::nextUpdateInterval() {
+		if (m_idleInterval <= m_updateInterval) return m_updateInterval;
 
-		std::vector<VarBinding> res;
-		for(auto& e: m_values) {
-			if (e.name < start) continue;
-			res.push_back(e);
-			if (static_cast<int32_t>(res.size()) >= num) break;
+		// czytany - co update-interval, nieczytany - okres podwajany do idle-interval
+		if (m_readCount > 0) {
+			m_currentInterval = m_updateInterval;
+		} else {
+			m_currentInterval = std::min(m_currentInterval * 2, m_idleInterval);
 		}
+		return m_currentInterval;
+	}
 
-		func(res);
+	// ************************************************************************************
+	ticks_t ProxyServerCacheEntry::getAge() const {
+		return g_clock.millis() - m_updatedTime;
 	}
 
 	// ************************************************************************************
-	void ProxyServerCacheEntry::doGetNext(const OID& oid, const Callback& func) {
-		if (m_updating || !m_initialized) {
-			auto self = dynamic_self_cast<ProxyServerCacheEntry>();
-			m_waitingCalls.push_back([=](){
-				self->doGetNext(oid, func);
-			});
-			doUpdate();
-			return;
+	void ProxyServerCacheEntry::doGetAll(Callback&& func) {
+		if (waitForUpdate(ProxyServerCacheQuery::ALL, OID(), 0, func)) return;
+
+		func(m_values.data(), m_values.size());
+	}
+
+	// ************************************************************************************
+	void ProxyServerCacheEntry::doGetOne(const OID& oid, Callback&& func) {
+		if (waitForUpdate(ProxyServerCacheQuery::ONE, oid, 0, func)) return;
+
+		auto it = std::lower_bound(m_values.begin(), m_values.end(), oid, VarBindingNameLess());
+		auto end = it;
+		while(end != m_values.end() && end->name == oid) ++end;
+
+		func(m_values.data() + (it - m_values.begin()), end - it);
+	}
+
+	// ************************************************************************************
+	void ProxyServerCacheEntry::doGetFrom(const OID& start, int32_t num, Callback&& func) {
+		if (waitForUpdate(ProxyServerCacheQuery::FROM, start, num, func)) return;
+
+		auto it = std::lower_bound(m_values.begin(), m_values.end(), start, VarBindingNameLess());
+		size_t idx = it - m_values.begin();
+		size_t count = std::min(m_values.size() - idx, static_cast<size_t>(std::max(num, 1)));
+
+		func(m_values.data() + idx, count);
+	}
+
+	// ************************************************************************************
+	void ProxyServerCacheEntry::doGetNext(const OID& oid, Callback&& func) {
+		if (waitForUpdate(ProxyServerCacheQuery::NEXT, oid, 0, func)) return;
+
+		auto it = std::upper_bound(m_values.begin(), m_values.end(), oid, VarBindingNameLess());
+		size_t idx = it - m_values.begin();
+
+		func(m_values.data() + idx, idx < m_values.size() ? 1 : 0);
+	}
+
+	// ************************************************************************************
+	void ProxyServerCacheEntry::applyWrite(const OID& name, const Value& value) {
+		// przed pierwsza aktualizacja nie ma czego poprawiac
+		if (!m_initialized) return;
+
+		if (m_updating) {
+			VarBinding vb;
+			vb.name = name;
+			vb.value = value;
+			m_writes.push_back(vb);
 		}
+		storeValue(name, value);
+	}
+
+	// ************************************************************************************
+	void ProxyServerCacheEntry::storeValue(const OID& name, const Value& value) {
+		auto it = std::lower_bound(m_values.begin(), m_values.end(), name, VarBindingNameLess());
+		bool found = it != m_values.end() && it->name == name;
 
-		std::vector<VarBinding> res;
-		for(auto& e: m_values) {
-			if (e.name <= oid) continue;
-			res.push_back(e);
-			break;
+		// agent nie ma juz tej wartosci (albo obiektu) - znika tez z cache
+		if (value.isNull() || value.isException()) {
+			if (found) m_values.erase(it);
+			return;
 		}
 
-		func(res);
+		if (found) {
+			it->value = value;
+		} else {
+			VarBinding vb;
+			vb.name = name;
+			vb.value = value;
+			m_values.insert(it, vb);
+		}
 	}
 
 	// ************************************************************************************
@@ -173,16 +263,15 @@ namespace application { namespace snmp {
 	}
 
 	// ************************************************************************************
-	void ProxyServerCacheEntry::poll() {
-		if (m_nextUpdateTime < g_clock.time()) {
-			m_nextUpdateTime = g_clock.time() + m_updateInterval;
-			doUpdate();
-		}
+	void ProxyServerCacheEntry::start() {
+		// terminy aktualizacji ustala CacheScheduler
+		m_lastReadTime = g_clock.millis();
+		g_cacheScheduler.add(dynamic_self_cast<ProxyServerCacheEntry>());
 	}
 
 	// ************************************************************************************
-	void ProxyServerCacheEntry::doUpdate() {
-		if (m_updating) return;
+	bool ProxyServerCacheEntry::doUpdate() {
+		if (m_updating) return false;
 
 		g_logger.info(stdext::format("[ProxyServerCacheEntry::processUpdateResult] [Cache %s] Starting update...",
 			m_baseOID.toString()
@@ -190,12 +279,47 @@ namespace application { namespace snmp {
 
 
 		m_updating = true;
+		m_readCount = 0;
 		auto self = dynamic_self_cast<ProxyServerCacheEntry>();
-		m_client->doGetBulk(m_baseOID, std::bind(&ProxyServerCacheEntry::processUpdateResult, self, std::placeholders::_1, std::placeholders::_2));
+
+		if (!m_client->isThreaded()) {
+			auto callback = [self](const std::vector<VarBinding>& values, const SNMPError& error){
+				std::vector<VarBinding> copy(values);
+				self->processUpdateResult(copy, error);
+			};
+			if (!m_client->doGetBulk(m_baseOID, callback, ClientRequestPriority::REFRESH)) {
+				m_updating = false;
+				return false;
+			}
+			return true;
+		}
+
+		// klient w innym watku - wynik jest odkladany we wpisie (juz posortowany)
+		// i podmieniany w watku glownym
+		ClientPtr client = m_client;
+		client->inLoop([self, client](){
+			auto callback = [self](const std::vector<VarBinding>& values, const SNMPError& error){
+				self->m_updateValues = values;
+				self->m_updateError = error;
+				std::sort(self->m_updateValues.begin(), self->m_updateValues.end());
+				g_dispatcher.pushEventSynchronized([self](){
+					self->processUpdateResult(self->m_updateValues, self->m_updateError);
+					self->m_updateValues.clear();
+				});
+			};
+			if (!client->doGetBulk(self->m_baseOID, callback, ClientRequestPriority::REFRESH)) {
+				g_dispatcher.pushEventSynchronized([self](){
+					self->m_updating = false;
+					self->m_writes.clear();
+					g_cacheScheduler.onUpdateFinished(self.get());
+				});
+			}
+		});
+		return true;
 	}
 
 	// ************************************************************************************
-	void ProxyServerCacheEntry::processUpdateResult(const std::vector<VarBinding>& values, const SNMPError& error) {
+	void ProxyServerCacheEntry::processUpdateResult(std::vector<VarBinding>& values, const SNMPError& error) {
 		m_updating = false;
 
 		if (error.hasError()) {
@@ -204,9 +328,23 @@ namespace application { namespace snmp {
 				error.toString()
 			));
 		} else {
-			m_values = values;
-			std::sort(m_values.begin(), m_values.end());
+			m_values.swap(values);
+			if (!std::is_sorted(m_values.begin(), m_values.end())) {
+				std::sort(m_values.begin(), m_values.end());
+			}
 			m_initialized = true;
+			m_updatedTime = g_clock.millis();
+
+			// walk mogl odczytac instancje jeszcze przed SET-em
+			for(auto& e: m_writes) {
+				storeValue(e.name, e.value);
+			}
+
+			m_memoryUsage = m_values.capacity() * sizeof(VarBinding);
+			for(auto& e: m_values) {
+				m_memoryUsage += e.name.size() * sizeof(int32_t);
+				m_memoryUsage += e.value.valueString().size() + e.value.valueOID().size() * sizeof(int32_t);
+			}
 
 			/*
 			for(auto& e: m_values) {
@@ -223,12 +361,24 @@ namespace application { namespace snmp {
 			));
 		}
 
-		auto waitingCallsCopy = m_waitingCalls;
-		m_waitingCalls.clear();
+		std::vector<WaitingCall> waitingCalls;
+		waitingCalls.swap(m_waitingCalls);
+
+		// po bledzie zapytania dostaja dotychczasowe dane, nawet starsze niz max-age
+		m_replaying = true;
 
-		for(auto& cb: waitingCallsCopy) {
-			cb();
+		for(auto& e: waitingCalls) {
+			switch(e.query) {
+				case ProxyServerCacheQuery::ALL: doGetAll(std::move(e.callback)); break;
+				case ProxyServerCacheQuery::ONE: doGetOne(e.oid, std::move(e.callback)); break;
+				case ProxyServerCacheQuery::FROM: doGetFrom(e.oid, e.num, std::move(e.callback)); break;
+				case ProxyServerCacheQuery::NEXT: doGetNext(e.oid, std::move(e.callback)); break;
+			}
 		}
+		m_replaying = false;
+		m_writes.clear();
+
+		g_cacheScheduler.onUpdateFinished(this);
 	}
 
 // ##############################################################################################################################
@@ -236,101 +386,323 @@ namespace application { namespace snmp {
 // ##############################################################################################################################
 
 	// ************************************************************************************
-	ProxyServerStatEntry::ProxyServerStatEntry() : m_lastTimes(100) {
+	ProxyServerStatEntry::ProxyServerStatEntry() {
 		m_num = 0;
+		m_windowStartNum = 0;
+		m_rate[0] = m_rate[1] = m_rate[2] = 0.0f;
+		m_initialized = false;
+		m_curMin = 0.0f;
+		m_curMax = 0.0f;
+		m_windowMin = 0.0f;
+		m_windowAvg = 0.0f;
+		m_windowMax = 0.0f;
+	}
+
+	// ************************************************************************************
+	void ProxyServerStatEntry::update(uint64_t num, float seconds, bool newWindow, float windowSeconds) {
+		static const float PERIODS[3] = { 60.0f, 300.0f, 900.0f };
+
+		if (seconds <= 0.0f) return;
+
+		float rate = static_cast<float>(num - m_num) / seconds;
+
+		if (!m_initialized) {
+			// pierwsza probka - bez rozbiegu od zera
+			for(int32_t i=0;i<3;++i) m_rate[i] = rate;
+			m_curMin = m_curMax = rate;
+			m_initialized = true;
+		} else {
+			for(int32_t i=0;i<3;++i) {
+				float alpha = 1.0f - std::exp(-seconds / PERIODS[i]);
+				m_rate[i] += alpha * (rate - m_rate[i]);
+			}
+			if (rate < m_curMin) m_curMin = rate;
+			if (rate > m_curMax) m_curMax = rate;
+		}
+
+		m_num = num;
+
+		if (newWindow) {
+			m_windowMin = m_curMin;
+			m_windowMax = m_curMax;
+			m_windowAvg = windowSeconds > 0.0f ? static_cast<float>(num - m_windowStartNum) / windowSeconds : 0.0f;
+			m_windowStartNum = num;
+			m_curMin = m_curMax = rate;
+		}
 	}
 
+
+// ##############################################################################################################################
+// ProxyServerRequestPool
+// ##############################################################################################################################
+
 	// ************************************************************************************
-	void ProxyServerStatEntry::tick(const std::string& name) {
-		if (m_name.empty()) m_name = name;
-		m_num += 1;
-		m_lastTimes.push_back(g_clock.time());
+	ProxyServerRequestPool::ProxyServerRequestPool() {
+
 	}
 
 	// ************************************************************************************
-	float ProxyServerStatEntry::getPerSecond() const {
-		if (m_lastTimes.empty()) return 0.0f;
+	ProxyServerRequestPool::~ProxyServerRequestPool() {
 
-		ticks_t minTime = g_clock.time();
-		ticks_t maxTime = 0;
+	}
 
-		for(auto& e: m_lastTimes) {
-			if (e < minTime) minTime = e;
-			if (e > maxTime) maxTime = e;
+	// ************************************************************************************
+	ProxyServerRequest* ProxyServerRequestPool::acquire() {
+		if (m_free.empty()) {
+			m_requests.push_back(std::unique_ptr<ProxyServerRequest>(new ProxyServerRequest()));
+			m_free.reserve(m_requests.size());
+			return m_requests.back().get();
 		}
 
-		float seconds = maxTime - minTime;
-		return static_cast<float>(m_lastTimes.size()) / seconds;
+		ProxyServerRequest* req = m_free.back();
+		m_free.pop_back();
+		return req;
 	}
 
 	// ************************************************************************************
-	std::string ProxyServerStatEntry::toString() const {
-		return stdext::format("%s  num=%d  perSec=%.2f",
-			m_name, m_num,
-			getPerSecond()
-		);
+	void ProxyServerRequestPool::release(ProxyServerRequest* req) {
+		if (req == nullptr) return;
+		m_free.push_back(req);
 	}
 
 
 // ##############################################################################################################################
-// ProxyServer
+// ProxyServerAutoCache
 // ##############################################################################################################################
 
 	// ************************************************************************************
-	ProxyServer::ProxyServer() {
-		m_statsWriteInterval = 0;
-		m_statsSaveNextTime = 0;
+	ProxyServerAutoCache::ProxyServerAutoCache(ProxyServer* server) {
+		m_server = server;
+		m_prefixLength = 10;
+		m_minRate = 5;
+		m_maxEntries = 16;
+		m_maxMemory = 65536;
+		m_updateInterval = 60;
+		m_idleAfter = 600;
+		m_sketchSize = 256;
 	}
 
 	// ************************************************************************************
-	ProxyServer::~ProxyServer() {
+	ProxyServerAutoCache::~ProxyServerAutoCache() {
+		if (m_checkEvent) m_checkEvent->cancel();
+	}
+
+	// ************************************************************************************
+	bool ProxyServerAutoCache::loadFromConfig(const config::parser::ConfigEntriesCollection& entries) {
+		for(auto& e: entries) {
+			if (e->name() == "prefix-length" && e->hasValueInt(0)) {
+				m_prefixLength = e->valueInt(0);
+				continue;
+			}
+			if (e->name() == "min-rate" && e->hasValueInt(0)) {
+				m_minRate = e->valueInt(0);
+				continue;
+			}
+			if (e->name() == "max-entries" && e->hasValueInt(0)) {
+				m_maxEntries = e->valueInt(0);
+				continue;
+			}
+			if (e->name() == "max-memory" && e->hasValueInt(0)) {
+				m_maxMemory = e->valueInt(0);
+				continue;
+			}
+			if (e->name() == "update-interval" && e->hasValueInt(0)) {
+				m_updateInterval = e->valueInt(0);
+				continue;
+			}
+			if (e->name() == "idle-after" && e->hasValueInt(0)) {
+				m_idleAfter = e->valueInt(0);
+				continue;
+			}
+			if (e->name() == "sketch-size" && e->hasValueInt(0)) {
+				m_sketchSize = e->valueInt(0);
+				continue;
+			}
 
+			g_logger.warning(stdext::format("[ProxyServerAutoCache::loadFromConfig] Unknown config entry '%s'", e->name()));
+		}
+
+		if (m_prefixLength < 2) {
+			g_logger.warning("[ProxyServerAutoCache::loadFromConfig] Invalid prefix-length");
+			return false;
+		}
+		if (m_minRate < 1 || m_maxEntries < 1 || m_maxMemory < 1 || m_sketchSize < 1) {
+			g_logger.warning("[ProxyServerAutoCache::loadFromConfig] Invalid min-rate, max-entries, max-memory or sketch-size");
+			return false;
+		}
+		if (m_updateInterval < 30) {
+			g_logger.warning("[ProxyServerAutoCache::loadFromConfig] Invalid update-interval");
+			return false;
+		}
+		if (m_idleAfter < CHECK_INTERVAL) {
+			g_logger.warning("[ProxyServerAutoCache::loadFromConfig] Invalid idle-after");
+			return false;
+		}
+
+		m_sketch.reset(new HeavyHitters(m_sketchSize));
+		return true;
 	}
 
 	// ************************************************************************************
-	void ProxyServer::poll() {
-		for(auto& e: m_cache) {
-			e->poll();
+	void ProxyServerAutoCache::start() {
+		m_checkEvent = g_dispatcher.cycleEvent([this](){ check(); }, CHECK_INTERVAL * 1000);
+	}
+
+	// ************************************************************************************
+	void ProxyServerAutoCache::tick(const OID& oid) {
+		if (static_cast<int32_t>(oid.size()) < m_prefixLength) return;
+
+		// bufor klucza uzywany ponownie - trafienie w sketch nic nie alokuje
+		m_key.clear();
+		for(int32_t i=0;i<m_prefixLength;++i) {
+			m_key.append(oid[i]);
+		}
+		m_sketch->tick(m_key);
+	}
+
+	// ************************************************************************************
+	void ProxyServerAutoCache::check() {
+		ticks_t now = g_clock.millis();
+
+		std::vector<ProxyServerCacheEntryPtr> entries(m_entries);
+		for(auto& e: entries) {
+			if (now - e->getLastReadTime() > m_idleAfter * 1000) {
+				retire(e, "not read");
+			}
+		}
+
+		size_t budget = static_cast<size_t>(m_maxMemory) * 1024;
+		size_t used = 0;
+		for(auto& e: m_entries) {
+			used += e->getMemoryUsage();
+		}
+		while(used > budget && !m_entries.empty()) {
+			auto oldest = m_entries.begin();
+			for(auto it=m_entries.begin();it!=m_entries.end();++it) {
+				if ((*it)->getLastReadTime() < (*oldest)->getLastReadTime()) oldest = it;
+			}
+			used -= (*oldest)->getMemoryUsage();
+			retire(*oldest, "over max-memory");
+		}
+
+		uint64_t threshold = static_cast<uint64_t>(m_minRate) * CHECK_INTERVAL;
+		m_sketch->top(m_top);
+		for(auto& c: m_top) {
+			if (c.guaranteed() < threshold) break;
+			if (static_cast<int32_t>(m_entries.size()) >= m_maxEntries || used >= budget) break;
+			if (overlaps(c.key)) continue;
+
+			auto known = m_knownMemory.find(c.key);
+			if (known != m_knownMemory.end() && used + known->second > budget) continue;
+
+			promote(c.key, c.guaranteed());
 		}
 
-		if (m_statsWriteInterval > 0 && m_statsSaveNextTime < g_clock.time()) {
-			m_statsSaveNextTime = g_clock.time() + m_statsWriteInterval;
-			saveStats();
+		// liczniki tylko z ostatniego okresu
+		m_sketch->clear();
+	}
+
+	// ************************************************************************************
+	bool ProxyServerAutoCache::overlaps(const OID& baseOID) const {
+		for(auto& e: m_server->m_cache) {
+			if (baseOID.startsWith(e->getBaseOID()) || e->getBaseOID().startsWith(baseOID)) return true;
 		}
+		return false;
 	}
 
 	// ************************************************************************************
-	bool ProxyServer::handleMessage(const io::InetEndpoint& source, const Value& message) {
+	void ProxyServerAutoCache::promote(const OID& baseOID, uint64_t count) {
+		ProxyServerCacheEntryPtr ce(new ProxyServerCacheEntry());
+		ce->initDynamic(baseOID, m_updateInterval);
+		ce->setClient(m_server->m_client, m_server->m_targetDestSocketSpec);
+		ce->start();
+
+		m_entries.push_back(ce);
+		m_server->m_cache.push_back(ce);
+
+		g_logger.info(stdext::format("[ProxyServerAutoCache::promote] [Proxy %s] Caching %s (%d requests in %d s)",
+			m_server->m_serverEndpoint.toString(),
+			baseOID.toString(),
+			static_cast<int32_t>(count),
+			static_cast<int32_t>(CHECK_INTERVAL)
+		));
+	}
+
+	// ************************************************************************************
+	void ProxyServerAutoCache::retire(const ProxyServerCacheEntryPtr& entry, const char* reason) {
+		g_logger.info(stdext::format("[ProxyServerAutoCache::retire] [Proxy %s] Dropping cache %s (%s)",
+			m_server->m_serverEndpoint.toString(),
+			entry->getBaseOID().toString(),
+			reason
+		));
+
+		ProxyServerCacheEntryPtr ce = entry;
+		g_cacheScheduler.remove(ce);
+
+		if (ce->isInitialized()) {
+			if (static_cast<int32_t>(m_knownMemory.size()) >= m_sketchSize) m_knownMemory.clear();
+			m_knownMemory[ce->getBaseOID()] = ce->getMemoryUsage();
+		}
+
+		auto& cache = m_server->m_cache;
+		cache.erase(std::remove(cache.begin(), cache.end(), ce), cache.end());
+		m_entries.erase(std::remove(m_entries.begin(), m_entries.end(), ce), m_entries.end());
+	}
+
+// ##############################################################################################################################
+// ProxyServer
+// ##############################################################################################################################
+
+	// ************************************************************************************
+	ProxyServer::ProxyServer() {
+		m_targetTimeout = 10000;
+		m_targetRetries = 0;
+		m_targetBackoff = 2.0f;
+		m_targetMaxInFlight = 0;
+		m_targetQueueTimeout = -1;
+		m_targetBatchMaxVarBindings = 0;
+		m_targetBatchMaxBytes = 1024;
+		m_targetBatchWindow = 0;
+		m_targetDnsTTL = 300;
+		m_statsEnabled = false;
+		m_statsWriteInterval = 0;
+		m_statsMaxOIDs = 65536;
+		m_statsLastSaveTime = 0;
+		m_statsWindowStartTime = 0;
+		m_cacheWrite = ProxyServerCacheWrite::UPDATE;
+	}
+
+	// ************************************************************************************
+	ProxyServer::~ProxyServer() {
+		if (m_statsEvent) m_statsEvent->cancel();
+	}
+
+	// ************************************************************************************
+	bool ProxyServer::handleMessage(const io::InetEndpoint& source, const Value& message, ticks_t receiveTime) {
 		// TODO: tutaj trzeba obslugiwac PDU od get/get-next/get-bulk/set
 		// i ustalic jakie to jest OIDSpec i na podstaiwe tego, czy moze jest cache czy nie
 		// + uzyc m_client do uzyskania tego co potrzeba
 
-		auto community = message[1].valueString();
+		// community sprawdzone juz przez SocketsManager
 		auto& pdu = message[2];
-		auto self = dynamic_self_cast<ProxyServer>();
-
-		if (std::find(m_serverCommunities.begin(), m_serverCommunities.end(), community) == m_serverCommunities.end()) {
-			// nie obslugujemy tego community
-			return false;
-		}
 
 		if (pdu.type() == ValueType::PDU_GET && pdu.size() == 4) {
-			processGet(source, message);
+			processGet(source, message, receiveTime);
 			return true;
 		}
 
 		if (pdu.type() == ValueType::PDU_SET && pdu.size() == 4) {
-			processSet(source, message);
+			processSet(source, message, receiveTime);
 			return true;
 		}
 
 		if (pdu.type() == ValueType::PDU_GET_NEXT && pdu.size() == 4) {
-			processGetNext(source, message);
+			processGetNext(source, message, receiveTime);
 			return true;
 		}
 
 		if (pdu.type() == ValueType::PDU_GET_BULK && pdu.size() == 4) {
-			processGetBulk(source, message);
+			processGetBulk(source, message, receiveTime);
 			return true;
 		}
 
@@ -352,16 +724,17 @@ namespace application { namespace snmp {
 
 	// ************************************************************************************
 	void ProxyServer::send(const io::InetEndpoint& dest, const Value& message) {
-		io::DataBuffer buf;
-		io::DataBufferOutputStream os(buf, true);
+		m_sendBuffer.clear();
+		io::DataBufferOutputStream os(m_sendBuffer, true);
 		SNMPOutputStreamAdapter snmpOS(os);
 		snmpOS.writeValue(message);
-		m_serverSocket->send(dest, buf);
+		m_serverSocket->send(dest, m_sendBuffer);
 	}
 
 	// ************************************************************************************
 	bool ProxyServer::loadFromConfig(const config::parser::ConfigEntriesCollection& entries, std::vector<ClientPtr>& clients) {
 		io::InetEndpoint socketSpec;
+		std::string targetDestSpec;
 
 		for(auto& e: entries) {
 			if (e->name() == "community") {
@@ -374,30 +747,68 @@ namespace application { namespace snmp {
 			}
 
 			if (e->name() == "socket" && e->hasValuePrimitive(0)) {
-				socketSpec = e->valuePrimitive(0);
+				socketSpec = io::InetEndpoint::resolve(e->valuePrimitive(0));
 				continue;
 			}
 
 			if (e->name() == "target" && e->hasValueBlock(0)) {
 				for(auto& ee: e->valueBlock(0)) {
 					if (ee->name() == "src-socket" && ee->hasValuePrimitive()) {
-						m_targetSourceSocketSpec = ee->valuePrimitive();
+						m_targetSourceSocketSpec = io::InetEndpoint::resolve(ee->valuePrimitive());
 						continue;
 					}
 					if (ee->name() == "dst-socket" && ee->hasValuePrimitive()) {
-						m_targetDestSocketSpec = ee->valuePrimitive();
+						targetDestSpec = ee->valuePrimitive();
+						m_targetDestSocketSpec = io::InetEndpoint::resolve(targetDestSpec);
 						continue;
 					}
 					if (ee->name() == "community" && ee->hasValuePrimitive()) {
 						m_targetCommunity = ee->valuePrimitive();
 						continue;
 					}
+					if (ee->name() == "timeout" && ee->hasValueInt()) {
+						m_targetTimeout = ee->valueInt();
+						continue;
+					}
+					if (ee->name() == "retries" && ee->hasValueInt()) {
+						m_targetRetries = ee->valueInt();
+						continue;
+					}
+					if (ee->name() == "backoff" && ee->hasValuePrimitive()) {
+						m_targetBackoff = stdext::toFloat(ee->valuePrimitive());
+						continue;
+					}
+					if (ee->name() == "max-in-flight" && ee->hasValueInt()) {
+						m_targetMaxInFlight = ee->valueInt();
+						continue;
+					}
+					if (ee->name() == "queue-timeout" && ee->hasValueInt()) {
+						m_targetQueueTimeout = ee->valueInt();
+						continue;
+					}
+					if (ee->name() == "batch-max-varbinds" && ee->hasValueInt()) {
+						m_targetBatchMaxVarBindings = ee->valueInt();
+						continue;
+					}
+					if (ee->name() == "batch-max-bytes" && ee->hasValueInt()) {
+						m_targetBatchMaxBytes = ee->valueInt();
+						continue;
+					}
+					if (ee->name() == "batch-window" && ee->hasValueInt()) {
+						m_targetBatchWindow = ee->valueInt();
+						continue;
+					}
+					if (ee->name() == "dns-ttl" && ee->hasValueInt()) {
+						m_targetDnsTTL = ee->valueInt();
+						continue;
+					}
 					g_logger.warning(stdext::format("[ProxyServer::loadFromConfig] Unknown config entry '%s'", ee->name()));
 				}
 				continue;
 			}
 
 			if (e->name() == "statistics" && e->hasValueBlock(0)) {
+				m_statsEnabled = true;
 				for(auto& ee: e->valueBlock(0)) {
 					if (ee->name() == "file" && ee->hasValuePrimitive()) {
 						m_statsFile = ee->valuePrimitive();
@@ -405,6 +816,32 @@ namespace application { namespace snmp {
 					if (ee->name() == "write-interval" && ee->hasValuePrimitive()) {
 						m_statsWriteInterval = ee->valueInt();
 					}
+					if (ee->name() == "max-oids" && ee->hasValueInt()) {
+						m_statsMaxOIDs = ee->valueInt();
+					}
+				}
+				continue;
+			}
+
+			if (e->name() == "cache-write" && e->hasValuePrimitive(0)) {
+				if (e->valuePrimitive(0) == "none") {
+					m_cacheWrite = ProxyServerCacheWrite::NONE;
+				} else if (e->valuePrimitive(0) == "update") {
+					m_cacheWrite = ProxyServerCacheWrite::UPDATE;
+				} else if (e->valuePrimitive(0) == "refetch") {
+					m_cacheWrite = ProxyServerCacheWrite::REFETCH;
+				} else {
+					g_logger.warning(stdext::format("[ProxyServer::loadFromConfig] Invalid cache-write '%s'", e->valuePrimitive(0)));
+					return false;
+				}
+				continue;
+			}
+
+			if (e->name() == "auto-cache" && e->hasValueBlock(0)) {
+				m_autoCache.reset(new ProxyServerAutoCache(this));
+				if (!m_autoCache->loadFromConfig(e->valueBlock(0))) {
+					g_logger.warning("[ProxyServer::loadFromConfig] Cannot load auto-cache");
+					return false;
 				}
 				continue;
 			}
@@ -435,8 +872,53 @@ namespace application { namespace snmp {
 			g_logger.warning("[ProxyServer::loadFromConfig] No target community given");
 			return false;
 		}
+		if (m_targetTimeout <= 0) {
+			g_logger.warning("[ProxyServer::loadFromConfig] Invalid target timeout");
+			return false;
+		}
+		if (m_targetRetries < 0) {
+			g_logger.warning("[ProxyServer::loadFromConfig] Invalid target retries");
+			return false;
+		}
+		if (m_targetBackoff < 1.0f) {
+			g_logger.warning("[ProxyServer::loadFromConfig] Invalid target backoff (must be >= 1.0)");
+			return false;
+		}
+		if (m_targetMaxInFlight < 0) {
+			g_logger.warning("[ProxyServer::loadFromConfig] Invalid target max-in-flight");
+			return false;
+		}
+		if (m_targetQueueTimeout < 0) {
+			m_targetQueueTimeout = m_targetTimeout;
+		}
+		if (m_targetDnsTTL < 0) {
+			g_logger.warning("[ProxyServer::loadFromConfig] Invalid target dns-ttl");
+			return false;
+		}
+		if (m_targetBatchMaxVarBindings < 0 || m_targetBatchMaxBytes <= 0 || m_targetBatchWindow < 0) {
+			g_logger.warning("[ProxyServer::loadFromConfig] Invalid target batch settings");
+			return false;
+		}
+
+		if (isStatsEnabled()) {
+			if (m_statsMaxOIDs <= 0) {
+				g_logger.warning("[ProxyServer::loadFromConfig] Invalid statistics max-oids");
+				return false;
+			}
+			m_statCounters.reset(new StatCounters(m_statsMaxOIDs));
+			m_statsLastSaveTime = g_clock.millis();
+			m_statsWindowStartTime = m_statsLastSaveTime;
+		}
 
 		m_client.reset(new Client(m_targetSourceSocketSpec, m_targetDestSocketSpec, m_targetCommunity));
+		m_client->setRequestTimeout(m_targetTimeout);
+		m_client->setRetries(m_targetRetries);
+		m_client->setBackoff(m_targetBackoff);
+		m_client->setMaxInFlight(m_targetMaxInFlight);
+		m_client->setQueueTimeout(m_targetQueueTimeout);
+		m_client->setBatchMaxVarBindings(m_targetBatchMaxVarBindings);
+		m_client->setBatchMaxBytes(m_targetBatchMaxBytes);
+		m_client->setBatchWindow(m_targetBatchWindow);
 		clients.push_back(m_client);
 
 		if (socketSpec.empty()) {
@@ -450,30 +932,102 @@ namespace application { namespace snmp {
 
 		for(auto& ce: m_cache) {
 			ce->setClient(m_client, m_targetDestSocketSpec);
+			ce->start();
+		}
+		if (m_autoCache) {
+			m_autoCache->start();
+		}
+
+		if (m_statsWriteInterval > 0 && !m_statsFile.empty()) {
+			m_statsEvent = g_dispatcher.cycleEvent([this](){ saveStats(); }, m_statsWriteInterval * 1000);
+		}
+
+		// target podany nazwa - adres odswiezany w tle
+		std::string targetHost;
+		int32_t targetPort = 0;
+		if (io::InetEndpoint::splitSpec(targetDestSpec, targetHost, targetPort) && !io::InetEndpoint::isAddress(targetHost)) {
+			ProxyServerPtr self = dynamic_self_cast<ProxyServer>();
+			g_resolver.watch(targetHost, m_targetDestSocketSpec, m_targetDnsTTL, [self](const io::InetEndpoint& endpoint){
+				self->setTargetEndpoint(endpoint);
+			});
 		}
 
+		m_serverEndpoint = socketSpec;
 		m_serverSocket = g_snmpSocketsManager.ensureServerSocket(socketSpec, dynamic_self_cast<ProxyServer>());
 		return true;
 	}
 
 	// ************************************************************************************
-	void ProxyServer::tickStat(const std::string& key) {
-		m_stats[key].tick(key);
+	void ProxyServer::setTargetEndpoint(const io::InetEndpoint& endpoint) {
+		m_targetDestSocketSpec = endpoint;
+
+		ClientPtr client = m_client;
+		client->inLoop([client, endpoint](){ client->setDestEndpoint(endpoint); });
+		for(auto& ce: m_cache) {
+			ce->setClient(m_client, endpoint);
+		}
 	}
 
 	// ************************************************************************************
 	void ProxyServer::saveStats() {
-		FILE* fp = fopen(m_statsFile.c_str(), "w");
+		if (!m_statCounters) return;
+
+		ticks_t now = g_clock.millis();
+		float seconds = static_cast<float>(now - m_statsLastSaveTime) / 1000.0f;
+		m_statsLastSaveTime = now;
+
+		// min/avg/max liczone w oknach 5 minutowych
+		float windowSeconds = static_cast<float>(now - m_statsWindowStartTime) / 1000.0f;
+		bool newWindow = windowSeconds >= STATS_WINDOW_SECONDS;
+		if (newWindow) m_statsWindowStartTime = now;
+
+		// zapis do pliku tymczasowego i podmiana, zeby czytajacy nigdy nie widzial polowy pliku
+		std::string tmpFile = m_statsFile + ".tmp";
+		FILE* fp = fopen(tmpFile.c_str(), "w");
 		if (fp != nullptr) {
 
-			for(auto& e: m_stats) {
-				fprintf(fp, "%s\n", e.second.toString().c_str());
+			for(int32_t handle=0;handle<m_statCounters->size();++handle) {
+				if (!m_statCounters->isUsed(handle)) continue;
+
+				std::string name = m_statCounters->isOverflow(handle) ? "<other>" : m_statCounters->oid(handle).toString();
+
+				StatOperation::forEach([&](StatOperation::Enum op){
+					uint64_t num = m_statCounters->count(handle, op);
+					if (num == 0) return;
+
+					auto& entry = m_statEntries[handle * StatOperation::COUNT + op];
+					entry.update(num, seconds, newWindow, windowSeconds);
+					fprintf(fp, "%s %s  num=%llu  rate1m=%.2f  rate5m=%.2f  rate15m=%.2f  min=%.2f  avg=%.2f  max=%.2f\n",
+						StatOperation::name(op), name.c_str(),
+						static_cast<unsigned long long>(entry.getNum()),
+						entry.getRate1(), entry.getRate5(), entry.getRate15(),
+						entry.getWindowMin(), entry.getWindowAvg(), entry.getWindowMax()
+					);
+				});
 			}
 
-			fclose(fp);
+			saveLatencyStats(fp, "cache-hit", m_cacheLatency);
+			saveLatencyStats(fp, "proxied", m_proxyLatency);
+			saveLatencyStats(fp, stdext::format("upstream %s", m_targetDestSocketSpec.toString()).c_str(), m_client->getRoundTripHistogram());
+
+			if (fclose(fp) == 0) {
+				if (::rename(tmpFile.c_str(), m_statsFile.c_str()) != 0) {
+					g_logger.warning(stdext::format("[ProxyServer::saveStats] Could not rename stats file to '%s'", m_statsFile));
+				}
+			}
 		}
 	}
 
+	// ************************************************************************************
+	void ProxyServer::saveLatencyStats(FILE* fp, const char* name, const LatencyHistogram& histogram) {
+		fprintf(fp, "latency %s  num=%llu  p50=%lldus  p99=%lldus  p999=%lldus\n", name,
+			static_cast<unsigned long long>(histogram.count()),
+			static_cast<long long>(histogram.percentile(0.5f)),
+			static_cast<long long>(histogram.percentile(0.99f)),
+			static_cast<long long>(histogram.percentile(0.999f))
+		);
+	}
+
 	// ************************************************************************************
 	ProxyServerCacheEntryPtr ProxyServer::findCacheFor(const OID& oid) {
 		for(auto& e: m_cache) {
@@ -483,38 +1037,190 @@ namespace application { namespace snmp {
 	}
 
 	// ************************************************************************************
-	void ProxyServer::proxyRequest(const io::InetEndpoint& source, const Value& requestMessage) {
-		auto self = dynamic_self_cast<ProxyServer>();
-		m_client->doRequest(requestMessage[2], [=](const Value& responseMessage, const SNMPError& error){
-			Value msg = requestMessage;
-			if (PDUUtils::copyMaintainingRequestID(msg, responseMessage)) {
-				// ok
-			} else {
-				PDUUtils::setError(msg, error);
+	ProxyServerRequest* ProxyServer::createRequest(const io::InetEndpoint& source, const Value& requestMessage, ticks_t receiveTime) {
+		ProxyServerRequest* req = m_requestPool.acquire();
+		req->server = static_self_cast<ProxyServer>();
+		req->source = source;
+		req->message = requestMessage;
+		req->receiveTime = receiveTime;
+		req->cacheWrite = false;
+		req->cacheRefetch = false;
+		return req;
+	}
+
+	// ************************************************************************************
+	void ProxyServer::releaseRequest(ProxyServerRequest* req) {
+		// serwer moze byc trzymany juz tylko przez ten request, wiec zwalniamy go na samym koncu
+		ProxyServerPtr self;
+		self.swap(req->server);
+		m_requestPool.release(req);
+	}
+
+	// ************************************************************************************
+	void ProxyServer::startProxied(ProxyServerRequest* req) {
+		bool res = m_client->doRequest(req->message[2], [req](const Value& responseMessage, const SNMPError& error){
+			req->server->completeProxied(req, responseMessage, error);
+		});
+		if (res) return;
+
+		// nie udalo sie utworzyc requestu - pytajacy dostaje blad zamiast czekac na timeout
+		completeProxied(req, Value::createNull(), SNMPError(SNMPError::SNMP_RESOURCE_UNAVAILABLE, 0));
+	}
+
+	// ************************************************************************************
+	void ProxyServer::completeProxied(ProxyServerRequest* req, const Value& responseMessage, const SNMPError& error) {
+		// wolane w watku klienta - odpowiedz jest skladana w request, wysylka w watku glownym
+		Value& msg = req->message;
+		if (PDUUtils::copyMaintainingRequestID(msg, responseMessage)) {
+			// ok
+		} else {
+			PDUUtils::setError(msg, error);
+		}
+
+		if (m_client->isThreaded()) {
+			g_dispatcher.pushEventSynchronized([req](){ req->server->sendProxied(req); });
+		} else {
+			sendProxied(req);
+		}
+	}
+
+	// ************************************************************************************
+	void ProxyServer::sendProxied(ProxyServerRequest* req) {
+		if (req->cacheRefetch) {
+			writeToCache(req);
+			releaseRequest(req);
+			return;
+		}
+
+		send(req->source, req->message);
+		m_proxyLatency.record(stdext::Time::micros() - req->receiveTime);
+
+		// ponowne pobranie wartosci po SET-cie idzie na tym samym requescie
+		if (req->cacheWrite && writeToCache(req)) return;
+		releaseRequest(req);
+	}
+
+	// ************************************************************************************
+	bool ProxyServer::writeToCache(ProxyServerRequest* req) {
+		Value& msg = req->message;
+		if (!msg.isMessage()) return false;
+		if (msg[2].type() != ValueType::PDU_RESPONSE || msg[2][1].valueInt() != 0) return false;
+
+		VarBindingRef::fromValue(msg[2][3], m_varBindings);
+
+		std::vector<VarBinding> refetch;
+		for(auto& e: m_varBindings) {
+			auto ce = findCacheFor(e.name);
+			if (!ce) continue;
+
+			// odpowiedz na SET bez wartosci niczego nie mowi - zostaje to, co bylo
+			if (req->cacheRefetch || !(e.value.isNull() || e.value.isException())) {
+				ce->applyWrite(e.name, e.value);
+			}
+			if (req->cacheWrite && m_cacheWrite == ProxyServerCacheWrite::REFETCH) {
+				VarBinding vb;
+				vb.name = e.name;
+				refetch.push_back(vb);
 			}
-			self->send(source, msg);
+		}
+		if (refetch.empty()) return false;
+
+		// agent moze zapisac inna wartosc niz ustawiona (normalizacja, zaokraglenia)
+		PDUUtils::setPDUType(msg, ValueType::PDU_GET);
+		PDUUtils::setVarBindings(msg, refetch);
+		req->cacheWrite = false;
+		req->cacheRefetch = true;
+		m_client->inLoop([req](){ req->server->startProxied(req); });
+		return true;
+	}
+
+	// ************************************************************************************
+	void ProxyServer::completeCached(ProxyServerRequest* req, const VarBinding* values, size_t num) {
+		// odpowiedz jest kodowana od razu z naglowka zapytania i wartosci z cache'a,
+		// bez budowania drzewa Value (przy GET-BULK to kilkadziesiat wezlow mniej)
+		const Value& msg = req->message;
+		const Value& pdu = msg[2];
+		bool isGet = pdu.type() == ValueType::PDU_GET;
+
+		m_sendBuffer.clear();
+		io::DataBufferOutputStream os(m_sendBuffer, true);
+		SNMPOutputStreamAdapter snmpOS(os);
+
+		snmpOS.writeSeq(ValueType::SEQUENCE,[&](){
+			snmpOS.writeValue(msg[0]);
+			snmpOS.writeValue(msg[1]);
+			snmpOS.writeSeq(ValueType::PDU_RESPONSE,[&](){
+				snmpOS.writeValue(pdu[0]);
+
+				if (num == 0 && isGet) {
+					// varbinding'i z zapytania
+					snmpOS.writeInt32(SNMPError::SNMP_NO_SUCH_NAME);
+					snmpOS.writeInt32(0);
+					snmpOS.writeValue(pdu[3]);
+					return;
+				}
+
+				snmpOS.writeValue(pdu[1]);
+				snmpOS.writeValue(pdu[2]);
+				snmpOS.writeSeq(ValueType::SEQUENCE,[&](){
+					if (num == 0) {
+						snmpOS.writeSeq(ValueType::SEQUENCE,[&](){
+							if (!snmpOS.writeOID(req->varName)) snmpOS.writeNull();
+							snmpOS.writeZeroLen(ValueType::END_OF_MIB_VIEW);
+						});
+					}
+					for(size_t i=0;i<num;++i) {
+						snmpOS.writeSeq(ValueType::SEQUENCE,[&](){
+							if (!snmpOS.writeOID(values[i].name)) snmpOS.writeNull();
+							snmpOS.writeValue(values[i].value);
+						});
+					}
+				});
+			});
 		});
+
+		m_serverSocket->send(req->source, m_sendBuffer);
+		m_cacheLatency.record(stdext::Time::micros() - req->receiveTime);
+		releaseRequest(req);
 	}
 
 	// ************************************************************************************
-	void ProxyServer::processSet(const io::InetEndpoint& source, const Value& requestMessage) {
-		// proxujemy 1:1
-		// TODO: a jak updatujemy cos co jest w cache, to chyba powinnismy to tez zmienic?
+	void ProxyServer::completeCachedOrProxy(ProxyServerRequest* req, const VarBinding* values, size_t num, size_t needed) {
+		if (num >= needed) {
+			completeCached(req, values, num);
+			return;
+		}
+
+		// poza zakresem dynamicznego wpisu - odpowiedz targetu (np. dalszy ciag przejscia tabeli)
+		m_client->inLoop([req](){ req->server->startProxied(req); });
+	}
+
+	// ************************************************************************************
+	void ProxyServer::proxyRequest(const io::InetEndpoint& source, const Value& requestMessage, ticks_t receiveTime) {
+		ProxyServerRequest* req = createRequest(source, requestMessage, receiveTime);
+		m_client->inLoop([req](){ req->server->startProxied(req); });
+	}
+
+	// ************************************************************************************
+	void ProxyServer::processSet(const io::InetEndpoint& source, const Value& requestMessage, ticks_t receiveTime) {
+		// proxujemy 1:1, a wartosci z udanej odpowiedzi trafiaja do cache'a (writeToCache)
 
 		if (isStatsEnabled()) {
-			auto varBindings = VarBindingRef::fromValue(requestMessage[2][3]);
-			for(auto& e: varBindings) {
-				tickStat(stdext::format("set %s", e.name.toString()));
+			VarBindingRef::fromValue(requestMessage[2][3], m_varBindings);
+			for(auto& e: m_varBindings) {
+				tickStat(e.name, StatOperation::SET);
 			}
 		}
 
-		proxyRequest(source, requestMessage);
+		ProxyServerRequest* req = createRequest(source, requestMessage, receiveTime);
+		req->cacheWrite = m_cacheWrite != ProxyServerCacheWrite::NONE && !m_cache.empty();
+		m_client->inLoop([req](){ req->server->startProxied(req); });
 	}
 
 	// ************************************************************************************
-	void ProxyServer::processGet(const io::InetEndpoint& source, const Value& requestMessage) {
-		auto varBindings = VarBindingRef::fromValue(requestMessage[2][3]);
-		auto self = dynamic_self_cast<ProxyServer>();
+	void ProxyServer::processGet(const io::InetEndpoint& source, const Value& requestMessage, ticks_t receiveTime) {
+		auto& varBindings = m_varBindings;
+		VarBindingRef::fromValue(requestMessage[2][3], varBindings);
 
 		if (varBindings.size() == 0) {
 			// TODO: a moze powinnismy odeslac puste?
@@ -524,40 +1230,36 @@ namespace application { namespace snmp {
 
 		if (isStatsEnabled()) {
 			for(auto& e: varBindings) {
-				tickStat(stdext::format("get %s", e.name.toString()));
+				tickStat(e.name, StatOperation::GET);
 			}
 		}
 
 		if (varBindings.size() > 1) {
-			g_logger.warning("[ProxyServer::processGet] Cache for more than one VarBinding not supported. Proxing 1:1");
-			proxyRequest(source, requestMessage);
+			LOG_WARNING_LIMITED("[ProxyServer::processGet] Cache for more than one VarBinding not supported. Proxing 1:1");
+			proxyRequest(source, requestMessage, receiveTime);
 			return;
 		}
 
 		auto ce = findCacheFor(varBindings[0].name);
-		if (ce) {
-			ce->doGetOne(varBindings[0].name, [=](const std::vector<VarBinding>& res){
-				Value msg = requestMessage;
-
-				PDUUtils::setPDUType(msg, ValueType::PDU_RESPONSE);
-
-				if (res.empty()) {
-					PDUUtils::setError(msg, SNMPError(SNMPError::SNMP_NO_SUCH_NAME, 0));
-				} else {
-					PDUUtils::setVarBindings(msg, res);
-				}
+		if (ce && ce->isDynamic() && !ce->isInitialized()) ce = nullptr;
 
-				self->send(source, msg);
+		if (ce) {
+			ProxyServerRequest* req = createRequest(source, requestMessage, receiveTime);
+			req->varName = varBindings[0].name;
+			size_t needed = ce->isDynamic() ? 1 : 0;
+			ce->doGetOne(req->varName, [req, needed](const VarBinding* values, size_t num){
+				req->server->completeCachedOrProxy(req, values, num, needed);
 			});
 		} else {
-			proxyRequest(source, requestMessage);
+			if (m_autoCache) m_autoCache->tick(varBindings[0].name);
+			proxyRequest(source, requestMessage, receiveTime);
 		}
 	}
 
 	// ************************************************************************************
-	void ProxyServer::processGetNext(const io::InetEndpoint& source, const Value& requestMessage) {
-		auto varBindings = VarBindingRef::fromValue(requestMessage[2][3]);
-		auto self = dynamic_self_cast<ProxyServer>();
+	void ProxyServer::processGetNext(const io::InetEndpoint& source, const Value& requestMessage, ticks_t receiveTime) {
+		auto& varBindings = m_varBindings;
+		VarBindingRef::fromValue(requestMessage[2][3], varBindings);
 
 		if (varBindings.size() == 0) {
 			// TODO: a moze powinnismy odeslac puste?
@@ -567,39 +1269,36 @@ namespace application { namespace snmp {
 
 		if (isStatsEnabled()) {
 			for(auto& e: varBindings) {
-				tickStat(stdext::format("get-next %s", e.name.toString()));
+				tickStat(e.name, StatOperation::GET_NEXT);
 			}
 		}
 
 		if (varBindings.size() > 1) {
-			g_logger.warning("[ProxyServer::processGetNext] Cache for more than one VarBinding not supported. Proxing 1:1");
-			proxyRequest(source, requestMessage);
+			LOG_WARNING_LIMITED("[ProxyServer::processGetNext] Cache for more than one VarBinding not supported. Proxing 1:1");
+			proxyRequest(source, requestMessage, receiveTime);
 			return;
 		}
 
 		auto ce = findCacheFor(varBindings[0].name);
-		if (ce) {
-			OID varName = varBindings[0].name;
-			ce->doGetNext(varName, [=](const std::vector<VarBinding>& res){
-				Value msg = requestMessage;
-				PDUUtils::setPDUType(msg, ValueType::PDU_RESPONSE);
+		if (ce && ce->isDynamic() && !ce->isInitialized()) ce = nullptr;
 
-				if (res.empty()) {
-					PDUUtils::setEndOfMIBView(msg, varName);
-				} else {
-					PDUUtils::setVarBindings(msg, res);
-				}
-				self->send(source, msg);
+		if (ce) {
+			ProxyServerRequest* req = createRequest(source, requestMessage, receiveTime);
+			req->varName = varBindings[0].name;
+			size_t needed = ce->isDynamic() ? 1 : 0;
+			ce->doGetNext(req->varName, [req, needed](const VarBinding* values, size_t num){
+				req->server->completeCachedOrProxy(req, values, num, needed);
 			});
 		} else {
-			proxyRequest(source, requestMessage);
+			if (m_autoCache) m_autoCache->tick(varBindings[0].name);
+			proxyRequest(source, requestMessage, receiveTime);
 		}
 	}
 
 	// ************************************************************************************
-	void ProxyServer::processGetBulk(const io::InetEndpoint& source, const Value& requestMessage) {
-		auto varBindings = VarBindingRef::fromValue(requestMessage[2][3]);
-		auto self = dynamic_self_cast<ProxyServer>();
+	void ProxyServer::processGetBulk(const io::InetEndpoint& source, const Value& requestMessage, ticks_t receiveTime) {
+		auto& varBindings = m_varBindings;
+		VarBindingRef::fromValue(requestMessage[2][3], varBindings);
 		int32_t maxRepetitions = requestMessage[2][2].valueInt();
 
 		if (varBindings.size() == 0) {
@@ -610,32 +1309,29 @@ namespace application { namespace snmp {
 
 		if (isStatsEnabled()) {
 			for(auto& e: varBindings) {
-				tickStat(stdext::format("get-bulk %s", e.name.toString()));
+				tickStat(e.name, StatOperation::GET_BULK);
 			}
 		}
 
 		if (varBindings.size() > 1) {
-			g_logger.warning("[ProxyServer::processGetBulk] Cache for more than one VarBinding not supported. Proxing 1:1");
-			proxyRequest(source, requestMessage);
+			LOG_WARNING_LIMITED("[ProxyServer::processGetBulk] Cache for more than one VarBinding not supported. Proxing 1:1");
+			proxyRequest(source, requestMessage, receiveTime);
 			return;
 		}
 
 		auto ce = findCacheFor(varBindings[0].name);
-		if (ce) {
-			OID varName = varBindings[0].name;
-			ce->doGetFrom(varName, maxRepetitions, [=](const std::vector<VarBinding>& res){
-				Value msg = requestMessage;
-				PDUUtils::setPDUType(msg, ValueType::PDU_RESPONSE);
+		if (ce && ce->isDynamic() && !ce->isInitialized()) ce = nullptr;
 
-				if (res.empty()) {
-					PDUUtils::setEndOfMIBView(msg, varName);
-				} else {
-					PDUUtils::setVarBindings(msg, res);
-				}
-				self->send(source, msg);
+		if (ce) {
+			ProxyServerRequest* req = createRequest(source, requestMessage, receiveTime);
+			req->varName = varBindings[0].name;
+			size_t needed = ce->isDynamic() ? static_cast<size_t>(std::max(maxRepetitions, 1)) : 0;
+			ce->doGetFrom(req->varName, maxRepetitions, [req, needed](const VarBinding* values, size_t num){
+				req->server->completeCachedOrProxy(req, values, num, needed);
 			});
 		} else {
-			proxyRequest(source, requestMessage);
+			if (m_autoCache) m_autoCache->tick(varBindings[0].name);
+			proxyRequest(source, requestMessage, receiveTime);
 		}
 	}
 
@@ -28,63 +28,254 @@
 
 #include "base.h"
 #include "Value.h"
+#include "Statistics.h"
 
+#include <cstdio>
 #include <unordered_map>
 
 #include <io/InetEndpoint.h>
-#include <boost/circular_buffer.hpp>
+#include <io/buffers.h>
+#include <core/eventdispatcher.h>
 
 namespace application { namespace snmp {
 
+	ENUM_DEFINE(ProxyServerCacheQuery,
+		ALL = 0,
+		ONE = 1,
+		FROM = 2,
+		NEXT = 3,
+	);
+
+	// co robi udany SET z wartosciami w cache'u
+	ENUM_DEFINE(ProxyServerCacheWrite,
+		NONE = 0,
+		UPDATE = 1,
+		REFETCH = 2,
+	);
+
 	class ProxyServerCacheEntry: public stdext::object {
 		public:
-			typedef std::function<void(const std::vector<VarBinding>& res)> Callback;
+			// wyniki to ciagly fragment posortowanych wartosci cache'a (bez kopiowania)
+			typedef stdext::inplace_function<void(const VarBinding* values, size_t num)> Callback;
 
 			ProxyServerCacheEntry();
 			virtual ~ProxyServerCacheEntry();
 
 			bool loadFromConfig(const std::string& oid, const config::parser::ConfigEntriesCollection& entries);
+			// wpis dodany przez ProxyServerAutoCache
+			void initDynamic(const OID& baseOID, int32_t updateInterval);
 
 			void setClient(const ClientPtr& client, const io::InetEndpoint& dest);
 			bool matches(const OID& oid) const;
-			void poll();
+			void start();
+
+			const OID& getBaseOID() const { return m_baseOID; }
+			int32_t getValuesCount() const { return m_values.size(); }
+			bool isInitialized() const { return m_initialized; }
+			bool isDynamic() const { return m_dynamic; }
+			// ms od ostatniej udanej aktualizacji
+			ticks_t getAge() const;
+			ticks_t getLastReadTime() const { return m_lastReadTime; }
+			// przyblizona pamiec zajmowana przez wartosci (bajty)
+			size_t getMemoryUsage() const { return m_memoryUsage; }
+
+			void doGetAll(Callback&& func);
+			void doGetOne(const OID& oid, Callback&& func);
+			void doGetFrom(const OID& start, int32_t num, Callback&& func);
+			void doGetNext(const OID& oid, Callback&& func);
 
-			void doGetAll(const Callback& func);
-			void doGetOne(const OID& oid, const Callback& func);
-			void doGetFrom(const OID& start, int32_t num, const Callback& func);
-			void doGetNext(const OID& oid, const Callback& func);
+			// wartosc ustawiona przez SET (lub pobrana zaraz po nim), NULL - instancji juz nie ma
+			void applyWrite(const OID& name, const Value& value);
 
 
 		private:
+			// zapytanie czekajace na zakonczenie aktualizacji
+			class WaitingCall {
+				public:
+					ProxyServerCacheQuery::Enum query;
+					OID oid;
+					int32_t num;
+					Callback callback;
+
+					WaitingCall(ProxyServerCacheQuery::Enum query, const OID& oid, int32_t num, Callback&& callback)
+						: query(query), oid(oid), num(num), callback(std::move(callback)) { }
+			};
+
 			OID m_baseOID;
 			std::vector<VarBinding> m_values;
 			int32_t m_updateInterval;
-			ticks_t m_nextUpdateTime;
 			bool m_updating;
 			bool m_initialized;
+			bool m_dynamic;
+			ticks_t m_updatedTime;
+			size_t m_memoryUsage;
+
+			// tryb adaptacyjny (sekundy, 0 - wylaczone): nieczytany cache odswiezany coraz
+			// rzadziej (do idle-interval), po dormant-after bez odczytow wcale, a odczyt
+			// starszy niz max-age czeka na swieze dane
+			int32_t m_idleInterval;
+			int32_t m_dormantAfter;
+			int32_t m_maxAge;
+			int32_t m_currentInterval;
+			ticks_t m_lastReadTime;
+			// w trakcie odpowiadania czekajacym zapytaniom (bez ponownego czekania)
+			bool m_replaying;
+
+			// zapisy z SET-ow w trakcie aktualizacji - nakladane na jej wynik
+			std::vector<VarBinding> m_writes;
+
+			// stan w CacheScheduler - termin (g_clock.millis()) i liczba odczytow od ostatniej aktualizacji
+			ticks_t m_nextUpdateTime;
+			int32_t m_readCount;
+			bool m_startFailed;
 
 			ClientPtr m_client;
 			io::InetEndpoint m_destEndpoint;
 
-			std::vector<std::function<void(void)>> m_waitingCalls;
+			std::vector<WaitingCall> m_waitingCalls;
 
-			void doUpdate();
-			void processUpdateResult(const std::vector<VarBinding>& values, const SNMPError& error);
+			// wynik aktualizacji z watku klienta, przekazywany do watku glownego
+			std::vector<VarBinding> m_updateValues;
+			SNMPError m_updateError;
+
+			bool waitForUpdate(ProxyServerCacheQuery::Enum query, const OID& oid, int32_t num, Callback& func);
+			void storeValue(const OID& name, const Value& value);
+			bool isDormant(ticks_t now) const;
+			int32_t nextUpdateInterval();
+			bool doUpdate();
+			void processUpdateResult(std::vector<VarBinding>& values, const SNMPError& error);
+
+			friend class CacheScheduler;
+	};
+
+	/**
+	 * Kontekst jednego zapytania od klienta - od odebrania do wyslania odpowiedzi.
+	 * Obiekty sa brane z puli serwera i do niej wracaja (razem z zaalokowana juz
+	 * pamiecia wiadomosci), callbacki przechwytuja tylko wskaznik.
+	 */
+	class ProxyServerRequest {
+		public:
+			ProxyServerPtr server;
+			io::InetEndpoint source;
+			Value message;
+			OID varName;
+			ticks_t receiveTime;
+			// SET do zapisania w cache'u / GET pobierajacy wartosci po SET-cie
+			bool cacheWrite;
+			bool cacheRefetch;
+
+			ProxyServerRequest() : receiveTime(0), cacheWrite(false), cacheRefetch(false) { }
 	};
 
+	class ProxyServerRequestPool {
+		public:
+			ProxyServerRequestPool();
+			~ProxyServerRequestPool();
+
+			size_t size() const { return m_requests.size(); }
+			size_t getUsedCount() const { return m_requests.size() - m_free.size(); }
+
+			ProxyServerRequest* acquire();
+			void release(ProxyServerRequest* req);
+
+		private:
+			std::vector<std::unique_ptr<ProxyServerRequest>> m_requests;
+			std::vector<ProxyServerRequest*> m_free;
+
+			ProxyServerRequestPool(const ProxyServerRequestPool& from);
+			ProxyServerRequestPool& operator=(const ProxyServerRequestPool& from);
+	};
+
+	/**
+	 * Stan statystyki po stronie zrzutu (liczniki sa w StatCounters).
+	 * Srednie kroczace 1m/5m/15m (wykladniczo wygaszane) oraz min/avg/max
+	 * tempa w ostatnim pelnym oknie. Stala pamiec, aktualizacja O(1) przy zrzucie.
+	 */
 	class ProxyServerStatEntry {
 		public:
 			ProxyServerStatEntry();
 
-			void tick(const std::string& name);
-			std::string toString() const;
+			void update(uint64_t num, float seconds, bool newWindow, float windowSeconds);
+
+			uint64_t getNum() const { return m_num; }
+			float getRate1() const { return m_rate[0]; }
+			float getRate5() const { return m_rate[1]; }
+			float getRate15() const { return m_rate[2]; }
+
+			float getWindowMin() const { return m_windowMin; }
+			float getWindowAvg() const { return m_windowAvg; }
+			float getWindowMax() const { return m_windowMax; }
+
+		private:
+			uint64_t m_num;
+			uint64_t m_windowStartNum;
+			float m_rate[3];
+			bool m_initialized;
+
+			// okno biezace
+			float m_curMin;
+			float m_curMax;
+
+			// ostatnie pelne okno
+			float m_windowMin;
+			float m_windowAvg;
+			float m_windowMax;
+	};
+
+	/**
+	 * Automatyczny cache dla czesto czytanych poddrzew (np. kolumn tabel).
+	 * Zapytania, ktorych nie obsluzyl zaden cache, sa liczone per prefiks OID
+	 * (prefix-length elementow) w HeavyHitters. Co CHECK_INTERVAL sekund prefiksy
+	 * czytane czesciej niz min-rate/s staja sie dynamicznymi wpisami cache'a
+	 * (w granicach max-entries i max-memory), a wpisy nieczytane przez idle-after
+	 * sekund - albo najdawniej czytane, gdy przekroczony jest budzet pamieci - sa usuwane.
+	 *
+	 * Dynamiczny wpis obsluguje tylko zapytania, na ktore ma pelna odpowiedz -
+	 * przed pierwszym wypelnieniem i na koncu poddrzewa zapytanie idzie do targetu.
+	 */
+	class ProxyServerAutoCache {
+		public:
+			ProxyServerAutoCache(ProxyServer* server);
+			~ProxyServerAutoCache();
+
+			bool loadFromConfig(const config::parser::ConfigEntriesCollection& entries);
+			void start();
+
+			// zapytanie o pojedynczy OID nieobsluzone przez cache
+			void tick(const OID& oid);
 
-			float getPerSecond() const;
+			int32_t getEntriesCount() const { return m_entries.size(); }
 
 		private:
-			std::string m_name;
-			int32_t m_num;
-			boost::circular_buffer<ticks_t> m_lastTimes;
+			static const int32_t CHECK_INTERVAL = 10;
+
+			ProxyServer* m_server;
+
+			int32_t m_prefixLength;
+			int32_t m_minRate;
+			int32_t m_maxEntries;
+			int32_t m_maxMemory;
+			int32_t m_updateInterval;
+			int32_t m_idleAfter;
+			int32_t m_sketchSize;
+
+			std::unique_ptr<HeavyHitters> m_sketch;
+			OID m_key;
+			std::vector<HeavyHitters::Counter> m_top;
+
+			std::vector<ProxyServerCacheEntryPtr> m_entries;
+			core::ScheduledEventPtr m_checkEvent;
+
+			// zmierzona pamiec usunietych wpisow - zeby nie dodawac ponownie tych, ktore sie nie mieszcza
+			std::unordered_map<OID, size_t> m_knownMemory;
+
+			void check();
+			bool overlaps(const OID& baseOID) const;
+			void promote(const OID& baseOID, uint64_t count);
+			void retire(const ProxyServerCacheEntryPtr& entry, const char* reason);
+
+			ProxyServerAutoCache(const ProxyServerAutoCache& from);
+			ProxyServerAutoCache& operator=(const ProxyServerAutoCache& from);
 	};
 
 	class ProxyServer: public stdext::object {
@@ -92,44 +283,101 @@ namespace application { namespace snmp {
 			ProxyServer();
 			virtual ~ProxyServer();
 
-			void poll();
-			bool handleMessage(const io::InetEndpoint& source, const Value& message);
+			bool handleMessage(const io::InetEndpoint& source, const Value& message, ticks_t receiveTime);
 
 			void replyError(const io::InetEndpoint& dest, const Value& orginalMessage, const SNMPError& err);
 			void send(const io::InetEndpoint& dest, const Value& message);
 
 			bool loadFromConfig(const config::parser::ConfigEntriesCollection& entries, std::vector<ClientPtr>& clients);
 
+			// metryki
+			const io::InetEndpoint& getEndpoint() const { return m_serverEndpoint; }
+			const StringVector& getCommunities() const { return m_serverCommunities; }
+			const io::InetEndpoint& getTargetEndpoint() const { return m_targetDestSocketSpec; }
+			const ClientPtr& getClient() const { return m_client; }
+			const StatCounters* getStatCounters() const { return m_statCounters.get(); }
+			const LatencyHistogram& getCacheLatency() const { return m_cacheLatency; }
+			const LatencyHistogram& getProxyLatency() const { return m_proxyLatency; }
+			const std::vector<ProxyServerCacheEntryPtr>& getCacheEntries() const { return m_cache; }
+
+			// nowy adres targetu po zmianie w DNS
+			void setTargetEndpoint(const io::InetEndpoint& endpoint);
+
 		private:
+			io::InetEndpoint m_serverEndpoint;
 			SocketPtr m_serverSocket;
 			StringVector m_serverCommunities;
 
 			io::InetEndpoint m_targetSourceSocketSpec;
 			io::InetEndpoint m_targetDestSocketSpec;
 			std::string m_targetCommunity;
+			int32_t m_targetTimeout;
+			int32_t m_targetRetries;
+			float m_targetBackoff;
+			int32_t m_targetMaxInFlight;
+			int32_t m_targetQueueTimeout;
+			int32_t m_targetBatchMaxVarBindings;
+			int32_t m_targetBatchMaxBytes;
+			int32_t m_targetBatchWindow;
+			int32_t m_targetDnsTTL;
 
 			ClientPtr m_client;
 
 			std::string m_statsFile;
 			int32_t m_statsWriteInterval;
+			core::ScheduledEventPtr m_statsEvent;
+
+			int32_t m_statsMaxOIDs;
+
+			static const int32_t STATS_WINDOW_SECONDS = 300;
 
-			std::unordered_map<std::string,ProxyServerStatEntry> m_stats;
-			ticks_t m_statsSaveNextTime;
+			std::unique_ptr<StatCounters> m_statCounters;
+			// tylko dla par (uchwyt, operacja), ktore mialy juz zapytania - klucz uchwyt * COUNT + operacja
+			std::unordered_map<int32_t, ProxyServerStatEntry> m_statEntries;
+			ticks_t m_statsLastSaveTime;
+			ticks_t m_statsWindowStartTime;
 
-			bool isStatsEnabled() const { return m_statsWriteInterval > 0; }
-			void tickStat(const std::string& key);
+			// od odebrania zapytania do wyslania odpowiedzi
+			LatencyHistogram m_cacheLatency;
+			LatencyHistogram m_proxyLatency;
+
+			bool m_statsEnabled;
+
+			bool isStatsEnabled() const { return m_statsEnabled; }
+			void tickStat(const OID& oid, StatOperation::Enum op) { m_statCounters->tick(oid, op); }
 			void saveStats();
+			void saveLatencyStats(FILE* fp, const char* name, const LatencyHistogram& histogram);
 
 			std::vector<ProxyServerCacheEntryPtr> m_cache;
+			std::unique_ptr<ProxyServerAutoCache> m_autoCache;
+			ProxyServerCacheWrite::Enum m_cacheWrite;
 
 			ProxyServerCacheEntryPtr findCacheFor(const OID& oid);
 
-			void proxyRequest(const io::InetEndpoint& source, const Value& requestMessage);
+			ProxyServerRequestPool m_requestPool;
+
+			// bufory robocze uzywane ponownie przy kazdym zapytaniu
+			std::vector<VarBindingRef> m_varBindings;
+			io::DataBuffer m_sendBuffer;
+
+			ProxyServerRequest* createRequest(const io::InetEndpoint& source, const Value& requestMessage, ticks_t receiveTime);
+			void releaseRequest(ProxyServerRequest* req);
+			void startProxied(ProxyServerRequest* req);
+			void completeProxied(ProxyServerRequest* req, const Value& responseMessage, const SNMPError& error);
+			void sendProxied(ProxyServerRequest* req);
+			bool writeToCache(ProxyServerRequest* req);
+			void completeCached(ProxyServerRequest* req, const VarBinding* values, size_t num);
+			// dynamiczny cache - krotsza odpowiedz niz needed idzie jednak do targetu
+			void completeCachedOrProxy(ProxyServerRequest* req, const VarBinding* values, size_t num, size_t needed);
+
+			void proxyRequest(const io::InetEndpoint& source, const Value& requestMessage, ticks_t receiveTime);
+
+			void processSet(const io::InetEndpoint& source, const Value& requestMessage, ticks_t receiveTime);
+			void processGet(const io::InetEndpoint& source, const Value& requestMessage, ticks_t receiveTime);
+			void processGetNext(const io::InetEndpoint& source, const Value& requestMessage, ticks_t receiveTime);
+			void processGetBulk(const io::InetEndpoint& source, const Value& requestMessage, ticks_t receiveTime);
 
-			void processSet(const io::InetEndpoint& source, const Value& requestMessage);
-			void processGet(const io::InetEndpoint& source, const Value& requestMessage);
-			void processGetNext(const io::InetEndpoint& source, const Value& requestMessage);
-			void processGetBulk(const io::InetEndpoint& source, const Value& requestMessage);
+			friend class ProxyServerAutoCache;
 	};
 
 
@@ -36,10 +36,100 @@
 
 namespace application { namespace snmp {
 
+	// ************************************************************************************
+	SocketRequestTable::SocketRequestTable() : m_slots(INITIAL_CAPACITY), m_mask(INITIAL_CAPACITY - 1), m_size(0) {
+
+	}
+
+	// ************************************************************************************
+	size_t SocketRequestTable::findSlot(int32_t requestID) const {
+		// zapelnienie <= 1/2, wiec zawsze jest wolny slot konczacy probkowanie
+		size_t idx = static_cast<uint32_t>(requestID) & m_mask;
+		while(m_slots[idx].requestID != 0 && m_slots[idx].requestID != requestID) {
+			idx = (idx + 1) & m_mask;
+		}
+		return idx;
+	}
+
+	// ************************************************************************************
+	bool SocketRequestTable::insert(int32_t requestID, const SocketRequestRoute& route) {
+		if ((m_size + 1) * 2 > m_slots.size()) grow();
+
+		size_t idx = findSlot(requestID);
+		if (m_slots[idx].requestID == requestID) return false;
+
+		m_slots[idx].requestID = requestID;
+		m_slots[idx].route = route;
+		m_size += 1;
+		return true;
+	}
+
+	// ************************************************************************************
+	void SocketRequestTable::erase(int32_t requestID) {
+		if (requestID == 0) return;
+
+		size_t idx = findSlot(requestID);
+		if (m_slots[idx].requestID == requestID) eraseSlot(idx);
+	}
+
+	// ************************************************************************************
+	void SocketRequestTable::eraseSlot(size_t idx) {
+		// przesuwanie wstecz zamiast znacznikow usuniecia - kolejne wpisy z tego samego ciagu
+		// wracaja blizej swojej pozycji startowej
+		size_t hole = idx;
+		size_t next = (idx + 1) & m_mask;
+		while(m_slots[next].requestID != 0) {
+			size_t home = static_cast<uint32_t>(m_slots[next].requestID) & m_mask;
+			if (((next - home) & m_mask) >= ((next - hole) & m_mask)) {
+				m_slots[hole] = m_slots[next];
+				hole = next;
+			}
+			next = (next + 1) & m_mask;
+		}
+
+		m_slots[hole] = Slot();
+		m_size -= 1;
+	}
+
+	// ************************************************************************************
+	void SocketRequestTable::eraseClient(Client* client) {
+		// po usunieciu w slot moze wejsc kolejny wpis z ciagu, wiec indeks zostaje ten sam
+		for(size_t idx=0;idx < m_slots.size();) {
+			if (m_slots[idx].requestID != 0 && m_slots[idx].route.client == client) {
+				eraseSlot(idx);
+			} else {
+				idx += 1;
+			}
+		}
+	}
+
+	// ************************************************************************************
+	const SocketRequestRoute* SocketRequestTable::find(int32_t requestID) const {
+		if (requestID == 0) return nullptr;
+
+		size_t idx = findSlot(requestID);
+		if (m_slots[idx].requestID != requestID) return nullptr;
+		return &m_slots[idx].route;
+	}
+
+	// ************************************************************************************
+	void SocketRequestTable::grow() {
+		std::vector<Slot> old(m_slots.size() * 2);
+		old.swap(m_slots);
+		m_mask = m_slots.size() - 1;
+
+		for(auto& slot: old) {
+			if (slot.requestID != 0) {
+				m_slots[findSlot(slot.requestID)] = slot;
+			}
+		}
+	}
+
 	// ************************************************************************************
 	Socket::Socket(const io::InetEndpoint& spec) {
 		m_endpoint = spec;
 		m_lastUseTime = g_clock.time();
+		m_nextRequestID = 1;
 
 		if (spec.empty()) {
 			g_logger.fatal("[Socket::Socket] Empty endpoint given");
@@ -54,10 +144,9 @@ namespace application { namespace snmp {
 				g_logger.fatal(stdext::format("[Socket::Socket] could not bind socket to %s", spec.toString()));
 				::close(fd);
 			} else {
-				auto self = dynamic_self_cast<Socket>();
-
+				// samo 'this' miesci sie w std::function bez alokacji; close() zeruje callbacki
 				m_socket = io::FileDescriptor::Adapt(fd);
-				m_socket->onReadReady(std::bind(&Socket::onRead, self, std::placeholders::_1));
+				m_socket->onReadReady([this](io::FileDescriptorPtr fd){ onRead(fd); });
 			}
 		} else {
 			g_logger.fatal(stdext::format("[Socket::Socket] could not create socket,  %s", spec.toString()));
@@ -77,20 +166,58 @@ namespace application { namespace snmp {
 
 	// ************************************************************************************
 	void Socket::close() {
+		if (m_socket.empty()) return;
+
+		m_socket->onReadReady(io::FileDescriptor::CallbackFunc());
+		m_socket->onWriteReady(io::FileDescriptor::CallbackFunc());
 		m_socket->close();
 		m_socket.reset();
 	}
 
+	// ************************************************************************************
+	void Socket::rebind(io::IO* io) {
+		if (m_socket.empty()) return;
+		m_socket->rebind(io);
+	}
+
+	// ************************************************************************************
+	int32_t Socket::registerRequest(Client* client, int32_t handle) {
+		// zajete numery sa pomijane - po przekreceniu licznika moga jeszcze czekac stare zapytania
+		while(true) {
+			int32_t requestID = m_nextRequestID;
+			m_nextRequestID = m_nextRequestID == 0x7FFFFFFF ? 1 : m_nextRequestID + 1;
+
+			if (m_requests.insert(requestID, SocketRequestRoute(client, handle))) {
+				return requestID;
+			}
+		}
+	}
+
+	// ************************************************************************************
+	void Socket::unregisterRequest(int32_t requestID) {
+		m_requests.erase(requestID);
+	}
+
+	// ************************************************************************************
+	void Socket::unregisterClient(Client* client) {
+		m_requests.eraseClient(client);
+	}
+
+	// ************************************************************************************
+	const SocketRequestRoute* Socket::findRequest(int32_t requestID) const {
+		return m_requests.find(requestID);
+	}
+
 	// ************************************************************************************
 	bool Socket::send(const io::InetEndpoint& to, const io::DataBuffer& buf) {
 		if (!m_socket) return false;
 		if (to.empty()) return false;
 
-		auto self = dynamic_self_cast<Socket>();
-		auto sinAddr = to.toSockAddr();
+		if (m_sendFree.empty()) m_sendFree.emplace_back();
+		m_toSend.splice(m_toSend.end(), m_sendFree, m_sendFree.begin());
+		m_toSend.back().assign(to.toSockAddr(), buf);
 
-		m_toSend.push_back(SocketSendRequest(sinAddr, buf));
-		m_socket->onWriteReady(std::bind(&Socket::onWrite, self, std::placeholders::_1));
+		m_socket->onWriteReady([this](io::FileDescriptorPtr fd){ onWrite(fd); });
 
 		return true;
 	}
@@ -101,7 +228,7 @@ namespace application { namespace snmp {
 
 		if (!m_recvVec.empty()) {
 			out = m_recvVec.front().buf;
-			m_recvVec.pop_front();
+			popRead();
 			return true;
 		} else {
 			return false;
@@ -115,16 +242,36 @@ namespace application { namespace snmp {
 		if (!m_recvVec.empty()) {
 			out = m_recvVec.front().buf;
 			source = m_recvVec.front().from;
-			m_recvVec.pop_front();
+			popRead();
 			return true;
 		} else {
 			return false;
 		}
 	}
 
+	// ************************************************************************************
+	bool Socket::read(io::InetEndpoint& source, io::DataBuffer& out, ticks_t& receiveTime) {
+		if (!m_socket) return false;
+
+		if (!m_recvVec.empty()) {
+			out = m_recvVec.front().buf;
+			source = m_recvVec.front().from;
+			receiveTime = m_recvVec.front().time;
+			popRead();
+			return true;
+		} else {
+			return false;
+		}
+	}
+
+	// ************************************************************************************
+	void Socket::popRead() {
+		m_recvFree.splice(m_recvFree.begin(), m_recvVec, m_recvVec.begin());
+	}
+
 	// ************************************************************************************
 	void Socket::onRead(io::FileDescriptorPtr fd) {
-		char buf[65536] = { 0 };
+		char buf[65536];
 		sockaddr_in addr = { 0 };
 		socklen_t addrLen = sizeof(sockaddr_in);
 
@@ -132,16 +279,24 @@ namespace application { namespace snmp {
 		m_lastUseTime = g_clock.time();
 
 		int32_t res = ::recvfrom(m_socket->fd(), buf, sizeof(buf), 0, (sockaddr*)&addr, &addrLen);
+		ticks_t receiveTime = stdext::Time::micros();
 		if (res > 0) {
-			auto self = dynamic_self_cast<Socket>();
-			io::DataBuffer dataBuffer(buf, res);
-			io::InetEndpoint endpoint(addr);
-			m_recvVec.push_back(SocketReadEntry(endpoint, dataBuffer));
+			if (m_recvFree.empty()) m_recvFree.emplace_back();
+			m_recvVec.splice(m_recvVec.end(), m_recvFree, m_recvFree.begin());
+
+			auto& entry = m_recvVec.back();
+			entry.from = io::InetEndpoint(addr);
+			entry.buf.assign(buf, res);
+			entry.time = receiveTime;
 
-			//g_logger.debug(stdext::format("[Socket::onRead] socket=%s from=%s", m_endpoint.toString(), endpoint.toString()));
-			//dataBuffer.debugLog(16);
+			//g_logger.debug(stdext::format("[Socket::onRead] socket=%s from=%s", m_endpoint.toString(), entry.from.toString()));
+			//entry.buf.debugLog(16);
 
-			m_socket->onReadReady(std::bind(&Socket::onRead, self, std::placeholders::_1));
+			m_socket->onReadReady([this](io::FileDescriptorPtr fd){ onRead(fd); });
+
+			if (m_packetCallback) {
+				m_packetCallback();
+			}
 		}
 
 		if (res == 0) {
@@ -149,7 +304,7 @@ namespace application { namespace snmp {
 		}
 
 		if (res < 0) {
-			g_logger.warning(stdext::format("Error recvfrom socket (%s) - %s", m_endpoint.toString(), strerror(errno)));
+			LOG_WARNING_LIMITED(stdext::format("Error recvfrom socket (%s) - %s", m_endpoint.toString(), strerror(errno)));
 			close();
 		}
 	}
@@ -171,15 +326,14 @@ namespace application { namespace snmp {
 
 		int32_t res = sendto(m_socket->fd(), &toSend.buf()[0], toSend.buf().size(), 0, (sockaddr*)&addr, addrLen);
 
-		m_toSend.pop_front();
+		m_sendFree.splice(m_sendFree.begin(), m_toSend, m_toSend.begin());
 		if (res < 0) {
-			g_logger.warning(stdext::format("Error sendto socket (%s) - %s", m_endpoint.toString(), strerror(errno)));
+			LOG_WARNING_LIMITED(stdext::format("Error sendto socket (%s) - %s", m_endpoint.toString(), strerror(errno)));
 			close();
 		} else {
 
 			if (!m_toSend.empty()) {
-				auto self = dynamic_self_cast<Socket>();
-				m_socket->onWriteReady(std::bind(&Socket::onWrite, self, std::placeholders::_1));
+				m_socket->onWriteReady([this](io::FileDescriptorPtr fd){ onWrite(fd); });
 			}
 
 		}
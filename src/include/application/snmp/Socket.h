@@ -36,29 +36,100 @@ namespace application { namespace snmp {
 
 	class SocketSendRequest {
 		public:
+			SocketSendRequest() : m_addr() { }
 			SocketSendRequest(const sockaddr_in& addr, const io::DataBuffer& buf) : m_buf(buf), m_addr(addr) { }
 
 			const io::DataBuffer& buf() const { return m_buf; }
 			const sockaddr_in& addr() const { return m_addr; }
 
+			void assign(const sockaddr_in& addr, const io::DataBuffer& buf) { m_addr = addr; m_buf = buf; }
+
 		private:
 			io::DataBuffer m_buf;
 			sockaddr_in m_addr;
 	};
 
 
+	// klient, ktory wyslal zapytanie, i uchwyt requestu w jego ClientRequestTable
+	class SocketRequestRoute {
+		public:
+			Client* client;
+			int32_t handle;
+
+			SocketRequestRoute() : client(nullptr), handle(0) { }
+			SocketRequestRoute(Client* client, int32_t handle) : client(client), handle(handle) { }
+	};
+
+
+	/**
+	 * requestID -> SocketRequestRoute, adresowanie otwarte z liniowym probkowaniem.
+	 * RequestID sa kolejnymi liczbami, wiec (id & mask) zwykle rozklada je bez kolizji.
+	 * Alokuje tylko przy powiekszaniu tablicy (zapelnienie powyzej 1/2), nigdy per zapytanie.
+	 */
+	class SocketRequestTable {
+		public:
+			SocketRequestTable();
+
+			bool insert(int32_t requestID, const SocketRequestRoute& route);
+			void erase(int32_t requestID);
+			void eraseClient(Client* client);
+			const SocketRequestRoute* find(int32_t requestID) const;
+
+			size_t size() const { return m_size; }
+
+		private:
+			static const size_t INITIAL_CAPACITY = 64;
+
+			class Slot {
+				public:
+					int32_t requestID; // 0 - wolny
+					SocketRequestRoute route;
+
+					Slot() : requestID(0) { }
+			};
+
+			std::vector<Slot> m_slots;
+			size_t m_mask;
+			size_t m_size;
+
+			size_t findSlot(int32_t requestID) const;
+			void eraseSlot(size_t idx);
+			void grow();
+	};
+
+
 	class Socket: public stdext::object {
 		public:
+			// wolany po odebraniu pakietu, pakiety czekaja w kolejce na read()
+			typedef std::function<void()> PacketCallback;
+
 			Socket(const io::InetEndpoint& spec);
 			virtual ~Socket();
 
 			bool send(const io::InetEndpoint& to, const io::DataBuffer& buf);
 			bool read(io::DataBuffer& out);
 			bool read(io::InetEndpoint& source, io::DataBuffer& out);
+			bool read(io::InetEndpoint& source, io::DataBuffer& out, ticks_t& receiveTime);
 
 			bool inactive() const;
 			void close();
 
+			// przeniesienie deskryptora do petli innego watku (nullptr - wypiecie ze starej)
+			void rebind(io::IO* io);
+
+			void onPacket(const PacketCallback& func) { m_packetCallback = func; }
+
+			/**
+			 * RequestID zapytan wysylanych z tego socketu - unikalne w obrebie socketu,
+			 * niezaleznie od liczby klientow (targetow), ktore z niego korzystaja.
+			 * Odpowiedz trafia po nim do klienta, ktory wyslal zapytanie.
+			 * Uzywane tylko w petli, w ktorej jest socket.
+			 */
+			int32_t registerRequest(Client* client, int32_t handle);
+			void unregisterRequest(int32_t requestID);
+			void unregisterClient(Client* client);
+			const SocketRequestRoute* findRequest(int32_t requestID) const;
+
 			void onRead(io::FileDescriptorPtr fd);
 			void onWrite(io::FileDescriptorPtr fd);
 
@@ -68,18 +139,29 @@ namespace application { namespace snmp {
 			io::FileDescriptorPtr m_socket;
 			io::InetEndpoint m_endpoint;
 			ticks_t m_lastUseTime;
+			PacketCallback m_packetCallback;
+
+			SocketRequestTable m_requests;
+			int32_t m_nextRequestID;
 
 			class SocketReadEntry {
 				public:
 					io::InetEndpoint from;
 					io::DataBuffer buf;
+					ticks_t time; // w mikrosekundach
 
-					SocketReadEntry() { }
-					SocketReadEntry(const io::InetEndpoint& from, const io::DataBuffer& buf) : from(from), buf(buf) { }
+					SocketReadEntry() : time(0) { }
+					SocketReadEntry(const io::InetEndpoint& from, const io::DataBuffer& buf, ticks_t time) : from(from), buf(buf), time(time) { }
 			};
 
 			std::list<SocketSendRequest> m_toSend;
 			std::list<SocketReadEntry> m_recvVec;
+
+			// zwolnione wpisy (razem z buforami) - przenoszone przez splice, bez alokacji
+			std::list<SocketSendRequest> m_sendFree;
+			std::list<SocketReadEntry> m_recvFree;
+
+			void popRead();
 	};
 
 
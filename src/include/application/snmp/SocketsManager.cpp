@@ -47,67 +47,107 @@ namespace application { namespace snmp {
 	}
 
 	// ************************************************************************************
-	SocketPtr SocketsManager::ensureClientSocket(const io::InetEndpoint& endpoint, ClientPtr client) {
-		for(auto& e: m_sockets) {
-			if (e.endpoint == endpoint) {
-				e.clients.push_back(client);
-				return e.socket;
-			}
+	SocketsManager::Entry& SocketsManager::ensureEntry(const io::InetEndpoint& endpoint) {
+		auto it = m_sockets.find(endpoint);
+		if (it != m_sockets.end()) {
+			return it->second;
 		}
 
-		Entry e;
+		// wpisy unordered_map nie zmieniaja adresu, wiec callback moze trzymac referencje
+		Entry& e = m_sockets[endpoint];
 		e.endpoint = endpoint;
 		e.socket.reset(new Socket(endpoint));
-		e.clients.push_back(client);
-		m_sockets.push_back(e);
+		bindEntry(e);
+		return e;
+	}
 
+	// ************************************************************************************
+	void SocketsManager::bindEntry(Entry& e) {
+		e.socket->onPacket([this, &e](){ onPacket(e); });
+	}
+
+	// ************************************************************************************
+	SocketPtr SocketsManager::ensureClientSocket(const io::InetEndpoint& endpoint, ClientPtr client) {
+		Entry& e = ensureEntry(endpoint);
+		e.clients.push_back(client);
 		return e.socket;
 	}
 
 	// ************************************************************************************
 	SocketPtr SocketsManager::ensureServerSocket(const io::InetEndpoint& endpoint, ProxyServerPtr server) {
-		for(auto& e: m_sockets) {
-			if (e.endpoint == endpoint) {
-				e.servers.push_back(server);
-				return e.socket;
+		Entry& e = ensureEntry(endpoint);
+
+		for(auto& community: server->getCommunities()) {
+			if (!e.servers.emplace(community, server).second) {
+				g_logger.warning(stdext::format("[SocketsManager::ensureServerSocket] Community '%s' on %s is already served by another proxy", community, endpoint.toString()));
 			}
 		}
 
-		Entry e;
+		return e.socket;
+	}
+
+	// ************************************************************************************
+	bool SocketsManager::releaseClientSocket(const io::InetEndpoint& endpoint, SocketPtr& socket, std::vector<ClientPtr>& clients) {
+		auto it = m_sockets.find(endpoint);
+		if (it == m_sockets.end()) return false;
+		if (!it->second.servers.empty()) return false;
+
+		socket = it->second.socket;
+		clients = it->second.clients;
+
+		socket->onPacket(Socket::PacketCallback());
+		socket->rebind(nullptr);
+		m_sockets.erase(it);
+		return true;
+	}
+
+	// ************************************************************************************
+	void SocketsManager::adoptClientSocket(const io::InetEndpoint& endpoint, const SocketPtr& socket, const std::vector<ClientPtr>& clients, io::IO& io) {
+		Entry& e = m_sockets[endpoint];
 		e.endpoint = endpoint;
-		e.socket.reset(new Socket(endpoint));
-		e.servers.push_back(server);
-		m_sockets.push_back(e);
+		e.socket = socket;
+		e.clients = clients;
 
-		return e.socket;
+		socket->rebind(&io);
+		bindEntry(e);
 	}
 
 	// ************************************************************************************
-	void SocketsManager::poll() {
-		io::DataBuffer buf;
+	void SocketsManager::shutdown() {
+		for(auto& it: m_sockets) {
+			it.second.socket->onPacket(Socket::PacketCallback());
+			it.second.socket->close();
+		}
+		m_sockets.clear();
+	}
 
-		for(auto& e: m_sockets) {
-			buf.clear();
-			io::InetEndpoint from;
+	// ************************************************************************************
+	void SocketsManager::onPacket(Entry& e) {
+		m_readBuffer.clear();
+		ticks_t receiveTime = 0;
 
-			while(e.socket->read(from, buf)) {
-				e.handleMessage(from, buf);
-			}
+		while(e.socket->read(m_readSource, m_readBuffer, receiveTime)) {
+			e.handleMessage(m_readSource, m_readBuffer, m_message, receiveTime);
 		}
 	}
 
 	// ************************************************************************************
-	bool SocketsManager::Entry::handleMessage(const io::InetEndpoint& source, const io::DataBuffer& buf) {
+	static std::string formatHexDump(const io::DataBuffer& buf) {
+		std::stringstream ss;
+		ss << "Readed data" << std::endl;
+		buf.dumpHex(ss, 16);
+		return ss.str();
+	}
+
+	// ************************************************************************************
+	bool SocketsManager::Entry::handleMessage(const io::InetEndpoint& source, const io::DataBuffer& buf, Value& message, ticks_t receiveTime) {
 		io::DataBufferInputStream is(buf);
 
 		bool errorFlag = false;
-		auto message = SNMPInputStreamAdapter::read(is, errorFlag);
+		SNMPInputStreamAdapter::read(is, message, errorFlag);
 
 		if (errorFlag) {
-			std::stringstream ss;
-			ss << "Readed data" << std::endl;
-			buf.dumpHex(ss, 16);
-			g_logger.debug(ss.str());
+			LOG_DEBUG_LIMITED(formatHexDump(buf));
 			return true;
 		}
 
@@ -130,28 +170,33 @@ namespace application { namespace snmp {
 		*/
 
 
-		bool handled = false;
+		// odpowiedzi - do klienta, ktory wyslal request (requestID jest unikalny w obrebie socketu)
+		auto& pdu = message[2];
+		if (pdu.type() == ValueType::PDU_RESPONSE) {
+			if (pdu.size() != 4) return false;
 
-		// no to teraz paczymy, czy moze to jest od servera czy klienta
-		if (!handled) {
-			for(auto& e: clients) {
-				if (e->handleMessage(source, message)) {
-					handled = true;
-					break;
-				}
+			const SocketRequestRoute* route = socket->findRequest(pdu[0].valueInt());
+			if (route == nullptr) {
+				// spozniona odpowiedz na request, ktory juz obsluzylismy (np. timeout), albo obca
+				LOG_DEBUG_LIMITED(stdext::format("[SocketsManager::Entry::handleMessage] Response from %s for unknown request #%d", source.toString(), pdu[0].valueInt()));
+				return false;
 			}
+			if (route->client->getDestEndpoint() != source) {
+				// requestID pasuje, ale odpowiedz przyszla od innego hosta niz ten, do ktorego wyslalismy zapytanie
+				LOG_DEBUG_LIMITED(stdext::format("[SocketsManager::Entry::handleMessage] Response for request #%d from %s, expected %s", pdu[0].valueInt(), source.toString(), route->client->getDestEndpoint().toString()));
+				return false;
+			}
+			return route->client->handleMessage(message, route->handle, receiveTime);
 		}
 
-		if (!handled) {
-			for(auto& e: servers) {
-				if (e->handleMessage(source, message)) {
-					handled = true;
-					break;
-				}
-			}
+		// zapytania - do serwera obslugujacego community
+		auto it = servers.find(message[1].valueString());
+		if (it == servers.end()) {
+			// nie obslugujemy tego community
+			return false;
 		}
 
-		return handled;
+		return it->second->handleMessage(source, message, receiveTime);
 	}
 
 
@@ -27,9 +27,11 @@
 #define INCLUDE_APPLICATION_SNMP_SOCKETSMANAGER_H_
 
 #include "base.h"
+#include "Value.h"
 
 #include <io/buffers.h>
 #include <io/InetEndpoint.h>
+#include <io/io.h>
 
 namespace application { namespace snmp {
 
@@ -41,7 +43,14 @@ namespace application { namespace snmp {
 			SocketPtr ensureClientSocket(const io::InetEndpoint& endpoint, ClientPtr client);
 			SocketPtr ensureServerSocket(const io::InetEndpoint& endpoint, ProxyServerPtr server);
 
-			void poll();
+			// przekazanie socketu klientow do innego managera (UpstreamPool) - socket jest
+			// wypinany z petli, razem z nim przechodza requestID wyslanych zapytan.
+			// Socket wspoldzielony z serwerem nie moze byc oddany
+			bool releaseClientSocket(const io::InetEndpoint& endpoint, SocketPtr& socket, std::vector<ClientPtr>& clients);
+			void adoptClientSocket(const io::InetEndpoint& endpoint, const SocketPtr& socket, const std::vector<ClientPtr>& clients, io::IO& io);
+
+			// zamyka sockety i zwalnia klientow/serwery - przed zniszczeniem g_io
+			void shutdown();
 
 		private:
 
@@ -49,13 +58,25 @@ namespace application { namespace snmp {
 			public:
 				SocketPtr socket;
 				io::InetEndpoint endpoint;
+
+				// odpowiedzi sa kierowane przez Socket::findRequest
 				std::vector<ClientPtr> clients;
-				std::vector<ProxyServerPtr> servers;
+				// community -> serwer, ktory je obsluguje
+				std::unordered_map<std::string, ProxyServerPtr> servers;
 
-				bool handleMessage(const io::InetEndpoint& source, const io::DataBuffer& buf);
+				bool handleMessage(const io::InetEndpoint& source, const io::DataBuffer& buf, Value& message, ticks_t receiveTime);
 			};
 
-			std::vector<Entry> m_sockets;
+			std::unordered_map<io::InetEndpoint, Entry> m_sockets;
+
+			Entry& ensureEntry(const io::InetEndpoint& endpoint);
+			void bindEntry(Entry& e);
+			void onPacket(Entry& e);
+
+			// odebrany pakiet i jego zdekodowana postac, uzywane ponownie dla kolejnych pakietow
+			io::DataBuffer m_readBuffer;
+			io::InetEndpoint m_readSource;
+			Value m_message;
 	};
 
 } }
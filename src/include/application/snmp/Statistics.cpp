@@ -0,0 +1,279 @@
+/*
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @author: pregusia
+ * @part-of: preg-snmp-proxy
+ *
+ */
+
+#include "Statistics.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace application { namespace snmp {
+
+// ##############################################################################################################################
+// StatOperation
+// ##############################################################################################################################
+
+	// ************************************************************************************
+	const char* StatOperation::name(Enum e) {
+		switch(e) {
+			case GET: return "get";
+			case GET_NEXT: return "get-next";
+			case GET_BULK: return "get-bulk";
+			case SET: return "set";
+			default: return "unknown";
+		}
+	}
+
+
+
+// ##############################################################################################################################
+// StatOIDTable
+// ##############################################################################################################################
+
+	// ************************************************************************************
+	StatOIDTable::StatOIDTable(int32_t capacity) {
+		// pojemnosc zaokraglona w gore do potegi dwojki
+		m_capacity = 16;
+		while(m_capacity < capacity) m_capacity *= 2;
+		m_mask = m_capacity - 1;
+		m_slots.reset(new Slot[m_capacity]);
+	}
+
+	// ************************************************************************************
+	int32_t StatOIDTable::intern(const OID& oid) {
+		size_t hash = std::hash<OID>{}(oid);
+		int32_t idx = hash & m_mask;
+
+		for(int32_t probe=0;probe<MAX_PROBES && probe<m_capacity;++probe) {
+			Slot& slot = m_slots[idx];
+			uint32_t state = slot.state.load(std::memory_order_acquire);
+
+			if (state == SLOT_EMPTY) {
+				if (slot.state.compare_exchange_strong(state, SLOT_WRITING, std::memory_order_acquire)) {
+					slot.hash = hash;
+					slot.oid = oid;
+					slot.state.store(SLOT_READY, std::memory_order_release);
+					return idx;
+				}
+			}
+
+			// ktos inny wlasnie wpisuje - czekamy, to moze byc ten sam OID
+			while(state == SLOT_WRITING) {
+				state = slot.state.load(std::memory_order_acquire);
+			}
+
+			if (slot.hash == hash && slot.oid == oid) return idx;
+			idx = (idx + 1) & m_mask;
+		}
+
+		return overflowHandle();
+	}
+
+	// ************************************************************************************
+	bool StatOIDTable::isUsed(int32_t handle) const {
+		if (handle < 0 || handle >= m_capacity) return false;
+		return m_slots[handle].state.load(std::memory_order_acquire) == SLOT_READY;
+	}
+
+
+
+// ##############################################################################################################################
+// StatCounters
+// ##############################################################################################################################
+
+	// ************************************************************************************
+	StatCounters::StatCounters(int32_t capacity) : m_table(capacity) {
+		int32_t num = size() * StatOperation::COUNT;
+		m_counters.reset(new std::atomic<uint64_t>[num]);
+		for(int32_t i=0;i<num;++i) {
+			m_counters[i].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	// ************************************************************************************
+	void StatCounters::tick(const OID& oid, StatOperation::Enum op) {
+		int32_t handle = m_table.intern(oid);
+		m_counters[handle * StatOperation::COUNT + op].fetch_add(1, std::memory_order_relaxed);
+	}
+
+
+
+// ##############################################################################################################################
+// LatencyHistogram
+// ##############################################################################################################################
+
+	// ************************************************************************************
+	LatencyHistogram::LatencyHistogram() {
+		for(int32_t i=0;i<BUCKETS;++i) {
+			m_buckets[i].store(0, std::memory_order_relaxed);
+		}
+		m_sum.store(0, std::memory_order_relaxed);
+	}
+
+	// ************************************************************************************
+	int32_t LatencyHistogram::bucketIndex(uint64_t value) {
+		if (value < static_cast<uint64_t>(SUB_COUNT)) return value;
+
+		int32_t exponent = 63 - __builtin_clzll(value);
+		if (exponent > MAX_EXPONENT) return BUCKETS - 1;
+
+		int32_t sub = (value >> (exponent - SUB_BITS)) & (SUB_COUNT - 1);
+		return (exponent - SUB_BITS + 1) * SUB_COUNT + sub;
+	}
+
+	// ************************************************************************************
+	ticks_t LatencyHistogram::bucketValue(int32_t idx) {
+		if (idx < SUB_COUNT) return idx;
+
+		// gorna granica kubelka
+		int32_t exponent = idx / SUB_COUNT + SUB_BITS - 1;
+		int32_t sub = idx % SUB_COUNT;
+		ticks_t low = static_cast<ticks_t>(SUB_COUNT + sub) << (exponent - SUB_BITS);
+		return low + (static_cast<ticks_t>(1) << (exponent - SUB_BITS)) - 1;
+	}
+
+	// ************************************************************************************
+	void LatencyHistogram::record(ticks_t micros) {
+		if (micros < 0) micros = 0;
+		m_buckets[bucketIndex(micros)].fetch_add(1, std::memory_order_relaxed);
+		m_sum.fetch_add(micros, std::memory_order_relaxed);
+	}
+
+	// ************************************************************************************
+	uint64_t LatencyHistogram::count() const {
+		uint64_t res = 0;
+		for(int32_t i=0;i<BUCKETS;++i) {
+			res += m_buckets[i].load(std::memory_order_relaxed);
+		}
+		return res;
+	}
+
+	// ************************************************************************************
+	ticks_t LatencyHistogram::percentile(float p) const {
+		uint64_t counts[BUCKETS];
+		uint64_t total = 0;
+		for(int32_t i=0;i<BUCKETS;++i) {
+			counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+			total += counts[i];
+		}
+		if (total == 0) return 0;
+
+		uint64_t rank = static_cast<uint64_t>(std::ceil(p * total));
+		if (rank < 1) rank = 1;
+
+		uint64_t sum = 0;
+		for(int32_t i=0;i<BUCKETS;++i) {
+			sum += counts[i];
+			if (sum >= rank) return bucketValue(i);
+		}
+		return bucketValue(BUCKETS - 1);
+	}
+
+
+// ##############################################################################################################################
+// HeavyHitters
+// ##############################################################################################################################
+
+	// ************************************************************************************
+	HeavyHitters::HeavyHitters(int32_t capacity) {
+		m_capacity = std::max(1, capacity);
+		m_heap.reserve(m_capacity);
+		m_index.reserve(m_capacity);
+	}
+
+	// ************************************************************************************
+	void HeavyHitters::tick(const OID& key) {
+		auto it = m_index.find(key);
+		if (it != m_index.end()) {
+			m_heap[it->second].count += 1;
+			siftDown(it->second);
+			return;
+		}
+
+		if (static_cast<int32_t>(m_heap.size()) < m_capacity) {
+			Counter c;
+			c.key = key;
+			c.count = 1;
+			c.error = 0;
+			m_heap.push_back(c);
+			m_index[key] = m_heap.size() - 1;
+			siftUp(m_heap.size() - 1);
+			return;
+		}
+
+		// najmniejszy licznik przechodzi na nowy klucz
+		Counter& min = m_heap[0];
+		m_index.erase(min.key);
+		min.key = key;
+		min.error = min.count;
+		min.count += 1;
+		m_index[key] = 0;
+		siftDown(0);
+	}
+
+	// ************************************************************************************
+	void HeavyHitters::clear() {
+		m_heap.clear();
+		m_index.clear();
+	}
+
+	// ************************************************************************************
+	void HeavyHitters::top(std::vector<Counter>& out) const {
+		out = m_heap;
+		std::sort(out.begin(), out.end(), [](const Counter& a, const Counter& b){ return a.guaranteed() > b.guaranteed(); });
+	}
+
+	// ************************************************************************************
+	void HeavyHitters::siftUp(int32_t pos) {
+		while(pos > 0) {
+			int32_t parent = (pos - 1) / 2;
+			if (m_heap[parent].count <= m_heap[pos].count) break;
+			swapCounters(parent, pos);
+			pos = parent;
+		}
+	}
+
+	// ************************************************************************************
+	void HeavyHitters::siftDown(int32_t pos) {
+		int32_t size = m_heap.size();
+		while(true) {
+			int32_t smallest = pos;
+			int32_t left = pos * 2 + 1;
+			int32_t right = left + 1;
+			if (left < size && m_heap[left].count < m_heap[smallest].count) smallest = left;
+			if (right < size && m_heap[right].count < m_heap[smallest].count) smallest = right;
+			if (smallest == pos) break;
+			swapCounters(smallest, pos);
+			pos = smallest;
+		}
+	}
+
+	// ************************************************************************************
+	void HeavyHitters::swapCounters(int32_t a, int32_t b) {
+		std::swap(m_heap[a], m_heap[b]);
+		m_index[m_heap[a].key] = a;
+		m_index[m_heap[b].key] = b;
+	}
+
+} }
@@ -0,0 +1,185 @@
+/*
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @author: pregusia
+ * @part-of: preg-snmp-proxy
+ *
+ */
+
+#ifndef INCLUDE_APPLICATION_SNMP_STATISTICS_H_
+#define INCLUDE_APPLICATION_SNMP_STATISTICS_H_
+
+#include "base.h"
+#include "Value.h"
+
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+
+namespace application { namespace snmp {
+
+	class StatOperation {
+		public:
+
+			ENUM_DEFINE_INCLS(
+				GET = 0,
+				GET_NEXT = 1,
+				GET_BULK = 2,
+				SET = 3,
+			);
+
+			static const int32_t COUNT = 4;
+
+			static const char* name(Enum e);
+
+		private:
+			StatOperation() { }
+	};
+
+	/**
+	 * Tablica OID-ow o stalej pojemnosci (adresowanie otwarte).
+	 * Wstawianie i szukanie sa bezpieczne z wielu watkow, trafienie niczego nie alokuje.
+	 * Jak tablica sie zapelni (albo sciezka szukania jest za dluga) to zwracany jest uchwyt
+	 * OVERFLOW - wspolny dla wszystkich pozostalych OID-ow.
+	 */
+	class StatOIDTable {
+		public:
+			StatOIDTable(int32_t capacity);
+
+			int32_t capacity() const { return m_capacity; }
+			int32_t overflowHandle() const { return m_capacity; }
+
+			int32_t intern(const OID& oid);
+
+			bool isUsed(int32_t handle) const;
+			const OID& oid(int32_t handle) const { return m_slots[handle].oid; }
+
+		private:
+			static const uint32_t SLOT_EMPTY = 0;
+			static const uint32_t SLOT_WRITING = 1;
+			static const uint32_t SLOT_READY = 2;
+			static const int32_t MAX_PROBES = 64;
+
+			class Slot {
+				public:
+					std::atomic<uint32_t> state;
+					size_t hash;
+					OID oid;
+
+					Slot() : state(SLOT_EMPTY), hash(0) { }
+			};
+
+			int32_t m_capacity;
+			int32_t m_mask;
+			std::unique_ptr<Slot[]> m_slots;
+	};
+
+	/**
+	 * Liczniki zapytan per (OID, operacja).
+	 * tick() to tylko wyszukanie uchwytu i atomowy inkrement.
+	 */
+	class StatCounters {
+		public:
+			StatCounters(int32_t capacity);
+
+			void tick(const OID& oid, StatOperation::Enum op);
+
+			int32_t size() const { return m_table.capacity() + 1; }
+			bool isUsed(int32_t handle) const { return handle == m_table.overflowHandle() || m_table.isUsed(handle); }
+			bool isOverflow(int32_t handle) const { return handle == m_table.overflowHandle(); }
+			const OID& oid(int32_t handle) const { return m_table.oid(handle); }
+			uint64_t count(int32_t handle, StatOperation::Enum op) const { return m_counters[handle * StatOperation::COUNT + op].load(std::memory_order_relaxed); }
+
+		private:
+			StatOIDTable m_table;
+			std::unique_ptr<std::atomic<uint64_t>[]> m_counters;
+	};
+
+	/**
+	 * Histogram czasow (w mikrosekundach) z kubelkami logarytmicznymi: 8 kubelkow na kazda
+	 * potege dwojki, czyli blad wzgledny ponizej 12.5%. Zapis to jeden atomowy inkrement.
+	 */
+	class LatencyHistogram {
+		public:
+			LatencyHistogram();
+
+			void record(ticks_t micros);
+
+			uint64_t count() const;
+			uint64_t sum() const { return m_sum.load(std::memory_order_relaxed); }
+			ticks_t percentile(float p) const;
+
+			static const int32_t SUB_BITS = 3;
+			static const int32_t SUB_COUNT = 1 << SUB_BITS;
+			static const int32_t MAX_EXPONENT = 39; // ~6 dni
+			static const int32_t BUCKETS = (MAX_EXPONENT - SUB_BITS + 2) * SUB_COUNT;
+
+			uint64_t bucketCount(int32_t idx) const { return m_buckets[idx].load(std::memory_order_relaxed); }
+			static ticks_t bucketValue(int32_t idx);
+
+		private:
+			std::atomic<uint64_t> m_buckets[BUCKETS];
+			std::atomic<uint64_t> m_sum;
+
+			static int32_t bucketIndex(uint64_t value);
+	};
+
+	/**
+	 * Najczestsze OID-y w strumieniu zapytan - algorytm Space-Saving. Stala liczba
+	 * licznikow, nowy klucz przejmuje najmniejszy z nich (count = min + 1, error = min).
+	 * Klucz wystepujacy czesciej niz raz na capacity zapytan na pewno ma licznik,
+	 * a count - error to dolne oszacowanie liczby jego wystapien.
+	 * Liczniki sa w kopcu (minimum na szczycie), tick() to O(log capacity).
+	 */
+	class HeavyHitters {
+		public:
+			class Counter {
+				public:
+					OID key;
+					uint64_t count;
+					uint64_t error;
+
+					uint64_t guaranteed() const { return count - error; }
+			};
+
+			HeavyHitters(int32_t capacity);
+
+			int32_t capacity() const { return m_capacity; }
+			int32_t size() const { return m_heap.size(); }
+
+			void tick(const OID& key);
+			void clear();
+
+			// liczniki malejaco po dolnym oszacowaniu
+			void top(std::vector<Counter>& out) const;
+
+		private:
+			int32_t m_capacity;
+			std::vector<Counter> m_heap;
+			std::unordered_map<OID, int32_t> m_index;
+
+			void siftUp(int32_t pos);
+			void siftDown(int32_t pos);
+			void swapCounters(int32_t a, int32_t b);
+	};
+
+} }
+
+#endif /* INCLUDE_APPLICATION_SNMP_STATISTICS_H_ */
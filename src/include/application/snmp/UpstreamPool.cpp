@@ -0,0 +1,375 @@
+/*
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @author: pregusia
+ * @part-of: preg-snmp-proxy
+ *
+ */
+
+#include "UpstreamPool.h"
+#include "Client.h"
+#include "Socket.h"
+
+#include <cstring>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include <application/config/parser/ConfigEntry.h>
+
+application::snmp::UpstreamPool g_upstreamPool;
+
+namespace application { namespace snmp {
+
+// ##############################################################################################################################
+// UpstreamGroup
+// ##############################################################################################################################
+
+	// ************************************************************************************
+	UpstreamGroup::UpstreamGroup() {
+		worker = 0;
+		lastSentCount = 0;
+		load = 0;
+	}
+
+	// ************************************************************************************
+	UpstreamGroup::~UpstreamGroup() {
+
+	}
+
+	// ************************************************************************************
+	uint64_t UpstreamGroup::getSentCount() const {
+		uint64_t res = 0;
+		for(auto& c: clients) {
+			res += c->getSentCount();
+		}
+		return res;
+	}
+
+	// ************************************************************************************
+	bool UpstreamGroup::isIdle() const {
+		for(auto& c: clients) {
+			if (!c->isIdle()) return false;
+		}
+		return true;
+	}
+
+
+// ##############################################################################################################################
+// UpstreamWorker
+// ##############################################################################################################################
+
+	// ************************************************************************************
+	UpstreamWorker::UpstreamWorker(int32_t index) {
+		m_index = index;
+		m_running = false;
+		m_releaseTarget = nullptr;
+	}
+
+	// ************************************************************************************
+	UpstreamWorker::~UpstreamWorker() {
+		stop();
+		shutdown();
+	}
+
+	// ************************************************************************************
+	void UpstreamWorker::start() {
+		// deskryptor rejestrowany w IO workera jeszcze przed startem watku
+		m_wakeupFd = io::FileDescriptor::Adapt(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC), m_io);
+		if (!m_wakeupFd) {
+			g_logger.fatal(stdext::format("[UpstreamWorker::start] Could not create eventfd - %s", strerror(errno)));
+		}
+		m_wakeupFd->onReadReady([this](io::FileDescriptorPtr fd){ onWakeup(fd); });
+		m_dispatcher.setWakeupFd(m_wakeupFd->fd());
+
+		m_running = true;
+		m_thread = std::thread(&UpstreamWorker::run, this);
+	}
+
+	// ************************************************************************************
+	void UpstreamWorker::stop() {
+		if (!m_thread.joinable()) return;
+
+		m_running = false;
+		post([](){ });
+		m_thread.join();
+	}
+
+	// ************************************************************************************
+	void UpstreamWorker::shutdown() {
+		stopReleasing();
+		m_dispatcher.setWakeupFd(-1);
+		m_dispatcher.shutdown();
+		m_sockets.shutdown();
+		m_wakeupFd.reset();
+	}
+
+	// ************************************************************************************
+	void UpstreamWorker::run() {
+		while(m_running.load()) {
+			m_io.select(m_dispatcher.nextTimeout(MAX_WAIT));
+			m_dispatcher.poll(false);
+		}
+	}
+
+	// ************************************************************************************
+	void UpstreamWorker::onWakeup(io::FileDescriptorPtr fd) {
+		uint64_t counter = 0;
+		ssize_t res = ::read(fd->fd(), &counter, sizeof(counter));
+		(void)res;
+
+		fd->onReadReady([this](io::FileDescriptorPtr fd){ onWakeup(fd); });
+	}
+
+	// ************************************************************************************
+	void UpstreamWorker::adopt(const UpstreamGroupPtr& group) {
+		m_sockets.adoptClientSocket(group->endpoint, group->socket, group->clients, m_io);
+	}
+
+	// ************************************************************************************
+	void UpstreamWorker::release(const UpstreamGroupPtr& group, UpstreamWorker* target) {
+		m_releasing = group;
+		m_releaseTarget = target;
+
+		// klient po obsluzeniu ostatniego requestu zglasza sie ponownie - sprawdzenie
+		// odlozone za obsluge socketu, bo ten jest wtedy jeszcze czytany
+		for(auto& c: group->clients) {
+			c->setIdleCallback([this](){ m_dispatcher.post([this](){ tryRelease(); }); });
+		}
+		m_releaseTimeout = m_dispatcher.scheduleEvent([this](){
+			UpstreamGroupPtr group = m_releasing;
+			stopReleasing();
+			g_dispatcher.pushEventSynchronized([group](){ g_upstreamPool.onMoved(group, -1); });
+		}, RELEASE_TIMEOUT);
+
+		tryRelease();
+	}
+
+	// ************************************************************************************
+	void UpstreamWorker::tryRelease() {
+		if (!m_releasing || !m_releasing->isIdle()) return;
+
+		UpstreamGroupPtr group = m_releasing;
+		UpstreamWorker* target = m_releaseTarget;
+		stopReleasing();
+
+		SocketPtr socket;
+		std::vector<ClientPtr> clients;
+		m_sockets.releaseClientSocket(group->endpoint, socket, clients);
+
+		// przejecie socketu trafia do kolejki nowego watku przed jakimkolwiek zadaniem
+		// dla klientow - te sa kierowane tam dopiero po zmianie petli w moveTo()
+		target->post([target, group](){ target->adopt(group); });
+		for(auto& c: group->clients) {
+			c->moveTo(target->getDispatcher());
+		}
+
+		int32_t index = target->getIndex();
+		g_dispatcher.pushEventSynchronized([group, index](){ g_upstreamPool.onMoved(group, index); });
+	}
+
+	// ************************************************************************************
+	void UpstreamWorker::stopReleasing() {
+		if (m_releasing) {
+			for(auto& c: m_releasing->clients) {
+				c->setIdleCallback(nullptr);
+			}
+		}
+		if (m_releaseTimeout) {
+			m_releaseTimeout->cancel();
+			m_releaseTimeout.reset();
+		}
+		m_releasing.reset();
+		m_releaseTarget = nullptr;
+	}
+
+
+// ##############################################################################################################################
+// UpstreamPool
+// ##############################################################################################################################
+
+	// ************************************************************************************
+	UpstreamPool::UpstreamPool() {
+		m_threadsCount = 0;
+		m_rebalanceInterval = 10;
+		m_moving = false;
+	}
+
+	// ************************************************************************************
+	UpstreamPool::~UpstreamPool() {
+		clear();
+	}
+
+	// ************************************************************************************
+	bool UpstreamPool::loadFromConfig(const config::parser::ConfigEntriesCollection& entries) {
+		for(auto& e: entries) {
+			if (e->name() == "threads" && e->hasValueInt(0)) {
+				m_threadsCount = e->valueInt(0);
+				continue;
+			}
+			if (e->name() == "rebalance-interval" && e->hasValueInt(0)) {
+				m_rebalanceInterval = e->valueInt(0);
+				continue;
+			}
+
+			g_logger.warning(stdext::format("[UpstreamPool::loadFromConfig] Unknown config entry '%s'", e->name()));
+		}
+
+		if (m_threadsCount < 0) {
+			g_logger.warning("[UpstreamPool::loadFromConfig] Invalid threads");
+			return false;
+		}
+		if (m_rebalanceInterval < 0) {
+			g_logger.warning("[UpstreamPool::loadFromConfig] Invalid rebalance-interval");
+			return false;
+		}
+
+		return true;
+	}
+
+	// ************************************************************************************
+	void UpstreamPool::start(const std::vector<ClientPtr>& clients) {
+		if (!enabled()) return;
+
+		for(int32_t i=0;i<m_threadsCount;++i) {
+			m_workers.push_back(std::unique_ptr<UpstreamWorker>(new UpstreamWorker(i)));
+		}
+
+		for(auto& client: clients) {
+			const io::InetEndpoint& endpoint = client->getSourceEndpoint();
+
+			bool known = false;
+			for(auto& g: m_groups) {
+				if (g->endpoint == endpoint) known = true;
+			}
+			if (known) continue;
+
+			UpstreamGroupPtr group(new UpstreamGroup());
+			group->endpoint = endpoint;
+
+			if (!g_snmpSocketsManager.releaseClientSocket(endpoint, group->socket, group->clients)) {
+				// odpowiedzi i zapytania przychodza na ten sam socket - zostaje w watku glownym
+				g_logger.warning(stdext::format("[UpstreamPool::start] Target socket %s is shared with proxy socket, staying in main thread", endpoint.toString()));
+				continue;
+			}
+
+			group->worker = m_groups.size() % m_workers.size();
+			UpstreamWorker* worker = m_workers[group->worker].get();
+
+			for(auto& c: group->clients) {
+				c->setThreaded(worker->getDispatcher());
+			}
+			worker->post([worker, group](){ worker->adopt(group); });
+
+			m_groups.push_back(group);
+		}
+
+		for(auto& w: m_workers) {
+			w->start();
+		}
+
+		if (m_rebalanceInterval > 0 && m_workers.size() > 1 && m_groups.size() > 1) {
+			m_rebalanceEvent = g_dispatcher.cycleEvent([this](){ rebalance(); }, m_rebalanceInterval * 1000);
+		}
+
+		g_logger.info(stdext::format("[UpstreamPool::start] %d target sockets in %d threads", static_cast<int32_t>(m_groups.size()), m_threadsCount));
+	}
+
+	// ************************************************************************************
+	void UpstreamPool::rebalance() {
+		if (m_moving) return;
+
+		std::vector<uint64_t> loads(m_workers.size(), 0);
+		for(auto& g: m_groups) {
+			uint64_t sent = g->getSentCount();
+			g->load = sent - g->lastSentCount;
+			g->lastSentCount = sent;
+			loads[g->worker] += g->load;
+		}
+
+		size_t busiest = 0;
+		size_t idlest = 0;
+		for(size_t i=1;i<loads.size();++i) {
+			if (loads[i] > loads[busiest]) busiest = i;
+			if (loads[i] < loads[idlest]) idlest = i;
+		}
+
+		uint64_t diff = loads[busiest] - loads[idlest];
+		if (diff < MIN_IMBALANCE || diff * IMBALANCE_RATIO < loads[busiest]) return;
+
+		// grupa, po ktorej przeniesieniu obciazenia beda najblizej siebie
+		UpstreamGroupPtr best;
+		uint64_t bestDistance = diff;
+		for(auto& g: m_groups) {
+			if (g->worker != static_cast<int32_t>(busiest)) continue;
+			if (g->load == 0 || g->load >= diff) continue;
+
+			uint64_t distance = g->load * 2 > diff ? g->load * 2 - diff : diff - g->load * 2;
+			if (distance < bestDistance) {
+				bestDistance = distance;
+				best = g;
+			}
+		}
+		if (!best) return;
+
+		m_moving = true;
+		UpstreamWorker* from = m_workers[busiest].get();
+		UpstreamWorker* to = m_workers[idlest].get();
+		from->post([from, to, best](){ from->release(best, to); });
+	}
+
+	// ************************************************************************************
+	void UpstreamPool::onMoved(const UpstreamGroupPtr& group, int32_t worker) {
+		m_moving = false;
+
+		if (worker < 0) {
+			g_logger.info(stdext::format("[UpstreamPool::onMoved] Target socket %s is busy, not moved", group->endpoint.toString()));
+			return;
+		}
+
+		g_logger.info(stdext::format("[UpstreamPool::onMoved] Target socket %s moved from thread %d to %d (load %d)",
+			group->endpoint.toString(), group->worker, worker, static_cast<int32_t>(group->load)
+		));
+		group->worker = worker;
+	}
+
+	// ************************************************************************************
+	void UpstreamPool::stop() {
+		if (m_rebalanceEvent) {
+			m_rebalanceEvent->cancel();
+			m_rebalanceEvent.reset();
+		}
+
+		for(auto& w: m_workers) {
+			w->stop();
+		}
+		for(auto& w: m_workers) {
+			w->shutdown();
+		}
+	}
+
+	// ************************************************************************************
+	void UpstreamPool::clear() {
+		stop();
+		m_groups.clear();
+		m_workers.clear();
+	}
+
+} }
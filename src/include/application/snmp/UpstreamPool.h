@@ -0,0 +1,175 @@
+/*
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @author: pregusia
+ * @part-of: preg-snmp-proxy
+ *
+ */
+
+#ifndef INCLUDE_APPLICATION_SNMP_UPSTREAMPOOL_H_
+#define INCLUDE_APPLICATION_SNMP_UPSTREAMPOOL_H_
+
+#include "base.h"
+#include "SocketsManager.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include <io/io.h>
+#include <io/FileDescriptor.h>
+#include <io/InetEndpoint.h>
+#include <core/eventdispatcher.h>
+
+namespace application { namespace snmp {
+
+	/**
+	 * Klienci wysylajacy z jednego socketu zrodlowego - najmniejsza jednostka,
+	 * ktora mozna przeniesc miedzy watkami (odpowiedzi przychodza na wspolny socket).
+	 * Pola ustawiane raz przy starcie puli, potem tylko czytane.
+	 */
+	class UpstreamGroup: public stdext::object {
+		public:
+			io::InetEndpoint endpoint;
+			SocketPtr socket;
+			std::vector<ClientPtr> clients;
+
+			// tylko w watku glownym
+			int32_t worker;
+			uint64_t lastSentCount;
+			uint64_t load;
+
+			UpstreamGroup();
+			virtual ~UpstreamGroup();
+
+			uint64_t getSentCount() const;
+			bool isIdle() const;
+	};
+	typedef stdext::object_ptr<UpstreamGroup> UpstreamGroupPtr;
+
+	/**
+	 * Watek z wlasna petla (IO, EventDispatcher, SocketsManager) obslugujacy
+	 * przydzielone grupy klientow. Z zewnatrz dostepny tylko przez post().
+	 */
+	class UpstreamWorker {
+		public:
+			UpstreamWorker(int32_t index);
+			~UpstreamWorker();
+
+			int32_t getIndex() const { return m_index; }
+			core::EventDispatcher* getDispatcher() { return &m_dispatcher; }
+
+			void start();
+			void stop();
+			// po stop() - zamyka sockety i zwalnia zdarzenia, w watku glownym
+			void shutdown();
+
+			// z dowolnego watku - wykonanie w watku workera
+			void post(core::EventDispatcher::SyncCallback&& func) { m_dispatcher.pushEventSynchronized(std::move(func)); }
+
+			// w watku workera
+			void adopt(const UpstreamGroupPtr& group);
+			void release(const UpstreamGroupPtr& group, UpstreamWorker* target);
+
+		private:
+			// najdluzsze czekanie w select (ms)
+			static const int32_t MAX_WAIT = 1000;
+			// grupa z requestami w locie czeka na bezczynnosc najwyzej RELEASE_TIMEOUT ms
+			static const int32_t RELEASE_TIMEOUT = 1000;
+
+			int32_t m_index;
+
+			// kolejnosc ma znaczenie - deskryptory musza zniknac przed m_io
+			io::IO m_io;
+			core::EventDispatcher m_dispatcher;
+			SocketsManager m_sockets;
+			io::FileDescriptorPtr m_wakeupFd;
+
+			std::thread m_thread;
+			std::atomic<bool> m_running;
+
+			// przenoszona grupa, czekajaca na koniec requestow w locie (tylko w watku workera)
+			UpstreamGroupPtr m_releasing;
+			UpstreamWorker* m_releaseTarget;
+			core::ScheduledEventPtr m_releaseTimeout;
+
+			void run();
+			void onWakeup(io::FileDescriptorPtr fd);
+			void tryRelease();
+			void stopReleasing();
+
+			UpstreamWorker(const UpstreamWorker& from);
+			UpstreamWorker& operator=(const UpstreamWorker& from);
+	};
+
+	/**
+	 * Pula watkow dla klientow (targetow). Kazdy watek ma wlasne sockety i timery,
+	 * wiec wolny target (np. duza aktualizacja cache'a) nie opoznia pozostalych.
+	 * ProxyServer przekazuje zapytania przez Client::inLoop(), odpowiedzi wracaja
+	 * do watku glownego przez g_dispatcher.pushEventSynchronized().
+	 *
+	 * Grupy sa przydzielane po kolei, a potem co rebalance-interval najmniej
+	 * obciazony watek przejmuje grupe od najbardziej obciazonego (obciazenie to
+	 * liczba wyslanych PDU w ostatnim okresie). Przenoszona jest tylko grupa bez
+	 * requestow w locie.
+	 */
+	class UpstreamPool {
+		public:
+			UpstreamPool();
+			~UpstreamPool();
+
+			bool loadFromConfig(const config::parser::ConfigEntriesCollection& entries);
+
+			bool enabled() const { return m_threadsCount > 0; }
+			int32_t getThreadsCount() const { return m_threadsCount; }
+
+			// w watku glownym, po zaladowaniu konfiguracji i przed startem petli
+			void start(const std::vector<ClientPtr>& clients);
+			// zatrzymuje watki i zamyka ich sockety
+			void stop();
+			// po zwolnieniu klientow przez aplikacje
+			void clear();
+
+		private:
+			// przeniesienie ma sens dopiero gdy roznica obciazen jest wieksza niz
+			// MIN_IMBALANCE PDU w okresie i niz 1/IMBALANCE_RATIO obciazenia najbardziej zajetego watku
+			static const uint64_t MIN_IMBALANCE = 100;
+			static const uint64_t IMBALANCE_RATIO = 4;
+
+			int32_t m_threadsCount;
+			int32_t m_rebalanceInterval;
+
+			std::vector<std::unique_ptr<UpstreamWorker>> m_workers;
+			std::vector<UpstreamGroupPtr> m_groups;
+
+			core::ScheduledEventPtr m_rebalanceEvent;
+			bool m_moving;
+
+			void rebalance();
+			void onMoved(const UpstreamGroupPtr& group, int32_t worker);
+
+			friend class UpstreamWorker;
+	};
+
+} }
+
+extern application::snmp::UpstreamPool g_upstreamPool;
+
+#endif /* INCLUDE_APPLICATION_SNMP_UPSTREAMPOOL_H_ */
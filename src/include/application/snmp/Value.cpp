@@ -33,7 +33,33 @@ namespace application { namespace snmp {
 	Value::Value() {
 		m_type = ValueType::NULL_;
 		m_valueInt = 0;
-		m_valueString = "null";
+	}
+
+	// ************************************************************************************
+	void Value::reset(ValueType::Enum type) {
+		m_type = type;
+		m_valueInt = 0;
+		m_valueString.clear();
+		m_valueOID.clear();
+
+		// elementy sekwencji zostaja (razem z ich pamiecia), wywolujacy ustawia rozmiar
+		if (type != ValueType::SEQUENCE && !ValueType::isPDU(type)) {
+			m_valueVec.clear();
+		}
+	}
+
+	// ************************************************************************************
+	void Value::setOID(const OID& oid) {
+		if (oid.empty()) {
+			reset(ValueType::NULL_);
+			return;
+		}
+
+		m_type = ValueType::OID;
+		m_valueInt = 0;
+		m_valueString.clear();
+		m_valueOID = oid;
+		m_valueVec.clear();
 	}
 
 	// ************************************************************************************
@@ -175,7 +201,6 @@ namespace application { namespace snmp {
 		Value res;
 		res.m_type = ValueType::INTEGER;
 		res.m_valueInt = v;
-		res.m_valueString = stdext::format("%ld", v);
 		return res;
 	}
 
@@ -184,7 +209,6 @@ namespace application { namespace snmp {
 		Value res;
 		res.m_type = ValueType::COUNTER32;
 		res.m_valueInt = v;
-		res.m_valueString = stdext::format("%ld", v);
 		return res;
 	}
 
@@ -193,7 +217,6 @@ namespace application { namespace snmp {
 		Value res;
 		res.m_type = ValueType::COUNTER64;
 		res.m_valueInt = v;
-		res.m_valueString = stdext::format("%ld", v);
 		return res;
 	}
 
@@ -201,7 +224,6 @@ namespace application { namespace snmp {
 	Value Value::createGauge32(int64_t v) {
 		Value res;
 		res.m_type = ValueType::GAUGE32;
-		res.m_valueString = stdext::format("%ld", v);
 		res.m_valueInt = v;
 		return res;
 	}
@@ -210,7 +232,6 @@ namespace application { namespace snmp {
 	Value Value::createTimeTicks(int64_t v) {
 		Value res;
 		res.m_type = ValueType::TIMETICKS;
-		res.m_valueString = stdext::format("%ld", v);
 		res.m_valueInt = v;
 		return res;
 	}
@@ -238,7 +259,6 @@ namespace application { namespace snmp {
 
 		Value res;
 		res.m_type = ValueType::OID;
-		res.m_valueString = oid.toString();
 		res.m_valueOID = oid;
 		return res;
 	}
@@ -262,7 +282,6 @@ namespace application { namespace snmp {
 		Value res;
 		res.m_type = type;
 		res.m_valueVec = vec;
-		res.m_valueString = "seq";
 		return res;
 	}
 
@@ -270,7 +289,6 @@ namespace application { namespace snmp {
 	Value Value::createSequence(ValueType::Enum type) {
 		Value res;
 		res.m_type = type;
-		res.m_valueString = "seq";
 		return res;
 	}
 
@@ -326,20 +344,11 @@ namespace application { namespace snmp {
 
 	// ************************************************************************************
 	bool OID::operator<(const OID& other) const {
-		// TODO: sprawdzic logike tego
-		for(size_t i=0;i<std::min(size(),other.size());++i) {
-			if (m_id[i] > other[i]) return false;
+		size_t num = std::min(size(), other.size());
+		for(size_t i=0;i<num;++i) {
+			if (m_id[i] != other.m_id[i]) return m_id[i] < other.m_id[i];
 		}
-		return size() <= other.size();
-	}
-
-	// ************************************************************************************
-	bool OID::operator>(const OID& other) const {
-		// TODO: sprawdzic logike tego
-		for(size_t i=0;i<std::min(size(),other.size());++i) {
-			if (m_id[i] < other[i]) return false;
-		}
-		return size() >= other.size();
+		return size() < other.size();
 	}
 
 
@@ -351,6 +360,16 @@ namespace application { namespace snmp {
 		return res;
 	}
 
+	// ************************************************************************************
+	void VarBinding::toValue(Value& out) const {
+		out.reset(ValueType::SEQUENCE);
+
+		auto& vec = out.valueVec();
+		vec.resize(2);
+		vec[0].setOID(name);
+		vec[1] = value;
+	}
+
 	// ************************************************************************************
 	std::vector<VarBinding> VarBinding::fromValue(const Value& value) {
 		std::vector<VarBinding> res;
@@ -370,14 +389,20 @@ namespace application { namespace snmp {
 	// ************************************************************************************
 	std::vector<VarBindingRef> VarBindingRef::fromValue(const Value& value) {
 		std::vector<VarBindingRef> res;
+		fromValue(value, res);
+		return res;
+	}
+
+	// ************************************************************************************
+	void VarBindingRef::fromValue(const Value& value, std::vector<VarBindingRef>& out) {
+		out.clear();
 		if (value.type() == ValueType::SEQUENCE) {
 			for(size_t i=0;i<value.size();++i) {
 				if (value[i].type() == ValueType::SEQUENCE && value[i].size() == 2) {
-					res.push_back(VarBindingRef(value[i][0].valueOID(), value[i][1]));
+					out.push_back(VarBindingRef(value[i][0].valueOID(), value[i][1]));
 				}
 			}
 		}
-		return res;
 	}
 
 
@@ -41,15 +41,19 @@ namespace application { namespace snmp {
 
 			int32_t operator[](int32_t idx) const { return m_id[idx]; }
 
+			void clear() { m_id.clear(); }
+			void append(int32_t v) { m_id.push_back(v); }
+
 			bool startsWith(const OID& other) const;
 			std::string toString() const;
 
 			bool operator==(const OID& other) const;
 			bool operator!=(const OID& other) const { return !(*this == other); }
+			// porzadek leksykograficzny (jak w przejsciu GET-NEXT)
 			bool operator<(const OID& other) const;
-			bool operator>(const OID& other) const;
-			bool operator<=(const OID& other) const { return *this == other || *this < other; }
-			bool operator>=(const OID& other) const { return *this == other || *this > other; }
+			bool operator>(const OID& other) const { return other < *this; }
+			bool operator<=(const OID& other) const { return !(other < *this); }
+			bool operator>=(const OID& other) const { return !(*this < other); }
 
 		private:
 			Int32Vector m_id;
@@ -63,6 +67,8 @@ namespace application { namespace snmp {
 			void setType(ValueType::Enum type) { m_type = type; }
 
 			bool isNull() const { return m_type == ValueType::NULL_; }
+			// noSuchObject, noSuchInstance, endOfMibView - varbinding bez wartosci
+			bool isException() const { return m_type == ValueType::NO_SUCH_OBJECT || m_type == ValueType::NO_SUCH_INSTANCE || m_type == ValueType::END_OF_MIB_VIEW; }
 			bool isSequence() const { return m_type == ValueType::SEQUENCE; }
 			bool isPDU() const { return ValueType::isPDU(m_type); }
 			bool isMessage() const { return isSequence() && size() == 3; }
@@ -78,6 +84,15 @@ namespace application { namespace snmp {
 
 			void addItem(const Value& val) { m_valueVec.push_back(val); }
 
+			// zapis w miejscu - dekodowanie i budowanie odpowiedzi bez tworzenia nowych
+			// obiektow, zaalokowana wczesniej pamiec napisow i wektorow jest uzywana ponownie
+			void reset(ValueType::Enum type);
+			void setInt(int64_t v) { m_valueInt = v; }
+			void setOID(const OID& oid);
+			std::string& valueString() { return m_valueString; }
+			OID& valueOID() { return m_valueOID; }
+			std::vector<Value>& valueVec() { return m_valueVec; }
+
 			std::string toString() const;
 			std::string toStringDeep() const;
 			void printDebug(int32_t indent) const;
@@ -111,12 +126,20 @@ namespace application { namespace snmp {
 			Value value;
 
 			Value toValue() const;
+			void toValue(Value& out) const;
 			static std::vector<VarBinding> fromValue(const Value& value);
 
 			bool operator<(const VarBinding& other) const { return name < other.name; }
 			bool operator>(const VarBinding& other) const { return name > other.name; }
 	};
 
+	// do wyszukiwania binarnego w posortowanych varbinding'ach
+	class VarBindingNameLess {
+		public:
+			bool operator()(const VarBinding& a, const OID& b) const { return a.name < b; }
+			bool operator()(const OID& a, const VarBinding& b) const { return a < b.name; }
+	};
+
 	class VarBindingRef {
 		public:
 			const OID& name;
@@ -130,6 +153,7 @@ namespace application { namespace snmp {
 				return res;
 			}
 			static std::vector<VarBindingRef> fromValue(const Value& value);
+			static void fromValue(const Value& value, std::vector<VarBindingRef>& out);
 	};
 
 } }
@@ -139,7 +163,12 @@ namespace std {
 	template<>
 	struct hash<application::snmp::OID> {
 		size_t operator()(const application::snmp::OID& p) const {
-			return std::hash<std::string>{}(p.toString());
+			// FNV-1a po kolejnych elementach
+			size_t h = 2166136261u;
+			for(size_t i=0;i<p.size();++i) {
+				h = (h ^ static_cast<uint32_t>(p[i])) * 16777619u;
+			}
+			return h;
 		}
 	};
 
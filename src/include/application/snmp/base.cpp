@@ -27,8 +27,6 @@
 #include "base.h"
 #include "Value.h"
 
-static int32_t g_snmpNextRequestID = 10;
-
 namespace application { namespace snmp {
 
 	// ************************************************************************************
@@ -58,13 +56,6 @@ namespace application { namespace snmp {
 		}
 	}
 
-	// ************************************************************************************
-	int32_t nextRequestID() {
-		int32_t next = ++g_snmpNextRequestID;
-		if (g_snmpNextRequestID > 0xFFFFFF) g_snmpNextRequestID = 1;
-		return next;
-	}
-
 	// ************************************************************************************
 	bool PDUUtils::copyMaintainingRequestID(Value& destMessage, const Value& sourceMessage) {
 		if (!sourceMessage.isMessage()) return false;
@@ -104,12 +95,14 @@ namespace application { namespace snmp {
 	bool PDUUtils::setVarBindings(Value& destMessage, const std::vector<VarBinding>& arr) {
 		if (!destMessage.isMessage()) return false;
 
-		Value seq = Value::createSequence();
-		for(auto& e: arr) {
-			seq.addItem(e.toValue());
-		}
+		// w miejscu - varbinding'i zapytania maja juz pamiec na nazwy i wartosci
+		Value& seq = destMessage[2][3];
+		seq.reset(ValueType::SEQUENCE);
+		seq.valueVec().resize(arr.size());
 
-		destMessage[2][3] = seq;
+		for(size_t i=0;i<arr.size();++i) {
+			arr[i].toValue(seq[i]);
+		}
 		return true;
 	}
 
@@ -117,14 +110,15 @@ namespace application { namespace snmp {
 	bool PDUUtils::setEndOfMIBView(Value& destMessage, const OID& oid) {
 		if (!destMessage.isMessage()) return false;
 
-		Value seq2 = Value::createSequence();
-		seq2.addItem(Value::createOID(oid));
-		seq2.addItem(Value::createEndOfMIBView());
-
-		Value seq1 = Value::createSequence();
-		seq1.addItem(seq2);
+		Value& seq = destMessage[2][3];
+		seq.reset(ValueType::SEQUENCE);
+		seq.valueVec().resize(1);
 
-		destMessage[2][3] = seq1;
+		Value& varBinding = seq[0];
+		varBinding.reset(ValueType::SEQUENCE);
+		varBinding.valueVec().resize(2);
+		varBinding[0].setOID(oid);
+		varBinding[1].reset(ValueType::END_OF_MIB_VIEW);
 		return true;
 	}
 
@@ -48,6 +48,9 @@ namespace application { namespace snmp {
 
 	class SocketsManager;
 
+	class MetricsServer;
+	typedef stdext::object_ptr<MetricsServer> MetricsServerPtr;
+
 	class ValueType {
 		public:
 
@@ -64,6 +67,8 @@ namespace application { namespace snmp {
 				TIMETICKS = 0x43,
 				COUNTER64 = 0x46,
 
+				NO_SUCH_OBJECT = 0x80,
+				NO_SUCH_INSTANCE = 0x81,
 				END_OF_MIB_VIEW = 0x82,
 
 				PDU_GET = 0xA0,
@@ -144,9 +149,6 @@ namespace application { namespace snmp {
 			PDUUtils() { }
 	};
 
-
-	int32_t nextRequestID();
-
 } }
 
 extern application::snmp::SocketsManager g_snmpSocketsManager;
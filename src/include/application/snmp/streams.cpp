@@ -44,7 +44,7 @@ namespace application { namespace snmp {
 			int32_t res = 0;
 
 			if (len > 4) {
-				g_logger.warning(stdext::format("[SNMPInputStreamAdapter::readHeaderLength] Overflow! len=%d", len));
+				LOG_WARNING_LIMITED(stdext::format("[SNMPInputStreamAdapter::readHeaderLength] Overflow! len=%d", len));
 				errorFlag = true;
 				return 0;
 			}
@@ -61,7 +61,7 @@ namespace application { namespace snmp {
 	// ************************************************************************************
 	int32_t SNMPInputStreamAdapter::readInt32(io::SeekableInputStream& is, int32_t len, bool& errorFlag) {
 		if (len > 5) {
-			g_logger.warning(stdext::format("[SNMPInputStreamAdapter::readInt32] Overflow! len=%d", len));
+			LOG_WARNING_LIMITED(stdext::format("[SNMPInputStreamAdapter::readInt32] Overflow! len=%d", len));
 			errorFlag = true;
 			return 0;
 		}
@@ -93,7 +93,7 @@ namespace application { namespace snmp {
 	// ************************************************************************************
 	uint32_t SNMPInputStreamAdapter::readUInt32(io::SeekableInputStream& is, int32_t len, bool& errorFlag) {
 		if (len > 5) {
-			g_logger.warning(stdext::format("[SNMPInputStreamAdapter::readUInt32] Overflow! len=%d", len));
+			LOG_WARNING_LIMITED(stdext::format("[SNMPInputStreamAdapter::readUInt32] Overflow! len=%d", len));
 			errorFlag = true;
 			return 0;
 		}
@@ -115,7 +115,7 @@ namespace application { namespace snmp {
 	// ************************************************************************************
 	uint64_t SNMPInputStreamAdapter::readUInt64(io::SeekableInputStream& is, int32_t len, bool& errorFlag) {
 		if (len > 9) {
-			g_logger.warning(stdext::format("[SNMPInputStreamAdapter::readUInt64] Overflow! len=%d", len));
+			LOG_WARNING_LIMITED(stdext::format("[SNMPInputStreamAdapter::readUInt64] Overflow! len=%d", len));
 			errorFlag = true;
 			return 0;
 		}
@@ -144,7 +144,7 @@ namespace application { namespace snmp {
 	// ************************************************************************************
 	uint32_t SNMPInputStreamAdapter::readIPAddress(io::SeekableInputStream& is, int32_t len, bool& errorFlag) {
 		if (len != 4) {
-			g_logger.warning(stdext::format("[SNMPInputStreamAdapter::readIPAddress] Invalid IPAddress len (%d)", len));
+			LOG_WARNING_LIMITED(stdext::format("[SNMPInputStreamAdapter::readIPAddress] Invalid IPAddress len (%d)", len));
 			errorFlag = true;
 			return 0;
 		}
@@ -153,18 +153,26 @@ namespace application { namespace snmp {
 	}
 
 	// ************************************************************************************
-	OID SNMPInputStreamAdapter::readOID(io::SeekableInputStream& is, int32_t len, bool& errorFlag) {
+	void SNMPInputStreamAdapter::readOID(io::SeekableInputStream& is, int32_t len, OID& out, bool& errorFlag) {
 		uint8_t buf[1024] = { 0 };
+		out.clear();
+
+		if (len > static_cast<int32_t>(sizeof(buf))) {
+			LOG_WARNING_LIMITED(stdext::format("[SNMPInputStreamAdapter::readOID] Overflow! len=%d", len));
+			is.read(nullptr, len);
+			errorFlag = true;
+			return;
+		}
+
 		is.read(buf, len);
 
 		int32_t offset = 0;
-		Int32Vector oid;
 
 		// pierwszy kodowany inaczej
 		if (true) {
 			uint8_t firstTwo = buf[offset++];
-			oid.push_back(firstTwo / 40);
-			oid.push_back(firstTwo % 40);
+			out.append(firstTwo / 40);
+			out.append(firstTwo % 40);
 		}
 
 		while(offset < len) {
@@ -177,83 +185,124 @@ namespace application { namespace snmp {
 				if ((b & 0x80) == 0x00) break;
 			}
 
-			oid.push_back(e);
+			out.append(e);
 		}
 
-		std::stringstream ss;
-		for(auto& e: oid) {
-			ss << "." << e;
+		// tak jak OID(const std::string&) - za krotki jest traktowany jako pusty
+		if (out.size() < 3) {
+			out.clear();
 		}
-		return OID(ss.str());
 	}
 
 	// ************************************************************************************
 	Value SNMPInputStreamAdapter::read(io::SeekableInputStream& is, bool& errorFlag) {
+		Value res;
+		read(is, res, errorFlag);
+		return res;
+	}
+
+	// ************************************************************************************
+	void SNMPInputStreamAdapter::read(io::SeekableInputStream& is, Value& out, bool& errorFlag) {
 		uint8_t type = is.readPrimitive<uint8_t>();
 		uint32_t len = readHeaderLength(is, errorFlag);
 
 		//g_logger.debug(stdext::format("[SNMPInputStreamAdapter::read] type=%02X len=%d", type, len));
 
+		if (type == ValueType::SEQUENCE || ValueType::isPDU((ValueType::Enum)type)) {
+			out.reset((ValueType::Enum)type);
+
+			auto& vec = out.valueVec();
+			size_t end = is.tell() + len;
+			size_t num = 0;
+
+			// przy bledzie (albo ucietym pakiecie) strumien stoi w miejscu, wiec trzeba przerwac
+			while(is.tell() < end && !errorFlag && !is.eof()) {
+				if (num == vec.size()) vec.emplace_back();
+				read(is, vec[num], errorFlag);
+				num += 1;
+			}
+
+			vec.resize(num);
+			return;
+		}
+
 		if (type == ValueType::NULL_) {
 			if (len > 0) {
 				is.read(nullptr, len);
 			}
-			return Value::createNull();
+			out.reset(ValueType::NULL_);
+			return;
 		}
 		if (type == ValueType::INTEGER) {
-			return Value::createInt(readInt32(is, len, errorFlag));
+			out.reset(ValueType::INTEGER);
+			out.setInt(readInt32(is, len, errorFlag));
+			return;
 		}
 		if (type == ValueType::COUNTER32) {
-			return Value::createCounter32(readUInt32(is, len, errorFlag));
+			out.reset(ValueType::COUNTER32);
+			out.setInt(readUInt32(is, len, errorFlag));
+			return;
 		}
 		if (type == ValueType::COUNTER64) {
-			return Value::createCounter64(readUInt64(is, len, errorFlag));
+			out.reset(ValueType::COUNTER64);
+			out.setInt(readUInt64(is, len, errorFlag));
+			return;
 		}
 		if (type == ValueType::GAUGE32) {
-			return Value::createGauge32(readUInt32(is, len, errorFlag));
+			out.reset(ValueType::GAUGE32);
+			out.setInt(readUInt32(is, len, errorFlag));
+			return;
 		}
 		if (type == ValueType::TIMETICKS) {
-			return Value::createTimeTicks(readUInt32(is, len, errorFlag));
+			out.reset(ValueType::TIMETICKS);
+			out.setInt(readUInt32(is, len, errorFlag));
+			return;
 		}
 		if (type == ValueType::IPADDR) {
 			in_addr addr = { 0 };
 			addr.s_addr = readIPAddress(is, len, errorFlag);
-			return Value::createIPAddr(inet_ntoa(addr));
+			out.reset(ValueType::IPADDR);
+			out.setInt(addr.s_addr);
+			out.valueString().assign(inet_ntoa(addr));
+			return;
 		}
 		if (type == ValueType::STRING) {
-			return Value::createString(is.readString(len));
+			out.reset(ValueType::STRING);
+			auto& str = out.valueString();
+			if (len > 0) {
+				str.resize(len);
+				str.resize(is.read(&str[0], len));
+			}
+			return;
 		}
 		if (type == ValueType::OID) {
-			return Value::createOID(readOID(is, len, errorFlag));
-		}
-
-		if (type == ValueType::SEQUENCE || ValueType::isPDU((ValueType::Enum)type)) {
-			size_t end = is.tell() + len;
-			std::vector<Value> vec;
-
-			while(is.tell() < end) {
-				auto val = read(is, errorFlag);
-				vec.push_back(val);
+			out.reset(ValueType::OID);
+			readOID(is, len, out.valueOID(), errorFlag);
+			if (out.valueOID().empty()) {
+				out.reset(ValueType::NULL_);
 			}
-
-			return Value::createSequence(vec, (ValueType::Enum)type);
+			return;
 		}
+
 		if (type == 0x80) {
 			// no-such-object
-			return Value::createNull();
+			out.reset(ValueType::NULL_);
+			return;
 		}
 		if (type == 0x81) {
 			// no-such-instance
-			return Value::createNull();
+			out.reset(ValueType::NULL_);
+			return;
 		}
 		if (type == 0x82) {
 			// end of mib view
-			return Value::createNull();
+			out.reset(ValueType::NULL_);
+			return;
 		}
 
-		g_logger.warning(stdext::format("Unknown value type %02X", type));
+		LOG_WARNING_LIMITED(stdext::format("Unknown value type %02X", type));
 		errorFlag = true;
-		return Value::createNull();
+		out.reset(ValueType::NULL_);
 	}
 
 
@@ -397,7 +446,7 @@ namespace application { namespace snmp {
 	}
 
 	// ************************************************************************************
-	void SNMPOutputStreamAdapter::writeSeq(ValueType::Enum type, const std::function<void()>& func) {
+	size_t SNMPOutputStreamAdapter::beginSeq(ValueType::Enum type) {
 		m_os.writePrimitive<uint8_t>(type);
 
 		size_t lenPos = m_os.tell();
@@ -408,8 +457,11 @@ namespace application { namespace snmp {
 		m_os.writePrimitive<uint8_t>(0);
 		m_os.writePrimitive<uint8_t>(0);
 
-		func();
+		return lenPos;
+	}
 
+	// ************************************************************************************
+	void SNMPOutputStreamAdapter::endSeq(size_t lenPos) {
 		size_t pos = m_os.tell();
 		m_os.seek(lenPos);
 
@@ -446,8 +498,8 @@ namespace application { namespace snmp {
 			writeNull();
 			return true;
 		}
-		if (value.type() == ValueType::END_OF_MIB_VIEW) {
-			writeZeroLen(ValueType::END_OF_MIB_VIEW);
+		if (value.isException()) {
+			writeZeroLen(value.type());
 			return true;
 		}
 		if (value.type() == ValueType::OID) {
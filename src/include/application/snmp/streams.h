@@ -37,7 +37,7 @@ namespace application { namespace snmp {
 	class SNMPInputStreamAdapter {
 		public:
 
-			static OID readOID(io::SeekableInputStream& is, int32_t len, bool& errorFlag);
+			static void readOID(io::SeekableInputStream& is, int32_t len, OID& out, bool& errorFlag);
 
 			static int32_t readHeaderLength(io::SeekableInputStream& is, bool& errorFlag);
 			static int32_t readInt32(io::SeekableInputStream& is, int32_t len, bool& errorFlag);
@@ -48,6 +48,10 @@ namespace application { namespace snmp {
 
 			static Value read(io::SeekableInputStream& is, bool& errorFlag);
 
+			// dekodowanie do istniejacej wartosci (np. z poprzedniego pakietu), bez nowych alokacji
+			// jezeli struktura jest taka sama
+			static void read(io::SeekableInputStream& is, Value& out, bool& errorFlag);
+
 		private:
 			SNMPInputStreamAdapter() { }
 
@@ -67,11 +71,20 @@ namespace application { namespace snmp {
 			bool writeOID(const OID& oid);
 			void writeZeroLen(ValueType::Enum type);
 			void writeNull() { writeZeroLen(ValueType::NULL_); }
-			void writeSeq(ValueType::Enum type, const std::function<void()>& func);
 			bool writeValue(const Value& value);
 
+			template<typename F>
+			void writeSeq(ValueType::Enum type, const F& func) {
+				size_t lenPos = beginSeq(type);
+				func();
+				endSeq(lenPos);
+			}
+
 		private:
 			io::SeekableOutputStream& m_os;
+
+			size_t beginSeq(ValueType::Enum type);
+			void endSeq(size_t lenPos);
 	};
 
 
@@ -32,17 +32,17 @@ namespace core {
 	// ************************************************************************************
 	Clock::Clock() {
 	    m_currentMicros = 0;
-	    m_currentMillis = 0;
-	    m_currentSeconds = 0;
 	    m_unixTime = 0;
 	}
 
 	// ************************************************************************************
 	void Clock::update() {
-	    m_currentMicros = stdext::Time::micros();
-	    m_currentMillis = m_currentMicros / 1000;
-	    m_currentSeconds = m_currentMicros / 1000000.0f;
-	    m_unixTime = stdext::Time::seconds();
+	    // kilka watkow moze aktualizowac rownolegle, wolniejszy nie moze cofnac zegara
+	    ticks_t micros = stdext::Time::micros();
+	    ticks_t current = m_currentMicros.load(std::memory_order_relaxed);
+	    while(current < micros && !m_currentMicros.compare_exchange_weak(current, micros, std::memory_order_relaxed)) { }
+
+	    m_unixTime.store(stdext::Time::seconds(), std::memory_order_relaxed);
 	}
 	
 	// ************************************************************************************
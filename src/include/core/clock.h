@@ -27,6 +27,7 @@
 #define CLOCK_H
 
 #include <base.h>
+#include <atomic>
 
 namespace core {
 
@@ -55,20 +56,19 @@ namespace core {
 
 			void update();
 
-			ticks_t micros() { return m_currentMicros; }
-			ticks_t millis() { return m_currentMillis; }
-			float seconds() { return m_currentSeconds; }
-			ticks_t time() { return m_unixTime; }
-			int32_t normalizedTime() { return m_unixTime - 1468589110UL; }
+			// aktualizowany przez petle glowna i petle watkow upstream - tylko do przodu
+			ticks_t micros() { return m_currentMicros.load(std::memory_order_relaxed); }
+			ticks_t millis() { return micros() / 1000; }
+			float seconds() { return micros() / 1000000.0f; }
+			ticks_t time() { return m_unixTime.load(std::memory_order_relaxed); }
+			int32_t normalizedTime() { return time() - 1468589110UL; }
 
 			WallTime utcTime();
 			WallTime localTime();
 
 		private:
-			ticks_t m_currentMicros;
-			ticks_t m_currentMillis;
-			float m_currentSeconds;
-			ticks_t m_unixTime;
+			std::atomic<ticks_t> m_currentMicros;
+			std::atomic<ticks_t> m_unixTime;
 	};
 
 	class ClockTimer {
@@ -36,7 +36,7 @@ namespace core {
 		    virtual ~Event();
 
 		    virtual void execute();
-		    void cancel();
+		    virtual void cancel();
 
 		    bool isCanceled() { return m_canceled; }
 		    bool isExecuted() { return m_executed; }
@@ -26,57 +26,64 @@
 #include "eventdispatcher.h"
 #include "clock.h"
 
+#include <unistd.h>
+
 core::EventDispatcher g_dispatcher;
 
 namespace core {
 
 	// ************************************************************************************
 	EventDispatcher::EventDispatcher() {
+		m_queueHead = 0;
+		m_queueSize = 0;
 		m_pollsWithoutExecuting = 0;
 		m_pollEventsSize = 0;
-		m_syncEventNum = 0;
+		m_syncWakeupPending = false;
+		m_wakeupFd = -1;
 	}
 
 	// ************************************************************************************
 	void EventDispatcher::shutdown() {
-	    while(!m_eventList.empty()) poll(false);
+	    // zdarzenia od innych watkow (zatrzymanych juz), ktore nie zdazyly wejsc do petli, sa tylko zwalniane
+	    SyncCallback func;
+	    while(m_syncEvents.pop(func)) func = nullptr;
 
-	    while(!m_scheduledEventList.empty()) {
-			ScheduledEventPtr scheduledEvent = m_scheduledEventList.top();
-			scheduledEvent->cancel();
-			m_scheduledEventList.pop();
-	    }
+	    while(m_queueSize > 0) poll(false);
+
+	    m_timers.clear();
 	    m_disabled = true;
 	}
 
 	// ************************************************************************************
 	void EventDispatcher::poll(bool useSleep) {
-		// pump out synchronized events
-		if (m_syncEventNum > 0) {
-			m_syncEventsMutex.lock();
-			for(auto& e: m_syncEvents) {
-				addEvent(e);
-			}
-			m_syncEvents.clear();
-			m_syncEventNum = 0;
-			m_syncEventsMutex.unlock();
+		// zdarzenia z innych watkow - wykonywane od razu, bez przepisywania do kolejki.
+		// Flaga jest zerowana przed oproznianiem (exchange - synchronizuje sie z producentem),
+		// wiec push po tym miejscu znowu obudzi select. Zerowana zawsze gdy ustawiona, bo
+		// producent moze ja ustawic juz po tym jak jego zdarzenie zostalo tu wykonane
+		if (m_syncWakeupPending.load(std::memory_order_relaxed)) {
+			m_syncWakeupPending.exchange(false);
 		}
 
+		SyncCallback func;
+		while(m_syncEvents.pop(func)) {
+			func();
+			func = nullptr;
+		}
 
-	    for(int count = 0, max = m_scheduledEventList.size(); count < max && !m_scheduledEventList.empty(); ++count) {
-	    	ScheduledEventPtr scheduledEvent = m_scheduledEventList.top();
-	    	if(scheduledEvent->remainingTicks() > 0) break;
-
-	    	m_scheduledEventList.pop();
-	    	scheduledEvent->execute();
+		// zdarzenia zaplanowane w trakcie wykonywania trafiaja do kola i czekaja na nastepny poll
+		m_timers.advance(g_clock.millis(), m_dueTimers);
+		for(size_t i=0;i<m_dueTimers.size();++i) {
+			ScheduledEvent* scheduledEvent = m_dueTimers[i].get();
+			scheduledEvent->execute();
 
-	    	if(scheduledEvent->nextCycle()) {
-	    		m_scheduledEventList.push(scheduledEvent);
-	    	}
-	    }
+			if (scheduledEvent->nextCycle()) {
+				m_timers.insert(scheduledEvent);
+			}
+		}
+		m_dueTimers.clear();
 
 	    // execute events list until all events are out
-	    m_pollEventsSize = m_eventList.size();
+	    m_pollEventsSize = m_queueSize;
 	    if (m_pollEventsSize == 0) {
 	    	m_pollsWithoutExecuting += 1;
 	    } else {
@@ -91,11 +98,18 @@ namespace core {
 			}
 
 			for(int i=0;i<m_pollEventsSize;++i) {
-				EventPtr event = m_eventList.front();
-				m_eventList.pop_front();
-				event->execute();
+				// zdarzenie musi wyjsc z kolejki przed wykonaniem - callback moze ja powiekszyc
+				QueuedEvent e(std::move(m_queue[m_queueHead]));
+				m_queueHead = (m_queueHead + 1) & (m_queue.size() - 1);
+				m_queueSize -= 1;
+
+				if (e.event) {
+					e.event->execute();
+				} else {
+					e.callback();
+				}
 			}
-			m_pollEventsSize = m_eventList.size();
+			m_pollEventsSize = m_queueSize;
 	    }
 
 	    if (m_pollsWithoutExecuting > 100) {
@@ -106,13 +120,24 @@ namespace core {
 	    }
 	}
 
+	// ************************************************************************************
+	int32_t EventDispatcher::nextTimeout(int32_t maxTimeout) {
+		if (m_queueSize > 0 || !m_syncEvents.empty()) return 0;
+
+		ticks_t now = g_clock.millis();
+		ticks_t expiry = m_timers.nextExpiry(now + maxTimeout);
+		if (expiry < 0) return maxTimeout;
+		if (expiry <= now) return 0;
+		return static_cast<int32_t>(expiry - now);
+	}
+
 	// ************************************************************************************
 	ScheduledEventPtr EventDispatcher::scheduleEvent(const std::function<void()>& callback, int delay) {
 	    if(m_disabled) return ScheduledEventPtr(new ScheduledEvent(nullptr, delay, 1));
 
 	    assert(delay >= 0);
 	    ScheduledEventPtr scheduledEvent(new ScheduledEvent(callback, delay, 1));
-	    m_scheduledEventList.push(scheduledEvent);
+	    m_timers.insert(scheduledEvent.get());
 	    return scheduledEvent;
 	}
 
@@ -122,7 +147,7 @@ namespace core {
 
 	    assert(delay > 0);
 	    ScheduledEventPtr scheduledEvent(new ScheduledEvent(callback, delay, 0));
-	    m_scheduledEventList.push(scheduledEvent);
+	    m_timers.insert(scheduledEvent.get());
 	    return scheduledEvent;
 	}
 
@@ -130,24 +155,68 @@ namespace core {
 	EventPtr EventDispatcher::addEvent(const std::function<void()>& callback, bool pushFront) {
 	    if(m_disabled) return EventPtr(new Event(nullptr));
 
-	    EventPtr event(new Event(callback));
+	    QueuedEvent e;
+	    e.event = new Event(callback);
+	    EventPtr event = e.event;
+
 	    // front pushing is a way to execute an event before others
 	    if(pushFront) {
-			m_eventList.push_front(event);
+	    	this->pushFront(std::move(e));
 			// the poll event list only grows when pushing into front
 			m_pollEventsSize++;
 	    } else {
-	    	m_eventList.push_back(event);
+	    	pushBack(std::move(e));
 	    }
 	    return event;
 	}
 
 	// ************************************************************************************
-	void EventDispatcher::pushEventSynchronized(const std::function<void()>& func) {
-		m_syncEventsMutex.lock();
-		m_syncEvents.push_back(func);
-		m_syncEventNum += 1;
-		m_syncEventsMutex.unlock();
+	void EventDispatcher::post(Callback&& callback) {
+		if (m_disabled) return;
+
+		QueuedEvent e;
+		e.callback = std::move(callback);
+		pushBack(std::move(e));
+	}
+
+	// ************************************************************************************
+	void EventDispatcher::pushBack(QueuedEvent&& e) {
+		if (m_queueSize == m_queue.size()) grow();
+		m_queue[(m_queueHead + m_queueSize) & (m_queue.size() - 1)] = std::move(e);
+		m_queueSize += 1;
+	}
+
+	// ************************************************************************************
+	void EventDispatcher::pushFront(QueuedEvent&& e) {
+		if (m_queueSize == m_queue.size()) grow();
+		m_queueHead = (m_queueHead - 1) & (m_queue.size() - 1);
+		m_queue[m_queueHead] = std::move(e);
+		m_queueSize += 1;
+	}
+
+	// ************************************************************************************
+	void EventDispatcher::grow() {
+		std::vector<QueuedEvent> queue(std::max<size_t>(64, m_queue.size() * 2));
+		for(size_t i=0;i<m_queueSize;++i) {
+			queue[i] = std::move(m_queue[(m_queueHead + i) & (m_queue.size() - 1)]);
+		}
+		m_queue.swap(queue);
+		m_queueHead = 0;
+	}
+
+	// ************************************************************************************
+	void EventDispatcher::pushEventSynchronized(SyncCallback&& func) {
+		m_syncEvents.push(std::move(func));
+
+		// jeden zapis do eventfd na serie zdarzen, do czasu az poll() je odbierze
+		if (!m_syncWakeupPending.exchange(true)) {
+			int32_t fd = m_wakeupFd.load();
+			if (fd >= 0) {
+				uint64_t one = 1;
+				ssize_t res = ::write(fd, &one, sizeof(one));
+				(void)res;
+			}
+		}
 	}
 
 
@@ -29,34 +29,65 @@
 #include <base.h>
 #include "clock.h"
 #include "scheduledevent.h"
+#include "timerwheel.h"
 
-#include <queue>
+#include <atomic>
 
 namespace core {
 
 	class EventDispatcher {
 		public:
+			typedef stdext::inplace_function<void()> Callback;
+			typedef stdext::inplace_function<void(), 64> SyncCallback;
+
 			EventDispatcher();
 
 			void shutdown();
 			void poll(bool useSleep=true);
 
-			void pushEventSynchronized(const std::function<void()>& func);
+			// ile petla moze czekac na I/O (ms) - 0 jezeli sa zdarzenia do wykonania,
+			// inaczej czas do najblizszego zaplanowanego, najwyzej maxTimeout
+			int32_t nextTimeout(int32_t maxTimeout);
+
+			// z dowolnego watku - callback zostanie wykonany w watku glownym w poll()
+			void pushEventSynchronized(SyncCallback&& func);
+
+			// eventfd budzacy select() po pushEventSynchronized (ustawiany przez aplikacje, -1 = brak)
+			void setWakeupFd(int32_t fd) { m_wakeupFd.store(fd); }
+
+			// zdarzenie bez obiektu Event (nie da sie go anulowac) - callback trzymany w kolejce
+			void post(Callback&& callback);
 
 			EventPtr addEvent(const std::function<void()>& callback, bool pushFront = false);
 			ScheduledEventPtr scheduleEvent(const std::function<void()>& callback, int delay);
 			ScheduledEventPtr cycleEvent(const std::function<void()>& callback, int delay);
 
 		private:
-			std::list<EventPtr> m_eventList;
+			// element kolejki - albo Event, albo bezposrednio callback z post()
+			struct QueuedEvent {
+				EventPtr event;
+				Callback callback;
+			};
+
+			// kolejka cykliczna o rozmiarze potegi dwojki, rosnie gdy sie zapelni
+			std::vector<QueuedEvent> m_queue;
+			size_t m_queueHead;
+			size_t m_queueSize;
+
 			int m_pollEventsSize;
 			int32_t m_pollsWithoutExecuting;
 			stdext::boolean<false> m_disabled;
-			std::priority_queue<ScheduledEventPtr, std::vector<ScheduledEventPtr>, lessScheduledEvent> m_scheduledEventList;
 
-			std::mutex m_syncEventsMutex;
-			std::vector<std::function<void(void)>> m_syncEvents;
-			volatile int32_t m_syncEventNum;
+			TimerWheel m_timers;
+			std::vector<ScheduledEventPtr> m_dueTimers;
+
+			stdext::mpsc_queue<SyncCallback> m_syncEvents;
+			std::atomic<bool> m_syncWakeupPending;
+			std::atomic<int32_t> m_wakeupFd;
+
+			void pushBack(QueuedEvent&& e);
+			void pushFront(QueuedEvent&& e);
+			void grow();
 	};
 
 }
@@ -25,6 +25,8 @@
 
 #include "logger.h"
 
+#include <cstring>
+
 core::Logger g_logger;
 
 namespace core {
@@ -40,19 +42,54 @@ namespace core {
 	}
 
 	// ************************************************************************************
-	void Logger::log(LogLevel::Enum level, const std::string& message, bool dumpTrace)
+	Logger::Logger() : m_ringMask(0), m_enqueuePos(0), m_dequeuePos(0), m_async(false), m_asyncStop(false),
+		m_overflowPolicy(LogOverflowPolicy::Drop), m_dropped(0), m_droppedReported(0), m_consumerSleeping(false)
 	{
+
+	}
+
+	// ************************************************************************************
+	Logger::~Logger() {
+		stopAsync();
+	}
+
+	// ************************************************************************************
+	void Logger::log(LogLevel::Enum level, std::string message, bool dumpTrace)
+	{
+	    if (m_async.load(std::memory_order_acquire)) {
+	    	if (level != LogLevel::Fatal) {
+	    		enqueue(level, message);
+	    		return;
+	    	}
+
+	    	// przed wyjsciem wszystko co w kolejce musi trafic do pliku
+	    	stopAsync();
+	    }
+
 	    std::lock_guard<std::recursive_mutex> lock(m_mutex);
 	    static bool ignoreLogs = false;
 	    if (ignoreLogs) return;
 
+	    write(level, stdext::Time::asStringWithMilis(), message);
+	    std::cerr.flush();
+	    if (m_outFile.good()) {
+	    	m_outFile.flush();
+	    }
+
+	    if(level == LogLevel::Fatal) {
+	    	//platformFatalError(message);
+			ignoreLogs = true;
+			exit(-1);
+	    }
+	}
+
+	// ************************************************************************************
+	void Logger::write(LogLevel::Enum level, const std::string& ts, const std::string& message) {
 	    // prepare final message
-	    StringVector vec;
-	    std::string ts = stdext::Time::asStringWithMilis();
-	    vec = stdext::split<char>(message,"\n");
+	    StringVector vec = stdext::split<char>(message,"\n");
 
 	    // outputing
-	    for(auto s: vec) {
+	    for(auto& s: vec) {
 		    std::stringstream buf;
 		    buf << "[" << ts << "] ";
 
@@ -65,22 +102,157 @@ namespace core {
 		    	case LogLevel::Warning: buf << "[ WARN ] "; break;
 		    }
 
-		    buf << s;
+		    buf << s << '\n';
 
-		    std::cerr << buf.str() << std::endl;
+		    std::cerr << buf.str();
 		    if(m_outFile.good()) {
-				m_outFile << buf.str() << std::endl;
-				m_outFile.flush();
+				m_outFile << buf.str();
 		    }
 	    }
+	}
 
-	    if(level == LogLevel::Fatal) {
-	    	//platformFatalError(message);
-			ignoreLogs = true;
-			exit(-1);
-	    }
+	// ************************************************************************************
+	void Logger::startAsync(int32_t capacity, LogOverflowPolicy::Enum policy) {
+		if (m_async.load()) return;
+
+		uint64_t size = 16;
+		while(size < static_cast<uint64_t>(capacity)) size *= 2;
+
+		m_ring.reset(new AsyncRecord[size]);
+		for(uint64_t i=0;i<size;++i) {
+			m_ring[i].sequence.store(i, std::memory_order_relaxed);
+		}
+		m_ringMask = size - 1;
+		m_enqueuePos.store(0);
+		m_dequeuePos = 0;
+		m_overflowPolicy = policy;
+		m_asyncStop.store(false);
+
+		m_thread = std::thread(&Logger::asyncThread, this);
+		m_async.store(true, std::memory_order_release);
 	}
 
+	// ************************************************************************************
+	void Logger::stopAsync() {
+		if (!m_async.exchange(false)) return;
+
+		m_asyncStop.store(true);
+		{
+			std::lock_guard<std::mutex> lock(m_wakeMutex);
+			m_wakeCond.notify_one();
+		}
+
+		if (m_thread.joinable()) {
+			m_thread.join();
+		}
+	}
+
+	// ************************************************************************************
+	bool Logger::enqueue(LogLevel::Enum level, std::string& message) {
+		uint64_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+		AsyncRecord* rec = nullptr;
+
+		while(true) {
+			rec = &m_ring[pos & m_ringMask];
+			uint64_t seq = rec->sequence.load(std::memory_order_acquire);
+			int64_t diff = static_cast<int64_t>(seq) - static_cast<int64_t>(pos);
+
+			if (diff == 0) {
+				if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+			} else if (diff < 0) {
+				// pelna kolejka
+				if (m_overflowPolicy == LogOverflowPolicy::Drop) {
+					m_dropped.fetch_add(1, std::memory_order_relaxed);
+					return false;
+				}
+
+				std::this_thread::yield();
+				pos = m_enqueuePos.load(std::memory_order_relaxed);
+			} else {
+				pos = m_enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		rec->level = level;
+		rec->time = stdext::Time::wallMillis();
+		rec->message.swap(message);
+		rec->sequence.store(pos + 1, std::memory_order_release);
+
+		if (m_consumerSleeping.load()) {
+			std::lock_guard<std::mutex> lock(m_wakeMutex);
+			m_wakeCond.notify_one();
+		}
+		return true;
+	}
+
+	// ************************************************************************************
+	bool Logger::dequeue(LogLevel::Enum& level, ticks_t& time, std::string& message) {
+		AsyncRecord& rec = m_ring[m_dequeuePos & m_ringMask];
+		uint64_t seq = rec.sequence.load(std::memory_order_acquire);
+		if (seq != m_dequeuePos + 1) return false;
+
+		level = rec.level;
+		time = rec.time;
+		message.swap(rec.message);
+		rec.message.clear();
+
+		rec.sequence.store(m_dequeuePos + m_ringMask + 1, std::memory_order_release);
+		m_dequeuePos += 1;
+		return true;
+	}
+
+	// ************************************************************************************
+	void Logger::asyncThread() {
+		static const int32_t BATCH_SIZE = 256;
+
+		LogLevel::Enum level;
+		ticks_t time;
+		std::string message;
+
+		while(true) {
+			int32_t num = 0;
+
+			{
+				std::lock_guard<std::recursive_mutex> lock(m_mutex);
+
+				while(num < BATCH_SIZE && dequeue(level, time, message)) {
+					write(level, stdext::Time::asStringWithMilis(time), message);
+					num += 1;
+				}
+
+				uint64_t dropped = m_dropped.load(std::memory_order_relaxed);
+				if (dropped != m_droppedReported) {
+					write(LogLevel::Warning, stdext::Time::asStringWithMilis(stdext::Time::wallMillis()),
+						stdext::format("[Logger] %d log messages dropped (queue full)", static_cast<int32_t>(dropped - m_droppedReported)));
+					m_droppedReported = dropped;
+					num += 1;
+				}
+
+				// jeden flush na cala paczke
+				if (num > 0) {
+					std::cerr.flush();
+					if (m_outFile.good()) {
+						m_outFile.flush();
+					}
+				}
+			}
+
+			if (num > 0) continue;
+			if (m_asyncStop.load()) break;
+
+			std::unique_lock<std::mutex> lock(m_wakeMutex);
+			m_consumerSleeping.store(true);
+
+			// ponowne sprawdzenie - producent mogl dodac rekord zanim ustawilismy flage
+			AsyncRecord& rec = m_ring[m_dequeuePos & m_ringMask];
+			if (rec.sequence.load(std::memory_order_acquire) != m_dequeuePos + 1 && !m_asyncStop.load()) {
+				m_wakeCond.wait_for(lock, std::chrono::milliseconds(100));
+			}
+			m_consumerSleeping.store(false);
+		}
+	}
+
+	// ************************************************************************************
 	void Logger::setLogFile(const std::string& file)
 	{
 	    std::lock_guard<std::recursive_mutex> lock(m_mutex);
@@ -93,5 +265,61 @@ namespace core {
 	    m_outFile.flush();
 	}
 	
-}
 
+
+// ##############################################################################################################################
+// LogRateLimiter
+// ##############################################################################################################################
+
+	std::atomic<LogRateLimiter*> LogRateLimiter::s_head(nullptr);
+
+	// ************************************************************************************
+	LogRateLimiter::LogRateLimiter(const char* file, int32_t line, LogLevel::Enum level, int32_t burst, int32_t interval)
+		: m_file(file), m_line(line), m_level(level), m_burst(burst), m_interval(interval),
+		  m_windowStart(stdext::Time::millis()), m_count(0), m_suppressed(0), m_lastReport(stdext::Time::millis())
+	{
+		// dopisanie do globalnej listy (obiekty sa statyczne, nigdy nie usuwane)
+		m_next = s_head.load();
+		while(!s_head.compare_exchange_weak(m_next, this)) { }
+	}
+
+	// ************************************************************************************
+	bool LogRateLimiter::allow() {
+		ticks_t now = stdext::Time::millis();
+		ticks_t windowStart = m_windowStart.load(std::memory_order_relaxed);
+
+		if (now - windowStart >= m_interval) {
+			if (m_windowStart.compare_exchange_strong(windowStart, now, std::memory_order_relaxed)) {
+				m_count.store(0, std::memory_order_relaxed);
+			}
+		}
+
+		if (m_count.fetch_add(1, std::memory_order_relaxed) < m_burst) {
+			return true;
+		}
+
+		m_suppressed.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	// ************************************************************************************
+	void LogRateLimiter::flush(ticks_t now) {
+		if (now - m_lastReport < m_interval) return;
+		m_lastReport = now;
+
+		int32_t suppressed = m_suppressed.exchange(0, std::memory_order_relaxed);
+		if (suppressed > 0) {
+			const char* file = strrchr(m_file, '/');
+			g_logger.log(m_level, stdext::format("[%s:%d] %d similar messages suppressed", file ? file + 1 : m_file, m_line, suppressed), false);
+		}
+	}
+
+	// ************************************************************************************
+	void LogRateLimiter::flushAll() {
+		ticks_t now = stdext::Time::millis();
+		for(LogRateLimiter* e = s_head.load();e != nullptr;e = e->m_next) {
+			e->flush(now);
+		}
+	}
+
+}
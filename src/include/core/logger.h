@@ -27,8 +27,12 @@
 #define LOGGER_H
 
 #include <base.h>
+#include <atomic>
+#include <condition_variable>
 #include <fstream>
+#include <memory>
 #include <mutex>
+#include <thread>
 #include "exceptions.h"
 
 namespace core {
@@ -42,6 +46,11 @@ namespace core {
 		Fatal = 6,
 	);
 
+	ENUM_DEFINE(LogOverflowPolicy,
+		Drop = 0,
+		Block = 1,
+	);
+
 
 	class Logger
 	{
@@ -50,25 +59,107 @@ namespace core {
 	    };
 
 	public:
-	    void log(LogLevel::Enum level, const std::string& message, bool dumpTrace);
-
-	    void debug(const std::string& what, bool dumpTrace=false) { log(LogLevel::Debug, what, dumpTrace); }
-	    void info(const std::string& what, bool dumpTrace=false) { log(LogLevel::Info, what, dumpTrace); }
-	    void script(const std::string& what, bool dumpTrace=false) { log(LogLevel::Script, what, dumpTrace); }
-	    void warning(const std::string& what, bool dumpTrace=false) { log(LogLevel::Warning, what, dumpTrace); }
-	    void error(const std::string& what, bool dumpTrace=false) { log(LogLevel::Error, what, dumpTrace); }
-	    void fatal(const std::string& what, bool dumpTrace=false) { log(LogLevel::Fatal, what, dumpTrace); }
+	    Logger();
+	    ~Logger();
+
+	    void log(LogLevel::Enum level, std::string message, bool dumpTrace);
+
+	    void debug(std::string what, bool dumpTrace=false) { log(LogLevel::Debug, std::move(what), dumpTrace); }
+	    void info(std::string what, bool dumpTrace=false) { log(LogLevel::Info, std::move(what), dumpTrace); }
+	    void script(std::string what, bool dumpTrace=false) { log(LogLevel::Script, std::move(what), dumpTrace); }
+	    void warning(std::string what, bool dumpTrace=false) { log(LogLevel::Warning, std::move(what), dumpTrace); }
+	    void error(std::string what, bool dumpTrace=false) { log(LogLevel::Error, std::move(what), dumpTrace); }
+	    void fatal(std::string what, bool dumpTrace=false) { log(LogLevel::Fatal, std::move(what), dumpTrace); }
 	    void exception(const std::string& msg, const Exception& e);
 
 	    void setLogFile(const std::string& file);
 
+	    // tryb asynchroniczny: log() tylko wrzuca rekord do kolejki, zapisuje osobny watek
+	    void startAsync(int32_t capacity, LogOverflowPolicy::Enum policy);
+	    void stopAsync();
+	    bool isAsync() const { return m_async.load(std::memory_order_acquire); }
+	    uint64_t getDroppedCount() const { return m_dropped.load(std::memory_order_relaxed); }
+
 	private:
+	    class AsyncRecord {
+	    	public:
+	    		std::atomic<uint64_t> sequence;
+	    		LogLevel::Enum level;
+	    		ticks_t time;
+	    		std::string message;
+	    };
+
 	    std::ofstream m_outFile;
 	    std::recursive_mutex m_mutex;
+
+	    // ograniczona kolejka wielu producentow / jednego konsumenta (numery sekwencyjne w komorkach)
+	    std::unique_ptr<AsyncRecord[]> m_ring;
+	    uint64_t m_ringMask;
+	    std::atomic<uint64_t> m_enqueuePos;
+	    uint64_t m_dequeuePos;
+
+	    std::atomic<bool> m_async;
+	    std::atomic<bool> m_asyncStop;
+	    LogOverflowPolicy::Enum m_overflowPolicy;
+	    std::atomic<uint64_t> m_dropped;
+	    uint64_t m_droppedReported;
+
+	    std::thread m_thread;
+	    std::mutex m_wakeMutex;
+	    std::condition_variable m_wakeCond;
+	    std::atomic<bool> m_consumerSleeping;
+
+	    bool enqueue(LogLevel::Enum level, std::string& message);
+	    bool dequeue(LogLevel::Enum& level, ticks_t& time, std::string& message);
+	    void asyncThread();
+
+	    void write(LogLevel::Enum level, const std::string& ts, const std::string& message);
+	};
+
+	/**
+	 * Ogranicznik logow dla jednego miejsca w kodzie (patrz LOG_LIMITED).
+	 * Przepuszcza 'burst' komunikatow na 'interval' ms, reszte tylko liczy.
+	 * Liczba pominietych jest raportowana okresowo przez flushAll().
+	 */
+	class LogRateLimiter {
+		public:
+			LogRateLimiter(const char* file, int32_t line, LogLevel::Enum level, int32_t burst = 5, int32_t interval = 10000);
+
+			bool allow();
+
+			// wypisuje "N similar messages suppressed" dla wszystkich ogranicznikow
+			static void flushAll();
+
+		private:
+			const char* m_file;
+			int32_t m_line;
+			LogLevel::Enum m_level;
+			int32_t m_burst;
+			int32_t m_interval;
+
+			std::atomic<ticks_t> m_windowStart;
+			std::atomic<int32_t> m_count;
+			std::atomic<int32_t> m_suppressed;
+			ticks_t m_lastReport;
+
+			LogRateLimiter* m_next;
+			static std::atomic<LogRateLimiter*> s_head;
+
+			void flush(ticks_t now);
 	};
 
 }
 
 extern core::Logger g_logger;
 
+// komunikat jest formatowany tylko jesli ogranicznik go przepusci
+#define LOG_LIMITED(level, message) \
+	do { \
+		static core::LogRateLimiter __logLimiter(__FILE__, __LINE__, level); \
+		if (__logLimiter.allow()) g_logger.log(level, message, false); \
+	} while(0)
+
+#define LOG_DEBUG_LIMITED(message) LOG_LIMITED(core::LogLevel::Debug, message)
+#define LOG_WARNING_LIMITED(message) LOG_LIMITED(core::LogLevel::Warning, message)
+
 #endif
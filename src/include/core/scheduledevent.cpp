@@ -24,6 +24,7 @@
 
 
 #include "scheduledevent.h"
+#include "timerwheel.h"
 
 namespace core {
 
@@ -33,6 +34,7 @@ namespace core {
 	    m_delay = delay;
 	    m_maxCycles = maxCycles;
 	    m_cyclesExecuted = 0;
+	    m_wheel = nullptr;
 	}
 
 	// ************************************************************************************
@@ -60,6 +62,15 @@ namespace core {
 	    m_callback = nullptr;
 	    return false;
 	}
-	
-}
 
+	// ************************************************************************************
+	void ScheduledEvent::cancel() {
+		Event::cancel();
+
+		// wypiecie z kola zwalnia jego referencje - musi byc ostatnie
+		if (m_wheel != nullptr) {
+			m_wheel->remove(this);
+		}
+	}
+
+}
@@ -31,14 +31,27 @@
 
 namespace core {
 
-	class ScheduledEvent : public Event {
+	class TimerWheel;
+
+	// wezel listy dwukierunkowej slotu w TimerWheel (slot ma wlasny wezel-wartownik)
+	struct TimerLink {
+		TimerLink* prev;
+		TimerLink* next;
+
+		TimerLink() : prev(this), next(this) { }
+
+		bool linked() const { return next != this; }
+	};
+
+	class ScheduledEvent : public Event, public TimerLink {
 		public:
 			ScheduledEvent(const std::function<void()>& callback, int delay, int maxCycles);
 			void execute();
 			bool nextCycle();
+			void cancel();
 
-			int ticks() { return m_ticks; }
-			int remainingTicks() { return m_ticks - g_clock.millis(); }
+			ticks_t ticks() { return m_ticks; }
+			ticks_t remainingTicks() { return m_ticks - g_clock.millis(); }
 			int delay() { return m_delay; }
 			int cyclesExecuted() { return m_cyclesExecuted; }
 			int maxCycles() { return m_maxCycles; }
@@ -48,16 +61,13 @@ namespace core {
 			int m_delay;
 			int m_maxCycles;
 			int m_cyclesExecuted;
+			TimerWheel* m_wheel;
+
+			friend class TimerWheel;
 	};
 
 	typedef stdext::object_ptr<ScheduledEvent> ScheduledEventPtr;
 
-	struct lessScheduledEvent : std::binary_function<ScheduledEventPtr, ScheduledEventPtr&, bool> {
-		bool operator()(const ScheduledEventPtr& a, const ScheduledEventPtr& b) {
-			return  b->ticks() < a->ticks();
-		}
-	};
-	
 }
 
 
@@ -0,0 +1,141 @@
+/*
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @author: pregusia
+ *
+ */
+
+#include "timerwheel.h"
+
+namespace core {
+
+	// ************************************************************************************
+	TimerWheel::TimerWheel() {
+		memset(m_used, 0, sizeof(m_used));
+		m_current = 0;
+		m_size = 0;
+	}
+
+	// ************************************************************************************
+	TimerWheel::~TimerWheel() {
+		clear();
+	}
+
+	// ************************************************************************************
+	void TimerWheel::insert(ScheduledEvent* event) {
+		assert(event != nullptr && event->m_wheel == nullptr);
+
+		// zaleglych nie mozna wpiac za m_current, bo te sloty kolo juz minelo
+		uint32_t slot = std::max(event->ticks(), m_current) & SLOTS_MASK;
+		TimerLink* head = &m_slots[slot];
+
+		event->prev = head->prev;
+		event->next = head;
+		head->prev->next = event;
+		head->prev = event;
+
+		event->m_wheel = this;
+		event->__refsInc();
+		markUsed(slot);
+		m_size += 1;
+	}
+
+	// ************************************************************************************
+	void TimerWheel::remove(ScheduledEvent* event) {
+		if (event == nullptr || event->m_wheel != this) return;
+
+		TimerLink* next = event->next;
+		event->prev->next = next;
+		next->prev = event->prev;
+		event->prev = event->next = event;
+
+		// po wypieciu jedynego elementu zostaje sam wartownik slotu
+		if (next->next == next) {
+			markFree(static_cast<uint32_t>(next - m_slots));
+		}
+
+		event->m_wheel = nullptr;
+		m_size -= 1;
+		event->__refsDec();
+	}
+
+	// ************************************************************************************
+	void TimerWheel::advance(ticks_t now, std::vector<ScheduledEventPtr>& due) {
+		if (now < m_current) return;
+
+		// po pelnym obrocie odwiedzone sa juz wszystkie sloty
+		ticks_t end = std::min<ticks_t>(now, m_current + SLOTS - 1);
+
+		for(ticks_t t = findUsed(m_current, end); t >= 0; t = findUsed(t + 1, end)) {
+			uint32_t slot = t & SLOTS_MASK;
+			TimerLink* head = &m_slots[slot];
+
+			for(TimerLink* link = head->next; link != head;) {
+				ScheduledEvent* event = static_cast<ScheduledEvent*>(link);
+				link = link->next;
+
+				// zdarzenia z kolejnych obrotow zostaja w slocie
+				if (event->ticks() > now) continue;
+
+				due.push_back(ScheduledEventPtr(event));
+				remove(event);
+			}
+		}
+
+		m_current = now + 1;
+	}
+
+	// ************************************************************************************
+	ticks_t TimerWheel::nextExpiry(ticks_t limit) const {
+		if (m_size == 0) return -1;
+
+		// od m_current, a nie od now - zalegle zdarzenia maja dac wynik < now
+		return findUsed(m_current, std::min<ticks_t>(limit, m_current + SLOTS - 1));
+	}
+
+	// ************************************************************************************
+	ticks_t TimerWheel::findUsed(ticks_t from, ticks_t to) const {
+		for(ticks_t t = from; t <= to;) {
+			uint32_t slot = t & SLOTS_MASK;
+			uint32_t bit = slot & 63;
+			uint64_t word = m_used[slot >> 6] >> bit;
+
+			if (word != 0) {
+				ticks_t found = t + __builtin_ctzll(word);
+				return found <= to ? found : -1;
+			}
+			t += 64 - bit;
+		}
+		return -1;
+	}
+
+	// ************************************************************************************
+	void TimerWheel::clear() {
+		for(uint32_t slot=0;slot<SLOTS;++slot) {
+			TimerLink* head = &m_slots[slot];
+			while(head->linked()) {
+				// cancel() wypina zdarzenie i zwalnia referencje kola
+				ScheduledEventPtr event(static_cast<ScheduledEvent*>(head->next));
+				event->cancel();
+			}
+		}
+	}
+
+}
@@ -0,0 +1,80 @@
+/*
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @author: pregusia
+ *
+ */
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <base.h>
+#include "scheduledevent.h"
+
+namespace core {
+
+	/**
+	 * Kolo czasowe (hashed timing wheel) dla ScheduledEvent'ow.
+	 * Slot to jedna milisekunda zegara g_clock, zdarzenie trafia do slotu (ticks % SLOTS)
+	 * i jest wpiete w jego liste intrusywnie - dodanie i anulowanie to O(1), bez alokacji.
+	 * Zdarzenia dalej niz SLOTS ms czekaja w slocie przez kolejne obroty kola.
+	 * Kolo trzyma referencje do kazdego wpietego zdarzenia.
+	 */
+	class TimerWheel {
+		public:
+			static const uint32_t SLOTS_BITS = 12;
+			static const uint32_t SLOTS = 1u << SLOTS_BITS;
+			static const uint32_t SLOTS_MASK = SLOTS - 1;
+
+			TimerWheel();
+			~TimerWheel();
+
+			void insert(ScheduledEvent* event);
+			void remove(ScheduledEvent* event);
+
+			// wypina wszystkie zdarzenia z ticks <= now do 'due' (w kolejnosci terminow)
+			void advance(ticks_t now, std::vector<ScheduledEventPtr>& due);
+
+			// termin najwczesniejszego niepustego slotu, nie pozniejszy niz limit (-1 jezeli brak)
+			ticks_t nextExpiry(ticks_t limit) const;
+
+			// anuluje wszystkie zdarzenia
+			void clear();
+
+			size_t size() const { return m_size; }
+			bool empty() const { return m_size == 0; }
+
+		private:
+			TimerLink m_slots[SLOTS];
+			uint64_t m_used[SLOTS / 64];
+			ticks_t m_current;
+			size_t m_size;
+
+			ticks_t findUsed(ticks_t from, ticks_t to) const;
+			void markUsed(uint32_t slot) { m_used[slot >> 6] |= (1ull << (slot & 63)); }
+			void markFree(uint32_t slot) { m_used[slot >> 6] &= ~(1ull << (slot & 63)); }
+
+			TimerWheel(const TimerWheel& from);
+			TimerWheel& operator=(const TimerWheel& from);
+	};
+
+}
+
+#endif
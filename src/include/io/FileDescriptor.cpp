@@ -31,14 +31,21 @@ extern io::IO g_io;
 namespace io {
 
 	// ************************************************************************************
-	FileDescriptor::FileDescriptor(int32_t fd): m_fd(fd) {
-		g_io.registerFileDescriptor(this);
+	FileDescriptor::FileDescriptor(int32_t fd, IO* io): m_fd(fd), m_io(io) {
+		if (m_io != nullptr) m_io->registerFileDescriptor(this);
 	}
 
 	// ************************************************************************************
 	FileDescriptor::~FileDescriptor() {
 		close();
-		g_io.unregisterFileDescriptor(this);
+		if (m_io != nullptr) m_io->unregisterFileDescriptor(this);
+	}
+
+	// ************************************************************************************
+	void FileDescriptor::rebind(IO* io) {
+		if (m_io != nullptr) m_io->unregisterFileDescriptor(this);
+		m_io = io;
+		if (m_io != nullptr) m_io->registerFileDescriptor(this);
 	}
 
 	// ************************************************************************************
@@ -51,14 +58,19 @@ namespace io {
 
 	// ************************************************************************************
 	FileDescriptorPtr FileDescriptor::Adapt(int32_t fd) {
+		return Adapt(fd, g_io);
+	}
+
+	// ************************************************************************************
+	FileDescriptorPtr FileDescriptor::Adapt(int32_t fd, IO& io) {
 		if (fd < 0) return nullptr;
-		return FileDescriptorPtr(new FileDescriptor(fd));
+		return FileDescriptorPtr(new FileDescriptor(fd, &io));
 	}
 
 	// ************************************************************************************
 	void FileDescriptor::callReadyRead() {
 		if (m_readyRead) {
-			auto func = m_readyRead;
+			auto func = std::move(m_readyRead);
 			m_readyRead = CallbackFunc();
 
 			func(dynamic_self_cast<FileDescriptor>());
@@ -68,7 +80,7 @@ namespace io {
 	// ************************************************************************************
 	void FileDescriptor::callReadyWrite() {
 		if (m_readyWrite) {
-			auto func = m_readyWrite;
+			auto func = std::move(m_readyWrite);
 			m_readyWrite = CallbackFunc();
 
 			func(dynamic_self_cast<FileDescriptor>());
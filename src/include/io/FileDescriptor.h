@@ -30,6 +30,7 @@
 
 namespace io {
 
+	class IO;
 	class FileDescriptor;
 	typedef stdext::object_ptr<FileDescriptor> FileDescriptorPtr;
 
@@ -53,12 +54,17 @@ namespace io {
 			template<typename T>
 			void onWriteReady(const T& func) { m_readyWrite = func; }
 
+			// przeniesienie do petli innego watku - wypiecie (nullptr) w starym, wpiecie w nowym
+			void rebind(IO* io);
+
 			static FileDescriptorPtr Adapt(int32_t fd);
+			static FileDescriptorPtr Adapt(int32_t fd, IO& io);
 
 		private:
-			FileDescriptor(int32_t fd);
+			FileDescriptor(int32_t fd, IO* io);
 
 			int32_t m_fd;
+			IO* m_io;
 			CallbackFunc m_readyRead;
 			CallbackFunc m_readyWrite;
 
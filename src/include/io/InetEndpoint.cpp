@@ -19,6 +19,7 @@
  * THE SOFTWARE.
  *
  * @author: pregusia
+ * @part-of: preg-snmp-proxy
  *
  */
 
@@ -28,39 +29,68 @@
 #include <arpa/inet.h>
 #include <netdb.h>
 
+namespace io {
 
-static std::map<std::string,std::string> g_dnsCache;
+	// ************************************************************************************
+	InetEndpoint InetEndpoint::resolve(const std::string& host, int32_t port) {
+		if (host.empty() || port <= 0 || port > 65535) return InetEndpoint();
 
-namespace io {
+		uint32_t address = 0;
+		if (!lookup(host, address)) {
+			g_logger.error(stdext::format("[InetEndpoint::resolve] Could not resolve '%s'", host));
+			return InetEndpoint();
+		}
+		return InetEndpoint(address, port);
+	}
 
 	// ************************************************************************************
-	InetEndpoint::InetEndpoint() {
-		m_port = 0;
+	InetEndpoint InetEndpoint::resolve(const std::string& spec) {
+		std::string host;
+		int32_t port = 0;
+		if (splitSpec(spec, host, port)) {
+			return resolve(host, port);
+		}
+		return InetEndpoint();
 	}
 
 	// ************************************************************************************
-	InetEndpoint::InetEndpoint(const std::string& host, int32_t port) {
-		m_host = host;
-		m_port = port;
-		if (m_port < 0) m_port = 0;
-		if (m_port > 65535) m_port = 0;
+	bool InetEndpoint::splitSpec(const std::string& spec, std::string& host, int32_t& port) {
+		if (spec.empty()) return false;
+
+		auto arr = stdext::split<char>(spec,":");
+		if (arr.size() != 2) return false;
+
+		host = arr[0];
+		port = stdext::unsafeCast<int32_t>(arr[1]);
+		return true;
 	}
 
 	// ************************************************************************************
-	InetEndpoint::InetEndpoint(const std::string& spec) {
-		if (!spec.empty()) {
-			auto arr = stdext::split<char>(spec,":");
-			if (arr.size() == 2) {
-				m_host = arr[0];
-				m_port = stdext::unsafeCast<int32_t>(arr[1]);
-			}
-		}
+	bool InetEndpoint::isAddress(const std::string& host) {
+		in_addr addr = { 0 };
+		return inet_pton(AF_INET, host.c_str(), &addr) == 1;
 	}
 
 	// ************************************************************************************
-	InetEndpoint::InetEndpoint(const sockaddr_in& addr) {
-		m_port = ntohs(addr.sin_port);
-		m_host = inet_ntoa(addr.sin_addr);
+	bool InetEndpoint::lookup(const std::string& host, uint32_t& address) {
+		in_addr addr = { 0 };
+		if (inet_pton(AF_INET, host.c_str(), &addr) == 1) {
+			address = addr.s_addr;
+			return true;
+		}
+
+		addrinfo hints = { 0 };
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_DGRAM;
+
+		addrinfo* res = nullptr;
+		if (getaddrinfo(host.c_str(), nullptr, &hints, &res) != 0 || res == nullptr) {
+			return false;
+		}
+
+		address = reinterpret_cast<sockaddr_in*>(res->ai_addr)->sin_addr.s_addr;
+		freeaddrinfo(res);
+		return true;
 	}
 
 	// ************************************************************************************
@@ -68,7 +98,11 @@ namespace io {
 		if (empty()) {
 			return "[empty]";
 		} else {
-			return stdext::format("%s:%d", m_host, m_port);
+			char buf[INET_ADDRSTRLEN] = { 0 };
+			in_addr addr = { 0 };
+			addr.s_addr = m_address;
+			inet_ntop(AF_INET, &addr, buf, sizeof(buf));
+			return stdext::format("%s:%d", buf, (int32_t)m_port);
 		}
 	}
 
@@ -77,28 +111,7 @@ namespace io {
 		sockaddr_in res = { 0 };
 		res.sin_family = AF_INET;
 		res.sin_port = htons(m_port);
-
-		if (inet_addr(m_host.c_str()) != INADDR_NONE) {
-			res.sin_addr.s_addr = inet_addr(m_host.c_str());
-			return res;
-		}
-
-		if (g_dnsCache.find(m_host) != g_dnsCache.end()) {
-			res.sin_addr.s_addr = inet_addr(g_dnsCache[m_host].c_str());
-			return res;
-		}
-
-		hostent* he = gethostbyname(m_host.c_str());
-		if (he != NULL) {
-			in_addr** addr_list = (in_addr**)he->h_addr_list;
-			if (addr_list[0] != NULL) {
-				res.sin_addr = *addr_list[0];
-				g_dnsCache[m_host] = inet_ntoa(res.sin_addr);
-				return res;
-			}
-		}
-
-		res.sin_addr.s_addr = INADDR_NONE;
+		res.sin_addr.s_addr = m_address;
 		return res;
 	}
 
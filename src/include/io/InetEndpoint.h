@@ -19,6 +19,7 @@
  * THE SOFTWARE.
  *
  * @author: pregusia
+ * @part-of: preg-snmp-proxy
  *
  */
 
@@ -30,27 +31,54 @@
 
 namespace io {
 
+	/**
+	 * Adres IPv4 + port w postaci binarnej (adres w kolejnosci sieciowej).
+	 * Porownanie i hash to operacje na liczbach, na string zamieniany tylko do logow.
+	 * Nazwy hostow sa rozwiazywane raz - w resolve(), przy ladowaniu konfiguracji.
+	 */
 	class InetEndpoint {
 		public:
-			InetEndpoint();
-			InetEndpoint(const std::string& host, int32_t port);
-			InetEndpoint(const std::string& spec);
-			InetEndpoint(const sockaddr_in& addr);
+			InetEndpoint() : m_address(0), m_port(0) { }
+			InetEndpoint(uint32_t address, uint16_t port) : m_address(address), m_port(port) { }
+			InetEndpoint(const sockaddr_in& addr) : m_address(addr.sin_addr.s_addr), m_port(ntohs(addr.sin_port)) { }
 
-			const std::string& host() const { return m_host; }
-			int32_t port() const { return m_port; }
+			static InetEndpoint resolve(const std::string& host, int32_t port);
+			static InetEndpoint resolve(const std::string& spec);
 
-			bool empty() const { return m_host.empty() || m_port == 0; }
+			// "host:port" -> host, port
+			static bool splitSpec(const std::string& spec, std::string& host, int32_t& port);
+			static bool isAddress(const std::string& host);
+			// blokujace (getaddrinfo), adres w kolejnosci sieciowej
+			static bool lookup(const std::string& host, uint32_t& address);
+
+			uint32_t address() const { return m_address; }
+			uint16_t port() const { return m_port; }
+
+			bool empty() const { return m_port == 0; }
+
+			// adres i port w jednej liczbie
+			uint64_t key() const { return (static_cast<uint64_t>(m_address) << 16) | m_port; }
 
 			std::string toString() const;
 			sockaddr_in toSockAddr() const;
 
-			bool operator==(const InetEndpoint& o) const { return o.m_host == m_host && o.m_port == m_port; }
-			bool operator!=(const InetEndpoint& o) const { return !(o.m_host == m_host && o.m_port == m_port); }
+			bool operator==(const InetEndpoint& o) const { return o.m_address == m_address && o.m_port == m_port; }
+			bool operator!=(const InetEndpoint& o) const { return !(*this == o); }
+			bool operator<(const InetEndpoint& o) const { return key() < o.key(); }
 
 		private:
-			std::string m_host;
-			int32_t m_port;
+			uint32_t m_address;
+			uint16_t m_port;
+	};
+
+}
+
+namespace std {
+
+	// hash, for unordered_map support
+	template<>
+	struct hash<io::InetEndpoint> {
+		size_t operator()(const io::InetEndpoint& e) const { return std::hash<uint64_t>()(e.key()); }
 	};
 
 }
@@ -0,0 +1,128 @@
+/*
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @author: pregusia
+ * @part-of: preg-snmp-proxy
+ *
+ */
+
+#include "Resolver.h"
+#include <core/eventdispatcher.h>
+
+io::Resolver g_resolver;
+
+namespace io {
+
+	// ************************************************************************************
+	Resolver::Resolver() {
+		m_stop = false;
+	}
+
+	// ************************************************************************************
+	Resolver::~Resolver() {
+		stop();
+	}
+
+	// ************************************************************************************
+	void Resolver::watch(const std::string& host, const InetEndpoint& current, int32_t ttl, const ChangedCallback& callback) {
+		if (ttl <= 0 || !callback) return;
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		Entry e;
+		e.host = host;
+		e.endpoint = current;
+		e.ttl = ttl;
+		e.nextTime = Clock::now() + std::chrono::seconds(ttl);
+		e.callback = callback;
+		m_entries.push_back(e);
+
+		if (!m_thread.joinable()) {
+			m_stop = false;
+			m_thread = std::thread(&Resolver::run, this);
+		} else {
+			m_cond.notify_one();
+		}
+	}
+
+	// ************************************************************************************
+	void Resolver::stop() {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+			m_cond.notify_one();
+		}
+
+		if (m_thread.joinable()) {
+			m_thread.join();
+		}
+
+		// callbacki trzymaja obiekty aplikacji
+		m_entries.clear();
+	}
+
+	// ************************************************************************************
+	void Resolver::run() {
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		while(!m_stop) {
+			Clock::time_point nextTime = Clock::now() + std::chrono::seconds(static_cast<int32_t>(RETRY_SECONDS));
+
+			for(size_t i=0;i<m_entries.size() && !m_stop;++i) {
+				if (m_entries[i].nextTime > Clock::now()) {
+					nextTime = std::min(nextTime, m_entries[i].nextTime);
+					continue;
+				}
+
+				// zapytanie bez blokady, watch() moze w tym czasie dopisac wpis
+				std::string host = m_entries[i].host;
+				uint32_t address = 0;
+
+				lock.unlock();
+				bool found = InetEndpoint::lookup(host, address);
+				lock.lock();
+
+				Entry& e = m_entries[i];
+				if (found) {
+					e.nextTime = Clock::now() + std::chrono::seconds(e.ttl);
+
+					if (address != e.endpoint.address()) {
+						InetEndpoint prev = e.endpoint;
+						e.endpoint = InetEndpoint(address, e.endpoint.port());
+						g_logger.info(stdext::format("[Resolver] %s changed address %s -> %s", e.host, prev.toString(), e.endpoint.toString()));
+
+						ChangedCallback callback = e.callback;
+						InetEndpoint endpoint = e.endpoint;
+						g_dispatcher.pushEventSynchronized([callback, endpoint](){ callback(endpoint); });
+					}
+				} else {
+					e.nextTime = Clock::now() + std::chrono::seconds(std::min(e.ttl, static_cast<int32_t>(RETRY_SECONDS)));
+					g_logger.warning(stdext::format("[Resolver] Could not resolve '%s', still using %s", e.host, e.endpoint.toString()));
+				}
+				nextTime = std::min(nextTime, e.nextTime);
+			}
+
+			if (!m_stop) {
+				m_cond.wait_until(lock, nextTime);
+			}
+		}
+	}
+
+}
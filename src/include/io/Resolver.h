@@ -0,0 +1,86 @@
+/*
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @author: pregusia
+ * @part-of: preg-snmp-proxy
+ *
+ */
+
+#ifndef INCLUDE_IO_RESOLVER_H_
+#define INCLUDE_IO_RESOLVER_H_
+
+#include <base.h>
+#include "InetEndpoint.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace io {
+
+	/**
+	 * Rozwiazywanie nazw hostow w osobnym watku.
+	 * Obserwowane nazwy sa odpytywane ponownie co 'ttl' sekund, a gdy adres sie zmieni
+	 * callback jest wolany w watku glownym (przez g_dispatcher). Petla obslugi pakietow
+	 * nigdy nie czeka na DNS - do czasu zmiany uzywa ostatniego znanego adresu.
+	 */
+	class Resolver {
+		public:
+			typedef std::function<void(const InetEndpoint&)> ChangedCallback;
+
+			Resolver();
+			~Resolver();
+
+			// 'current' to adres rozwiazany przy ladowaniu konfiguracji
+			void watch(const std::string& host, const InetEndpoint& current, int32_t ttl, const ChangedCallback& callback);
+			void stop();
+
+		private:
+			typedef std::chrono::steady_clock Clock;
+
+			// po nieudanym zapytaniu ponowienie najpozniej po tylu sekundach
+			static const int32_t RETRY_SECONDS = 30;
+
+			class Entry {
+				public:
+					std::string host;
+					InetEndpoint endpoint;
+					int32_t ttl;
+					Clock::time_point nextTime;
+					ChangedCallback callback;
+			};
+
+			std::mutex m_mutex;
+			std::condition_variable m_cond;
+			std::thread m_thread;
+			bool m_stop;
+
+			// tylko dopisywane, watek odwoluje sie do wpisow po indeksie
+			std::vector<Entry> m_entries;
+
+			void run();
+	};
+
+}
+
+extern io::Resolver g_resolver;
+
+#endif /* INCLUDE_IO_RESOLVER_H_ */
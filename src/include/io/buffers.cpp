@@ -45,6 +45,12 @@ namespace io {
 		m_data.clear();
 	}
 
+	// ************************************************************************************
+	void DataBuffer::assign(const void* source, std::size_t size) {
+		const uint8_t* ptr = static_cast<const uint8_t*>(source);
+		m_data.assign(ptr, ptr + size);
+	}
+
 	// ************************************************************************************
 	std::string DataBuffer::asString() const {
 		if (m_data.empty()) return "";
@@ -47,6 +47,7 @@ namespace io {
 
 			void resize(std::size_t newSize);
 			void clear();
+			void assign(const void* source, std::size_t size);
 
 			uint8_t& operator[](std::size_t idx) { return m_data[idx]; }
 			const uint8_t& operator[](std::size_t idx) const { return m_data[idx]; }
@@ -35,6 +35,7 @@
 #include <unistd.h>
 
 #include "FileDescriptor.h"
+#include <core/clock.h>
 
 io::IO g_io;
 
@@ -130,28 +131,38 @@ namespace io {
 			tv.tv_usec = (timeout % 1000) * 1000;
 
 			int32_t res = ::select(std::max(readMax, writeMax) + 1, &readSet, &writeSet, nullptr, &tv);
+
+			// callbacki licza terminy od g_clock, wiec zegar musi byc aktualny zanim ruszy obsluga
+			g_clock.update();
+
 			if (res > 0) {
-				std::vector<FileDescriptorPtr> toCallRead, toCallWrite;
+				m_toCallRead.clear();
+				m_toCallWrite.clear();
 
 				for(auto& fd: m_fileDescriptors) {
+					if (!fd->valid()) continue;
 					if (FD_ISSET(fd->fd(), &readSet)) {
-						toCallRead.push_back(fd->dynamic_self_cast<FileDescriptor>());
+						m_toCallRead.push_back(fd->dynamic_self_cast<FileDescriptor>());
 					}
 					if (FD_ISSET(fd->fd(), &writeSet)) {
-						toCallWrite.push_back(fd->dynamic_self_cast<FileDescriptor>());
+						m_toCallWrite.push_back(fd->dynamic_self_cast<FileDescriptor>());
 					}
 				}
 
-				for(auto& fd: toCallRead) {
+				for(auto& fd: m_toCallRead) {
 					fd->callReadyRead();
 				}
-				for(auto& fd: toCallWrite) {
+				for(auto& fd: m_toCallWrite) {
 					fd->callReadyWrite();
 				}
+
+				m_toCallRead.clear();
+				m_toCallWrite.clear();
 				return true;
 			}
 		} else {
 			usleep(timeout * 1000);
+			g_clock.update();
 		}
 		return false;
 	}
@@ -30,6 +30,7 @@
 namespace io {
 
 	class FileDescriptor;
+	typedef stdext::object_ptr<FileDescriptor> FileDescriptorPtr;
 
 	class IO {
 
@@ -46,6 +47,10 @@ namespace io {
 		private:
 			std::list<FileDescriptor*> m_fileDescriptors;
 
+			// gotowe deskryptory z ostatniego select'a (uzywane ponownie, bez alokacji)
+			std::vector<FileDescriptorPtr> m_toCallRead;
+			std::vector<FileDescriptorPtr> m_toCallWrite;
+
 			void registerFileDescriptor(FileDescriptor* fd);
 			void unregisterFileDescriptor(FileDescriptor* fd);
 
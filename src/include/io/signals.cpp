@@ -26,6 +26,8 @@
 #include <core/eventdispatcher.h>
 
 #include <signal.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
 #include <wait.h>
 
 io::Signals g_unixSignals;
@@ -34,58 +36,39 @@ namespace io {
 
 	// ************************************************************************************
 	Signals::Signals() {
-		clear();
-		m_anyRaised = false;
-	}
 
-	// ************************************************************************************
-	void Signals::start() {
-		registerSignals();
 	}
 
 	// ************************************************************************************
-	void Signals::clear() {
-		for(int32_t i=0;i<SIGS_NUM;++i) {
-			m_raisedSignals[i] = false;
+	void Signals::start() {
+		if (m_fd) return;
+
+		sigset_t mask;
+		sigemptyset(&mask);
+		sigaddset(&mask, SIGUSR1);
+		sigaddset(&mask, SIGTERM);
+		sigaddset(&mask, SIGABRT);
+		sigaddset(&mask, SIGINT);
+		sigaddset(&mask, SIGPIPE);
+		sigaddset(&mask, SIGCHLD);
+
+		if (pthread_sigmask(SIG_BLOCK, &mask, nullptr) != 0) {
+			g_logger.fatal("[Signals::start] Could not block signals");
 		}
-		for(int32_t i=0;i<CHILD_SLOTS;++i) {
-			m_childExitCodes[i] = -1;
-			m_childPids[i] = -1;
+
+		m_fd = FileDescriptor::Adapt(signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC));
+		if (!m_fd) {
+			g_logger.fatal(stdext::format("[Signals::start] Could not create signalfd - %s", strerror(errno)));
 		}
+		m_fd->onReadReady([this](FileDescriptorPtr fd){ onRead(fd); });
 	}
 
 	// ************************************************************************************
-	void Signals::poll() {
-		if (m_anyRaised) {
-			m_anyRaised = false;
-
-			for(int32_t sig=0;sig<SIGS_NUM;++sig) {
-				if (m_raisedSignals[sig]) {
-					auto handlerIt = m_signalHandlers.find(sig);
-					if (handlerIt != m_signalHandlers.end()) {
-						g_dispatcher.addEvent(handlerIt->second);
-					}
-				}
-			}
+	void Signals::stop() {
+		if (!m_fd) return;
 
-			for(int32_t i=0;i<CHILD_SLOTS;++i) {
-				if (m_childPids[i] >= 0) {
-					int32_t pid = m_childPids[i];
-					int32_t exitCode = m_childExitCodes[i];
-
-					auto handlerIt = m_childrenHandlers.find(pid);
-					if (handlerIt != m_childrenHandlers.end()) {
-						auto fn = handlerIt->second;
-						g_dispatcher.addEvent([=](){
-							fn(pid, exitCode);
-						});
-						m_childrenHandlers.erase(handlerIt);
-					}
-				}
-			}
-
-			clear();
-		}
+		m_fd->onReadReady(FileDescriptor::CallbackFunc());
+		m_fd.reset();
 	}
 
 	// ************************************************************************************
@@ -99,45 +82,46 @@ namespace io {
 	}
 
 	// ************************************************************************************
-	void Signals::onSignal(int32_t sig) {
-		if (sig == SIGCHLD) {
-
-			while(true) {
-				int32_t status = 0;
-				pid_t pid = ::waitpid(-1, &status, WNOHANG);
-				if (pid <= 0) break;
-
-				for(int32_t i=0;i<CHILD_SLOTS;++i) {
-					if (m_childPids[i] < 0) {
-						m_childPids[i] = pid;
-						m_childExitCodes[i] = WEXITSTATUS(status);
-						m_anyRaised = true;
-						break;
-					}
-				}
-			}
-
-		} else {
-			m_raisedSignals[sig] = true;
-			m_anyRaised = true;
+	void Signals::onRead(FileDescriptorPtr fd) {
+		signalfd_siginfo info;
+		while(::read(m_fd->fd(), &info, sizeof(info)) == sizeof(info)) {
+			onSignal(info.ssi_signo);
 		}
+
+		m_fd->onReadReady([this](FileDescriptorPtr fd){ onRead(fd); });
 	}
 
 	// ************************************************************************************
-	void Signals::onSignalStatic(int32_t sig) {
-		g_unixSignals.onSignal(sig);
-		registerSignals();
-	}
+	void Signals::onSignal(int32_t sig) {
+		if (sig == SIGCHLD) {
+			onChildrenEnded();
+			return;
+		}
 
+		auto handlerIt = m_signalHandlers.find(sig);
+		if (handlerIt != m_signalHandlers.end()) {
+			g_dispatcher.post(handlerIt->second);
+		}
+	}
 
 	// ************************************************************************************
-	void Signals::registerSignals() {
-		signal(SIGUSR1, Signals::onSignalStatic);
-		signal(SIGTERM, Signals::onSignalStatic);
-		signal(SIGABRT, Signals::onSignalStatic);
-		signal(SIGINT, Signals::onSignalStatic);
-		signal(SIGPIPE, Signals::onSignalStatic);
-		signal(SIGCHLD, Signals::onSignalStatic);
+	void Signals::onChildrenEnded() {
+		// kilka SIGCHLD moze sie zlac w jeden
+		while(true) {
+			int32_t status = 0;
+			pid_t pid = ::waitpid(-1, &status, WNOHANG);
+			if (pid <= 0) break;
+
+			auto handlerIt = m_childrenHandlers.find(pid);
+			if (handlerIt != m_childrenHandlers.end()) {
+				auto fn = handlerIt->second;
+				int32_t exitCode = WEXITSTATUS(status);
+				g_dispatcher.addEvent([=](){
+					fn(pid, exitCode);
+				});
+				m_childrenHandlers.erase(handlerIt);
+			}
+		}
 	}
 
 }
@@ -27,9 +27,16 @@
 
 #include <base.h>
 #include <functional>
+#include <signal.h>
+
+#include "FileDescriptor.h"
 
 namespace io {
 
+	/**
+	 * Sygnaly odbierane przez signalfd - sa blokowane w calym procesie i przychodza
+	 * jako zwykly deskryptor w g_io.select(), a handlery sa wolane przez g_dispatcher.
+	 */
 	class Signals {
 		public:
 			Signals();
@@ -37,29 +44,22 @@ namespace io {
 			typedef std::function<void()> SignalHandlerCallback;
 			typedef std::function<void(int32_t, int32_t)> ChildEndedCallback;
 
+			// przed uruchomieniem innych watkow (dziedzicza maske sygnalow)
 			void start();
-			void poll();
+			void stop();
 
 			void registerSignalHandler(int32_t sig, const SignalHandlerCallback& callback);
 			void registerChildEndCallback(int32_t pid, const ChildEndedCallback& callback);
 
 		private:
-			static const int32_t SIGS_NUM = 64;
-			static const int32_t CHILD_SLOTS = 64;
-
-			volatile bool m_anyRaised;
-			volatile bool m_raisedSignals[SIGS_NUM];
-			volatile int32_t m_childPids[CHILD_SLOTS];
-			volatile int32_t m_childExitCodes[CHILD_SLOTS];
+			FileDescriptorPtr m_fd;
 
 			std::map<int32_t,SignalHandlerCallback> m_signalHandlers;
 			std::map<int32_t,ChildEndedCallback> m_childrenHandlers;
 
-			void clear();
-
+			void onRead(FileDescriptorPtr fd);
 			void onSignal(int32_t sig);
-			static void onSignalStatic(int32_t sig);
-			static void registerSignals();
+			void onChildrenEnded();
 	};
 
 }
@@ -0,0 +1,137 @@
+/*
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @author: pregusia
+ * @part-of: preg-snmp-proxy
+ *
+ */
+
+#ifndef INCLUDE_STDEXT_FUNCTION_H_
+#define INCLUDE_STDEXT_FUNCTION_H_
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <cassert>
+
+namespace stdext {
+
+	template<typename Signature, std::size_t Capacity = 32>
+	class inplace_function;
+
+	/**
+	 * Odpowiednik std::function, ktory nigdy nie alokuje - funktor jest
+	 * trzymany w buforze wewnatrz obiektu (za duzy funktor to blad kompilacji).
+	 * Tylko przenoszenie, bez kopiowania.
+	 */
+	template<typename R, typename... Args, std::size_t Capacity>
+	class inplace_function<R(Args...), Capacity> {
+		public:
+			inplace_function() : m_invoke(nullptr), m_manage(nullptr) { }
+			inplace_function(std::nullptr_t) : m_invoke(nullptr), m_manage(nullptr) { }
+
+			template<typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, inplace_function>::value>::type>
+			inplace_function(F&& func) {
+				typedef typename std::decay<F>::type Functor;
+				static_assert(sizeof(Functor) <= Capacity, "stdext::inplace_function capacity too small for functor");
+				static_assert(alignof(Functor) <= alignof(Storage), "stdext::inplace_function invalid functor alignment");
+
+				new(&m_storage) Functor(std::forward<F>(func));
+				m_invoke = &invokeImpl<Functor>;
+				m_manage = &manageImpl<Functor>;
+			}
+
+			inplace_function(inplace_function&& rhs) noexcept : m_invoke(nullptr), m_manage(nullptr) {
+				moveFrom(rhs);
+			}
+
+			~inplace_function() { reset(); }
+
+			inplace_function& operator=(inplace_function&& rhs) noexcept {
+				if (this != &rhs) {
+					reset();
+					moveFrom(rhs);
+				}
+				return *this;
+			}
+
+			inplace_function& operator=(std::nullptr_t) {
+				reset();
+				return *this;
+			}
+
+			void reset() {
+				if (m_manage != nullptr) {
+					m_manage(&m_storage, nullptr);
+					m_invoke = nullptr;
+					m_manage = nullptr;
+				}
+			}
+
+			bool empty() const { return m_invoke == nullptr; }
+			explicit operator bool() const { return m_invoke != nullptr; }
+
+			R operator()(Args... args) const {
+				assert(m_invoke != nullptr);
+				return m_invoke(const_cast<void*>(static_cast<const void*>(&m_storage)), std::forward<Args>(args)...);
+			}
+
+		private:
+			typedef typename std::aligned_storage<Capacity, alignof(std::max_align_t)>::type Storage;
+
+			// manage(dst, src): src != nullptr - przeniesienie src do dst, src == nullptr - zniszczenie dst
+			typedef R (*InvokeFunc)(void* storage, Args&&... args);
+			typedef void (*ManageFunc)(void* dst, void* src);
+
+			Storage m_storage;
+			InvokeFunc m_invoke;
+			ManageFunc m_manage;
+
+			void moveFrom(inplace_function& rhs) {
+				if (rhs.m_manage != nullptr) {
+					rhs.m_manage(&m_storage, &rhs.m_storage);
+					m_invoke = rhs.m_invoke;
+					m_manage = rhs.m_manage;
+					rhs.reset();
+				}
+			}
+
+			template<typename Functor>
+			static R invokeImpl(void* storage, Args&&... args) {
+				return (*static_cast<Functor*>(storage))(std::forward<Args>(args)...);
+			}
+
+			template<typename Functor>
+			static void manageImpl(void* dst, void* src) {
+				if (src != nullptr) {
+					new(dst) Functor(std::move(*static_cast<Functor*>(src)));
+				} else {
+					static_cast<Functor*>(dst)->~Functor();
+				}
+			}
+
+			inplace_function(const inplace_function& from);
+			inplace_function& operator=(const inplace_function& from);
+	};
+
+}
+
+#endif /* INCLUDE_STDEXT_FUNCTION_H_ */
@@ -0,0 +1,94 @@
+/*
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @author: pregusia
+ * @part-of: preg-snmp-proxy
+ *
+ */
+
+#ifndef INCLUDE_STDEXT_MPSC_QUEUE_H_
+#define INCLUDE_STDEXT_MPSC_QUEUE_H_
+
+#include <atomic>
+#include <utility>
+
+namespace stdext {
+
+	/**
+	 * Kolejka wielu producentow / jednego konsumenta bez blokad (lista intrusywna
+	 * z wezlem-wartownikiem, D. Vyukov). push() moze wolac dowolny watek,
+	 * pop() i empty() tylko watek konsumenta. Jedna alokacja wezla na element.
+	 */
+	template<typename T>
+	class mpsc_queue {
+		public:
+			mpsc_queue() {
+				m_tail = new Node();
+				m_head.store(m_tail, std::memory_order_relaxed);
+			}
+
+			~mpsc_queue() {
+				T value;
+				while(pop(value)) { }
+				delete m_tail;
+			}
+
+			void push(T&& value) {
+				Node* node = new Node(std::move(value));
+				Node* prev = m_head.exchange(node, std::memory_order_acq_rel);
+
+				// miedzy exchange a tym zapisem konsument widzi koniec listy na prev
+				prev->next.store(node, std::memory_order_release);
+			}
+
+			bool pop(T& value) {
+				Node* next = m_tail->next.load(std::memory_order_acquire);
+				if (next == nullptr) return false;
+
+				// next zostaje nowym wartownikiem, wartosc jest z niego wyjmowana
+				value = std::move(next->value);
+				delete m_tail;
+				m_tail = next;
+				return true;
+			}
+
+			bool empty() const {
+				return m_tail->next.load(std::memory_order_acquire) == nullptr;
+			}
+
+		private:
+			struct Node {
+				std::atomic<Node*> next;
+				T value;
+
+				Node() : next(nullptr) { }
+				Node(T&& v) : next(nullptr), value(std::move(v)) { }
+			};
+
+			std::atomic<Node*> m_head;
+			Node* m_tail;
+
+			mpsc_queue(const mpsc_queue& from);
+			mpsc_queue& operator=(const mpsc_queue& from);
+	};
+
+}
+
+#endif /* INCLUDE_STDEXT_MPSC_QUEUE_H_ */
@@ -27,15 +27,12 @@
 namespace stdext {
 
 	// ************************************************************************************
-	object::object() {
-		static uint64_t counter = 100;
-		m_objectRefs = 0;
-		m_objectId = counter++;
+	object::object(): m_objectRefs(0) {
 	}
 
 	// ************************************************************************************
 	object::~object() {
-		assert(m_objectRefs == 0);
+		assert(m_objectRefs.load(std::memory_order_relaxed) == 0);
 	}
 
 }
@@ -33,7 +33,7 @@
 #include <core/logger.h>
 #include <ostream>
 #include <cassert>
-#include <mutex>
+#include <atomic>
 
 namespace stdext {
 
@@ -51,30 +51,22 @@ namespace stdext {
 			template<typename T> stdext::object_ptr<T> dynamic_self_cast() { return stdext::object_ptr<T>(dynamic_cast<T*>(this)); }
 			template<typename T> stdext::object_ptr<T> const_self_cast() { return stdext::object_ptr<T>(const_cast<T*>(this)); }
 
-			int32_t __refsCount() const { return m_objectRefs; }
-			uint64_t __objectId() const { return m_objectId; }
+			int32_t __refsCount() const { return m_objectRefs.load(std::memory_order_relaxed); }
 
-			virtual void __refsDec() {
-				bool del = false;
-
-				m_objectsRefsMutex.lock();
-				m_objectRefs -= 1;
-				if (m_objectRefs == 0) del = true;
-				m_objectsRefsMutex.unlock();
-
-				assert(m_objectRefs >= 0);
-				if (del) delete this;
+			// nowa referencja moze powstac tylko z juz istniejacej, wiec nie trzeba tu zadnej synchronizacji
+			void __refsInc() {
+				m_objectRefs.fetch_add(1, std::memory_order_relaxed);
 			}
-			virtual void __refsInc() {
-				m_objectsRefsMutex.lock();
-				m_objectRefs++;
-				m_objectsRefsMutex.unlock();
+
+			// acq_rel - wszystkie zapisy z innych watkow musza byc widoczne przed destruktorem
+			void __refsDec() {
+				int32_t prev = m_objectRefs.fetch_sub(1, std::memory_order_acq_rel);
+				assert(prev > 0);
+				if (prev == 1) delete this;
 			}
 
 		private:
-			volatile int32_t m_objectRefs;
-			uint64_t m_objectId;
-			std::mutex m_objectsRefsMutex;
+			std::atomic<int32_t> m_objectRefs;
 
 			object(const object& from);
 			object& operator=(const object& from);
@@ -132,13 +124,13 @@ namespace stdext {
 		private:
 			void refsInc() {
 				if (px != nullptr) {
-					dynamic_cast<object*>(px)->__refsInc();
+					static_cast<object*>(px)->__refsInc();
 				}
 			}
 
 			void refsDec() {
 				if (px != nullptr) {
-					dynamic_cast<object*>(px)->__refsDec();
+					static_cast<object*>(px)->__refsDec();
 				}
 			}
 
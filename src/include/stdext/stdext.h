@@ -40,5 +40,7 @@
 #include "flags.h"
 #include "holders.h"
 #include "algorithm.h"
+#include "function.h"
+#include "mpsc_queue.h"
 
 #endif
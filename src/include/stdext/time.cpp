@@ -39,6 +39,7 @@ namespace stdext {
 	ticks_t Time::seconds() { return std::time(NULL); }
 	ticks_t Time::millis() { return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - startup_time).count(); }
 	ticks_t Time::micros() { return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - startup_time).count(); }
+	ticks_t Time::wallMillis() { return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count(); }
 
 	// ************************************************************************************
 	void Time::millisleep(size_t ms) {
@@ -83,4 +84,17 @@ namespace stdext {
 		return buffer;
 	}
 
+	// ************************************************************************************
+	std::string Time::asStringWithMilis(ticks_t wallMillis) {
+		time_t rawtime = wallMillis / 1000;
+		struct tm info;
+		char buffer[256] = { 0 };
+
+		localtime_r(&rawtime, &info);
+
+		size_t n = strftime(buffer,256,"%d-%m-%Y %H:%M:%S", &info);
+		sprintf(buffer + n, " +%04d ms", (int)(wallMillis % 1000));
+		return buffer;
+	}
+
 } /* namespace core */
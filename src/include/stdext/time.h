@@ -44,6 +44,8 @@ namespace stdext {
 
 			static std::string asString(const char* format=nullptr);
 			static std::string asStringWithMilis();
+			static std::string asStringWithMilis(ticks_t wallMillis);
+			static ticks_t wallMillis();
 	};
 
 	class RawTimer {
@@ -34,6 +34,12 @@ namespace stdext {
 	template<class T, unsigned long N> struct replace_extent<T[N]> { typedef const T* type;};
 	template<typename T> struct remove_const_ref { typedef typename std::remove_const<typename std::remove_reference<T>::type>::type type; };
 
+	template<typename... T> struct max_sizeof;
+	template<typename T> struct max_sizeof<T> { static const std::size_t value = sizeof(T); };
+	template<typename T, typename... R> struct max_sizeof<T, R...> {
+		static const std::size_t value = sizeof(T) > max_sizeof<R...>::value ? sizeof(T) : max_sizeof<R...>::value;
+	};
+
 };
 
 #endif
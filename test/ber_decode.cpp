@@ -0,0 +1,89 @@
+/*
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @author: pregusia
+ *
+ */
+
+
+/*
+ * Dekodowanie BER (SNMPInputStreamAdapter::read) z uszkodzonych i nietypowych pakietow.
+ */
+
+#include "test.h"
+#include <application/snmp/streams.h>
+#include <io/buffers.h>
+
+#include <unistd.h>
+
+using namespace application::snmp;
+
+// ************************************************************************************
+static Value decode(const uint8_t* data, size_t size, bool& errorFlag) {
+	io::DataBuffer buf(data, size);
+	io::DataBufferInputStream is(buf);
+	errorFlag = false;
+	return SNMPInputStreamAdapter::read(is, errorFlag);
+}
+
+// ************************************************************************************
+static int testTruncatedSequence() {
+	// sekwencja deklaruje 16 bajtow, a w pakiecie jest tylko jeden INTEGER
+	const uint8_t data[] = { 0x30, 0x10, 0x02, 0x01, 0x05 };
+	bool errorFlag = false;
+	Value v = decode(data, sizeof(data), errorFlag);
+
+	TEST_CHECK(v.type() == ValueType::SEQUENCE);
+	TEST_CHECK(v.size() == 1);
+	TEST_CHECK(v[0].valueInt() == 5);
+	return 0;
+}
+
+// ************************************************************************************
+static int testInvalidElement() {
+	// nieznany typ w srodku sekwencji - dekodowanie konczy sie bledem, a nie petla
+	const uint8_t data[] = { 0x30, 0x06, 0x99, 0x01, 0x00, 0x02, 0x01, 0x05 };
+	bool errorFlag = false;
+	decode(data, sizeof(data), errorFlag);
+
+	TEST_CHECK(errorFlag);
+	return 0;
+}
+
+// ************************************************************************************
+static int testOctetStringWithNul() {
+	// OCTET STRING z danymi binarnymi (np. adres MAC) - bajty 0 sa czescia wartosci
+	const uint8_t data[] = { 0x04, 0x06, 0x00, 0x1B, 0x00, 0x00, 0x5E, 0x01 };
+	bool errorFlag = false;
+	Value v = decode(data, sizeof(data), errorFlag);
+
+	TEST_CHECK(!errorFlag);
+	TEST_CHECK(v.type() == ValueType::STRING);
+	TEST_CHECK(v.valueString() == std::string("\x00\x1B\x00\x00\x5E\x01", 6));
+	return 0;
+}
+
+// ************************************************************************************
+int main() {
+	// zapetlone dekodowanie konczy test sygnalem zamiast wisiec
+	alarm(10);
+
+	return testTruncatedSequence() || testInvalidElement() || testOctetStringWithNul();
+}
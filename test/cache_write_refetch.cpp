@@ -0,0 +1,311 @@
+/*
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @author: pregusia
+ *
+ */
+
+
+
+/*
+ * cache-write "refetch": SET przechodzi przez proxy, a ponowne pobranie wartosci
+ * z agenta zwraca noSuchInstance - wartosc musi zniknac z cache (jak przy NULL),
+ * a nie zostac z wartoscia z odpowiedzi na SET.
+ * Aplikacja dziala w tym procesie (g_app.run), agent i zarzadca w watku pomocniczym.
+ */
+
+#include "test.h"
+#include <application/Application.h>
+#include <application/snmp/streams.h>
+#include <io/buffers.h>
+
+#include <arpa/inet.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <set>
+#include <thread>
+
+using namespace application::snmp;
+
+namespace {
+
+	const uint16_t PROXY_PORT = 17171;
+	const uint16_t AGENT_PORT = 17172;
+
+	const char* CONFIG =
+		"proxy {\n"
+		"	community \"test\";\n"
+		"	socket \"127.0.0.1:17171\";\n"
+		"	cache-write \"refetch\";\n"
+		"	target {\n"
+		"		src-socket \"127.0.0.1:17173\";\n"
+		"		dst-socket \"127.0.0.1:17172\";\n"
+		"		community \"public\";\n"
+		"		timeout 2000;\n"
+		"	};\n"
+		"	cache-for \".1.3.6.1.2.1.2.2.1.2.*\" {\n"
+		"		update-interval 3600;\n"
+		"	};\n"
+		"};\n";
+
+	// ************************************************************************************
+	sockaddr_in loopback(uint16_t port) {
+		sockaddr_in addr = { 0 };
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr.sin_port = htons(port);
+		return addr;
+	}
+
+	// ************************************************************************************
+	int32_t openSocket(uint16_t port) {
+		int32_t fd = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+		sockaddr_in addr = loopback(port);
+		if (fd < 0 || ::bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+			perror("bind");
+			exit(1);
+		}
+		return fd;
+	}
+
+	// ************************************************************************************
+	Value createMessage(const std::string& community, ValueType::Enum type, int32_t requestID, const std::vector<VarBinding>& values) {
+		Value vbs = Value::createSequence();
+		for(auto& e: values) {
+			Value vb = Value::createSequence();
+			vb.addItem(Value::createOID(e.name));
+			vb.addItem(e.value);
+			vbs.addItem(vb);
+		}
+
+		Value pdu = Value::createSequence(type);
+		pdu.addItem(Value::createInt(requestID));
+		pdu.addItem(Value::createInt(0));
+		pdu.addItem(Value::createInt(0));
+		pdu.addItem(vbs);
+
+		Value msg = Value::createSequence();
+		msg.addItem(Value::createInt(1));
+		msg.addItem(Value::createString(community));
+		msg.addItem(pdu);
+		return msg;
+	}
+
+	// ************************************************************************************
+	void sendMessage(int32_t fd, const sockaddr_in& to, const Value& msg) {
+		io::DataBuffer buf;
+		io::DataBufferOutputStream os(buf, true);
+		SNMPOutputStreamAdapter snmpOS(os);
+		snmpOS.writeValue(msg);
+		::sendto(fd, &buf[0], buf.size(), 0, (const sockaddr*)&to, sizeof(to));
+	}
+
+	// ************************************************************************************
+	bool receiveMessage(int32_t fd, sockaddr_in& from, Value& msg) {
+		uint8_t data[65536];
+		socklen_t fromLen = sizeof(from);
+		ssize_t res = ::recvfrom(fd, data, sizeof(data), 0, (sockaddr*)&from, &fromLen);
+		if (res <= 0) return false;
+
+		io::DataBuffer buf(data, res);
+		io::DataBufferInputStream is(buf);
+		bool errorFlag = false;
+		msg = SNMPInputStreamAdapter::read(is, errorFlag);
+		return !errorFlag && msg.isMessage();
+	}
+
+	/**
+	 * Agent z tabela ifDescr. Przyjmuje SET, ale zapisanej instancji juz nie ma -
+	 * GET zwraca dla niej noSuchInstance (przejscia tabeli nadal ja widza).
+	 */
+	class Agent {
+		public:
+			Agent() : m_fd(openSocket(AGENT_PORT)) {
+				for(int32_t i=1;i<=3;++i) {
+					m_mib[OID(stdext::format(".1.3.6.1.2.1.2.2.1.2.%d", i))] = Value::createString(stdext::format("eth%d", i));
+				}
+				// ifType - przejscie tabeli przy wypelnianiu cache konczy sie na nastepnej kolumnie
+				m_mib[OID(".1.3.6.1.2.1.2.2.1.3.1")] = Value::createInt(6);
+			}
+
+			int32_t fd() const { return m_fd; }
+
+			void onRead() {
+				sockaddr_in from;
+				Value req;
+				if (!receiveMessage(m_fd, from, req)) return;
+
+				auto& pdu = req[2];
+				std::vector<VarBinding> res;
+
+				for(auto& e: pdu[3].valueVec()) {
+					VarBinding vb;
+					vb.name = e[0].valueOID();
+
+					if (pdu.type() == ValueType::PDU_SET) {
+						vb.value = e[1];
+						m_vanished.insert(vb.name);
+					} else if (pdu.type() == ValueType::PDU_GET) {
+						auto it = m_mib.find(vb.name);
+						if (it == m_mib.end() || m_vanished.count(vb.name) != 0) {
+							vb.value.setType(ValueType::NO_SUCH_INSTANCE);
+						} else {
+							vb.value = it->second;
+						}
+					} else {
+						// GET-NEXT i GET-BULK - po jednej wartosci wystarcza do wypelnienia cache
+						auto it = m_mib.upper_bound(vb.name);
+						if (it == m_mib.end()) {
+							vb.value = Value::createEndOfMIBView();
+						} else {
+							vb.name = it->first;
+							vb.value = it->second;
+						}
+					}
+					res.push_back(vb);
+				}
+
+				sendMessage(m_fd, from, createMessage(req[1].valueString(), ValueType::PDU_RESPONSE, pdu[0].valueInt(), res));
+			}
+
+		private:
+			int32_t m_fd;
+			std::map<OID, Value> m_mib;
+			std::set<OID> m_vanished;
+	};
+
+	/**
+	 * Zarzadca - wysyla zapytania do proxy po jednym i czeka na odpowiedz (obslugujac w tym
+	 * czasie agenta).
+	 */
+	class Manager {
+		public:
+			Manager(Agent& agent) : m_agent(agent), m_fd(openSocket(0)), m_requestID(1) { }
+
+			// false - brak odpowiedzi w timeoutMillis
+			bool request(ValueType::Enum type, const OID& oid, const Value& value, int32_t timeoutMillis, Value& response) {
+				VarBinding vb;
+				vb.name = oid;
+				vb.value = value;
+
+				int32_t requestID = m_requestID++;
+				sendMessage(m_fd, loopback(PROXY_PORT), createMessage("test", type, requestID, std::vector<VarBinding>(1, vb)));
+
+				auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMillis);
+				while(std::chrono::steady_clock::now() < deadline) {
+					pollfd fds[2] = { { m_fd, POLLIN, 0 }, { m_agent.fd(), POLLIN, 0 } };
+					if (::poll(fds, 2, 10) <= 0) continue;
+
+					if (fds[1].revents & POLLIN) m_agent.onRead();
+					if (fds[0].revents & POLLIN) {
+						sockaddr_in from;
+						if (receiveMessage(m_fd, from, response) && response[2][0].valueInt() == requestID) return true;
+					}
+				}
+				return false;
+			}
+
+		private:
+			Agent& m_agent;
+			int32_t m_fd;
+			int32_t m_requestID;
+	};
+
+	// ************************************************************************************
+	int testRefetchNoSuchInstance() {
+		const OID name(".1.3.6.1.2.1.2.2.1.2.2");
+
+		Agent agent;
+		Manager manager(agent);
+		Value response;
+
+		// aplikacja startuje w watku glownym, a cache wypelnia sie przy pierwszym zapytaniu
+		bool started = false;
+		for(int32_t i=0;i<100 && !started;++i) {
+			started = manager.request(ValueType::PDU_GET, name, Value::createNull(), 100, response);
+		}
+		TEST_CHECK(started);
+		TEST_CHECK(response[2][1].valueInt() == 0);
+		TEST_CHECK(response[2][3][0][1].valueString() == "eth2");
+
+		TEST_CHECK(manager.request(ValueType::PDU_SET, name, Value::createString("gone"), 2000, response));
+		TEST_CHECK(response[2][1].valueInt() == 0);
+
+		// ponowne pobranie idzie juz po wyslaniu odpowiedzi na SET - czekamy, az zmieni cache;
+		// "gone" (wartosc z SET-a) zostaloby, gdyby noSuchInstance nie usuwalo wpisu
+		bool removed = false;
+		for(int32_t i=0;i<100 && !removed;++i) {
+			TEST_CHECK(manager.request(ValueType::PDU_GET, name, Value::createNull(), 2000, response));
+			removed = response[2][1].valueInt() == SNMPError::SNMP_NO_SUCH_NAME;
+			if (!removed) {
+				TEST_CHECK(response[2][3][0][1].type() == ValueType::STRING);
+				usleep(10000);
+			}
+		}
+		TEST_CHECK(removed);
+
+		// przejscie z cache omija usunieta instancje
+		TEST_CHECK(manager.request(ValueType::PDU_GET_NEXT, OID(".1.3.6.1.2.1.2.2.1.2.1"), Value::createNull(), 2000, response));
+		TEST_CHECK(response[2][1].valueInt() == 0);
+		TEST_CHECK(response[2][3][0][0].valueOID() == OID(".1.3.6.1.2.1.2.2.1.2.3"));
+		return 0;
+	}
+
+}
+
+// ************************************************************************************
+int main() {
+	// zawieszone proxy konczy test sygnalem zamiast wisiec
+	alarm(30);
+
+	char path[] = "/tmp/test-cache-write-refetch-XXXXXX";
+	int32_t fd = mkstemp(path);
+	if (fd < 0 || ::write(fd, CONFIG, strlen(CONFIG)) < 0) {
+		perror("config");
+		return 1;
+	}
+	::close(fd);
+
+	// sygnaly dostaje tylko watek aplikacji (g_unixSignals)
+	sigset_t mask;
+	sigfillset(&mask);
+	pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+
+	int result = 1;
+	std::thread helper([&result](){
+		result = testRefetchNoSuchInstance();
+		kill(getpid(), SIGTERM);
+	});
+
+	pthread_sigmask(SIG_UNBLOCK, &mask, nullptr);
+
+	application::Application::StartConfig config;
+	config.configFile = path;
+	g_app.run(config);
+
+	helper.join();
+	unlink(path);
+	return result;
+}
@@ -0,0 +1,88 @@
+/*
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @author: pregusia
+ *
+ */
+
+
+/*
+ * OID::operator< - porzadek leksykograficzny po liczbach (kolejnosc GET-NEXT).
+ */
+
+#include "test.h"
+#include <application/snmp/Value.h>
+
+#include <algorithm>
+
+using application::snmp::OID;
+
+// ************************************************************************************
+static int testArcs() {
+	// kolejne liczby, a nie napisy, i rozstrzyga pierwsza rozna pozycja
+	TEST_CHECK(OID(".1.3.6.9.1") < OID(".1.3.6.10"));
+	TEST_CHECK(!(OID(".1.3.6.10") < OID(".1.3.6.9.1")));
+	TEST_CHECK(OID(".1.3.6.1.2") < OID(".1.3.6.1.10"));
+	TEST_CHECK(OID(".1.3.6.2") > OID(".1.3.6.1.5"));
+	return 0;
+}
+
+// ************************************************************************************
+static int testPrefix() {
+	// prefiks jest przed kazdym dluzszym OID-em
+	TEST_CHECK(OID(".1.3.6.1") < OID(".1.3.6.1.0"));
+	TEST_CHECK(!(OID(".1.3.6.1.0") < OID(".1.3.6.1")));
+
+	TEST_CHECK(!(OID(".1.3.6.1") < OID(".1.3.6.1")));
+	TEST_CHECK(OID(".1.3.6.1") <= OID(".1.3.6.1"));
+	TEST_CHECK(OID(".1.3.6.1") >= OID(".1.3.6.1"));
+	return 0;
+}
+
+// ************************************************************************************
+static int testSort() {
+	std::vector<OID> oids = {
+		OID(".1.3.6.1.2.1.2.2.1.10.2"),
+		OID(".1.3.6.1.2.1.2.2.1.2.10"),
+		OID(".1.3.6.1.2.1.2.2.1.10.10"),
+		OID(".1.3.6.1.2.1.2.2.1.2"),
+		OID(".1.3.6.1.2.1.2.2.1.2.9"),
+	};
+	std::sort(oids.begin(), oids.end());
+
+	TEST_CHECK(oids[0] == OID(".1.3.6.1.2.1.2.2.1.2"));
+	TEST_CHECK(oids[1] == OID(".1.3.6.1.2.1.2.2.1.2.9"));
+	TEST_CHECK(oids[2] == OID(".1.3.6.1.2.1.2.2.1.2.10"));
+	TEST_CHECK(oids[3] == OID(".1.3.6.1.2.1.2.2.1.10.2"));
+	TEST_CHECK(oids[4] == OID(".1.3.6.1.2.1.2.2.1.10.10"));
+
+	// scisle slabe uporzadkowanie - nigdy a < b i b < a jednoczesnie
+	for(auto& a: oids) {
+		for(auto& b: oids) {
+			TEST_CHECK(!(a < b && b < a));
+		}
+	}
+	return 0;
+}
+
+// ************************************************************************************
+int main() {
+	return testArcs() || testPrefix() || testSort();
+}
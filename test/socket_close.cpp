@@ -0,0 +1,59 @@
+/*
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @author: pregusia
+ *
+ */
+
+
+/*
+ * Socket::close() na zamknietym juz sockecie (np. po bledzie sendto) i potem destruktor.
+ */
+
+#include "test.h"
+#include <application/snmp/Socket.h>
+
+#include <arpa/inet.h>
+
+using namespace application::snmp;
+
+// ************************************************************************************
+static int testCloseTwice() {
+	sockaddr_in addr = { 0 };
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(17099);
+
+	stdext::object_ptr<Socket> socket(new Socket(io::InetEndpoint(addr)));
+	TEST_CHECK(!socket->inactive());
+
+	socket->close();
+	TEST_CHECK(socket->inactive());
+	socket->close();
+
+	// destruktor zamyka jeszcze raz
+	socket.reset();
+	return 0;
+}
+
+// ************************************************************************************
+int main() {
+	return testCloseTwice();
+}
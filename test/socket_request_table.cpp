@@ -0,0 +1,109 @@
+/*
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * @author: pregusia
+ *
+ */
+
+
+
+/*
+ * SocketRequestTable - wstawianie, wyszukiwanie, usuwanie z przesuwaniem wstecz i powiekszanie.
+ */
+
+#include "test.h"
+#include <application/snmp/Socket.h>
+
+using namespace application::snmp;
+
+static Client* const CLIENT_A = reinterpret_cast<Client*>(0x1000);
+static Client* const CLIENT_B = reinterpret_cast<Client*>(0x2000);
+
+// ************************************************************************************
+static int testInsertFind() {
+	SocketRequestTable table;
+
+	TEST_CHECK(table.insert(1, SocketRequestRoute(CLIENT_A, 10)));
+	TEST_CHECK(!table.insert(1, SocketRequestRoute(CLIENT_B, 11)));
+	TEST_CHECK(table.size() == 1);
+
+	const SocketRequestRoute* route = table.find(1);
+	TEST_CHECK(route != nullptr);
+	TEST_CHECK(route->client == CLIENT_A && route->handle == 10);
+	TEST_CHECK(table.find(2) == nullptr);
+	TEST_CHECK(table.find(0) == nullptr);
+	return 0;
+}
+
+// ************************************************************************************
+static int testCollisions() {
+	// numery rozniace sie o wielokrotnosc pojemnosci trafiaja do tego samego slotu
+	SocketRequestTable table;
+	for(int32_t i=0;i < 8;i++) {
+		TEST_CHECK(table.insert(5 + i * 64, SocketRequestRoute(CLIENT_A, i)));
+	}
+	TEST_CHECK(table.insert(6, SocketRequestRoute(CLIENT_B, 100)));
+
+	// usuniecie ze srodka ciagu - pozostale nadal musza byc osiagalne
+	table.erase(5 + 2 * 64);
+	table.erase(5);
+	TEST_CHECK(table.find(5) == nullptr);
+	TEST_CHECK(table.find(5 + 2 * 64) == nullptr);
+	for(int32_t i=1;i < 8;i++) {
+		if (i == 2) continue;
+		const SocketRequestRoute* route = table.find(5 + i * 64);
+		TEST_CHECK(route != nullptr && route->handle == i);
+	}
+	TEST_CHECK(table.find(6) != nullptr && table.find(6)->handle == 100);
+	TEST_CHECK(table.size() == 7);
+	return 0;
+}
+
+// ************************************************************************************
+static int testGrowAndEraseClient() {
+	SocketRequestTable table;
+	for(int32_t id=1;id <= 1000;id++) {
+		TEST_CHECK(table.insert(id, SocketRequestRoute(id % 2 ? CLIENT_A : CLIENT_B, id)));
+	}
+	TEST_CHECK(table.size() == 1000);
+
+	table.eraseClient(CLIENT_A);
+	TEST_CHECK(table.size() == 500);
+	for(int32_t id=1;id <= 1000;id++) {
+		const SocketRequestRoute* route = table.find(id);
+		if (id % 2) {
+			TEST_CHECK(route == nullptr);
+		} else {
+			TEST_CHECK(route != nullptr && route->client == CLIENT_B && route->handle == id);
+		}
+	}
+
+	// numery z konca zakresu (po przekreceniu licznika)
+	TEST_CHECK(table.insert(0x7FFFFFFF, SocketRequestRoute(CLIENT_A, 1)));
+	TEST_CHECK(table.find(0x7FFFFFFF) != nullptr);
+	table.erase(0x7FFFFFFF);
+	TEST_CHECK(table.find(0x7FFFFFFF) == nullptr);
+	return 0;
+}
+
+// ************************************************************************************
+int main() {
+	return testInsertFind() || testCollisions() || testGrowAndEraseClient();
+}